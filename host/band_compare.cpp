@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+
+// Draws 120 frames of random primitives, translucent fills and text, clearing
+// the screen every few frames, and keeps what the panel shows after each. The
+// band renderer and the frame buffer can't be built into one program, so
+// without ILI9341_BAND_RENDERER it writes the frames to the file it is given,
+// and with it compares them pixel for pixel with that file:
+//   band_compare frames.bin   (built without, then with the band renderer)
+// Both builds must otherwise use the same flags. With ILI9341_SPI_16BIT the
+// frame buffer build blends on the DMA2D, which rounds differently from the
+// CPU the bands are drawn by and may be a step off in any channel.
+
+ILI9341UiDriver driver;
+
+static constexpr int width = 320, height = 240;
+static constexpr int frames = 120, clear_every = 8, per_frame = 10;
+
+// Polygons are read in place when bands are replayed, so they stay here
+static PolygonRaster::Vertex points[frames * per_frame][5];
+
+static int16_t X(int margin = 20)
+{
+    return rand() % (width + 2 * margin) - margin;
+}
+
+static int16_t Y(int margin = 20)
+{
+    return rand() % (height + 2 * margin) - margin;
+}
+
+static uint8_t Alpha()
+{
+    return rand() % 3 ? 255 : rand() % 256;
+}
+
+#ifdef ILI9341_BAND_RENDERER
+// Whether every channel of a and b is within tolerance steps
+static bool Near(uint16_t a, uint16_t b)
+{
+#ifdef ILI9341_SPI_16BIT
+    constexpr int tolerance = 1;
+#else
+    constexpr int tolerance = 0;
+#endif
+    return abs((a >> 11) - (b >> 11)) <= tolerance
+           && abs((a >> 5 & 0x3F) - (b >> 5 & 0x3F)) <= tolerance
+           && abs((a & 0x1F) - (b & 0x1F)) <= tolerance;
+}
+#endif
+
+static void Primitive(int i)
+{
+    uint8_t color = rand() % NUMBER_OF_TFT_COLORS;
+    switch(rand() % 11)
+    {
+        case 0:
+            // DrawLine() takes unsigned coordinates
+            driver.DrawLine(X(0), Y(0), X(0), Y(0), color, Alpha());
+            break;
+        case 1:
+            driver.DrawRect(X(0), Y(0), rand() % 80, rand() % 60, color);
+            break;
+        case 2:
+        case 3:
+            driver.FillRect(Rectangle(X(), Y(), rand() % 100, rand() % 80),
+                            color,
+                            Alpha());
+            break;
+        case 4:
+            driver.FillTriangle(X(), Y(), X(), Y(), X(), Y(), color, Alpha());
+            break;
+        case 5:
+        {
+            // A convex pentagon around a center
+            int16_t x = X(), y = Y(), r = 5 + rand() % 40;
+            for(int k = 0; k < 5; k++)
+            {
+                points[i][k] = {
+                    int16_t(x + CoverageRaster::Cos(k * 72) * r / 32768),
+                    int16_t(y + CoverageRaster::Sin(k * 72) * r / 32768)};
+            }
+            driver.FillPolygon(points[i], 5, color, Alpha());
+            break;
+        }
+        case 6: driver.DrawCircle(X(), Y(), rand() % 50, color); break;
+        case 7: driver.FillCircle(X(), Y(), rand() % 50, color); break;
+        case 8:
+        {
+            char text[24];
+            snprintf(text, sizeof(text), "frame %d %d", i, rand() % 1000);
+            driver.WriteString(text,
+                               X(0) % (width - 120),
+                               Y(0) % (height - 20),
+                               rand() % 2 ? Font_7x10 : Font_11x18,
+                               color);
+            break;
+        }
+        case 9:
+            driver.DrawLineAA(X(), Y(), X(), Y(), color, Alpha());
+            break;
+        case 10:
+            driver.DrawArcAA(X(),
+                             Y(),
+                             10 + rand() % 50,
+                             1 + rand() % 6,
+                             rand() % 360,
+                             360 + rand() % 360,
+                             color,
+                             Alpha());
+            break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        printf("usage: %s frames.bin\n", argv[0]);
+        return 2;
+    }
+#ifdef ILI9341_BAND_RENDERER
+    FILE* file = fopen(argv[1], "rb");
+#else
+    FILE* file = fopen(argv[1], "wb");
+#endif
+    if(!file)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    driver.Init();
+    srand(10);
+    std::vector<uint16_t> shown(width * height);
+#ifdef ILI9341_BAND_RENDERER
+    std::vector<uint16_t> expected(width * height);
+    int                   pixels = 0, differing = 0;
+#endif
+    for(int frame = 0; frame < frames; frame++)
+    {
+        if(frame % clear_every == 0)
+        {
+            driver.Fill(rand() % NUMBER_OF_TFT_COLORS);
+        }
+        for(int i = 0; i < per_frame; i++)
+        {
+            Primitive(frame * per_frame + i);
+        }
+        driver.Update();
+        while(!driver.IsRender()) {}
+
+        for(uint16_t y = 0; y < height; y++)
+        {
+            for(uint16_t x = 0; x < width; x++)
+            {
+                shown[y * width + x] = host_panel.GetPixel(x, y);
+            }
+        }
+#ifdef ILI9341_BAND_RENDERER
+        if(fread(expected.data(), 2, expected.size(), file) != expected.size())
+        {
+            printf("%s has only %d frames\n", argv[1], frame);
+            return 2;
+        }
+        int wrong = 0;
+        for(size_t p = 0; p < shown.size(); p++)
+        {
+            wrong += !Near(shown[p], expected[p]);
+        }
+        pixels += wrong;
+        differing += wrong != 0;
+#else
+        if(fwrite(shown.data(), 2, shown.size(), file) != shown.size())
+        {
+            perror(argv[1]);
+            return 2;
+        }
+#endif
+    }
+    fclose(file);
+
+#ifdef ILI9341_BAND_RENDERER
+    printf("frames unlike the frame buffer's  %d of %d, %d pixels\n",
+           differing,
+           frames,
+           pixels);
+    printf("calls dropped                    %lu\n",
+           static_cast<unsigned long>(driver.Dropped()));
+    return pixels != 0 || driver.Dropped() != 0;
+#else
+    printf("%d frames written to %s\n", frames, argv[1]);
+    return 0;
+#endif
+}
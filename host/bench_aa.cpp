@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include "ili9341_ui_driver.hpp"
+
+// Times the anti-aliased primitives next to their aliased counterparts, then
+// a screen of 16 knob arcs, the case they are meant for. Saves the knobs if
+// given a file name.
+
+ILI9341UiDriver driver;
+
+static constexpr int rounds = 200;
+
+template <typename Draw>
+static double Time(Draw draw)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        draw(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count()
+           / rounds;
+}
+
+static void Knobs(int i)
+{
+    for(int16_t k = 0; k < 16; k++)
+    {
+        int16_t x     = 40 + k % 4 * 80;
+        int16_t y     = 30 + k / 4 * 60;
+        int16_t value = (i * 7 + k * 37) % 271;
+        driver.DrawArcAA(x, y, 22, 4, 135, 405, COLOR_ABL_L_GRAY);
+        driver.DrawArcAA(x, y, 22, 4, 135, 135 + value, COLOR_ORANGE);
+        driver.DrawLineAA(x,
+                          y,
+                          x + CoverageRaster::Cos(135 + value) * 18 / 32768,
+                          y + CoverageRaster::Sin(135 + value) * 18 / 32768,
+                          COLOR_WHITE);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    driver.Init();
+    driver.Fill(COLOR_BLACK);
+
+    auto line = [](int i) { driver.DrawLine(10, 20, 300, 20 + i % 200, 1); };
+    auto line_aa
+        = [](int i) { driver.DrawLineAA(10, 20, 300, 20 + i % 200, 1); };
+    auto circle = [](int i) { driver.DrawCircle(160, 120, 40 + i % 50, 2); };
+    auto circle_aa
+        = [](int i) { driver.DrawCircleAA(160, 120, 40 + i % 50, 2); };
+    auto fill = [](int i) { driver.FillCircle(160, 120, 40 + i % 50, 3); };
+    auto fill_aa
+        = [](int i) { driver.FillCircleAA(160, 120, 40 + i % 50, 3); };
+    auto arc_aa = [](int i)
+    { driver.DrawArcAA(160, 120, 40 + i % 50, 4, 135, 405, 4); };
+
+    printf("line            %7.2f us\n", Time(line));
+    printf("line AA         %7.2f us\n", Time(line_aa));
+    printf("circle r 40-90  %7.2f us\n", Time(circle));
+    printf("circle AA       %7.2f us\n", Time(circle_aa));
+    printf("disc r 40-90    %7.2f us\n", Time(fill));
+    printf("disc AA         %7.2f us\n", Time(fill_aa));
+    printf("arc AA 4 px     %7.2f us\n", Time(arc_aa));
+
+    driver.Fill(COLOR_BLACK);
+    printf("16 knobs        %7.2f us per frame\n", Time(Knobs));
+
+    if(argc > 1)
+    {
+        driver.Fill(COLOR_BLACK);
+        Knobs(100);
+        driver.FillCircleAA(300, 220, 12, COLOR_CYAN, 160);
+        driver.Update();
+        while(!driver.IsRender()) {}
+        return !host_panel.WritePpm(argv[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include "blend565.hpp"
+
+// Checks BlendSpan565() against Blend565() pixel by pixel for every alpha,
+// span start and a few lengths, then times both over full screen rows.
+
+alignas(4) static uint16_t row[322];
+alignas(4) static uint16_t expected[322];
+
+// The per pixel blend the spans used to get
+static void BlendEach(uint16_t* pixels, uint32_t n, uint16_t color, uint8_t a)
+{
+    for(uint32_t i = 0; i < n; i++)
+    {
+        auto bg   = FrameBufferPixel(pixels[i]);
+        pixels[i] = FrameBufferPixel(Blend565(color, bg, a));
+    }
+}
+
+static uint32_t Check()
+{
+    uint32_t mismatches = 0;
+    for(int alpha = 0; alpha < 256; alpha++)
+    {
+        for(uint32_t start = 0; start < 2; start++)
+        {
+            for(uint32_t n = 0; n < 10; n++)
+            {
+                uint16_t color = rand();
+                for(auto& pixel : row)
+                {
+                    pixel = rand();
+                }
+                std::copy(std::begin(row), std::end(row), expected);
+                BlendEach(expected + start, n, color, alpha);
+                BlendSpan565(row + start, n, color, alpha);
+                for(uint32_t i = 0; i < std::size(row); i++)
+                {
+                    mismatches += row[i] != expected[i];
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+template <typename Blend>
+static double Time(Blend blend)
+{
+    static constexpr int rounds = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        blend(row + (i & 1), 320, uint16_t(i * 2654435761u), i & 0xFF);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()
+           / (rounds * 320.0);
+}
+
+int main()
+{
+    auto mismatches = Check();
+    printf("%u pixels differ from Blend565()\n", mismatches);
+
+    Time(BlendEach);
+    auto each_ns = Time(BlendEach);
+    auto span_ns = Time(BlendSpan565);
+    printf("Blend565() per pixel %5.2f ns per pixel\n", each_ns);
+    printf("BlendSpan565()       %5.2f ns per pixel (%.2fx)\n",
+           span_ns,
+           each_ns / span_ns);
+    return mismatches != 0;
+}
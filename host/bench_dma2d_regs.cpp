@@ -0,0 +1,235 @@
+#include <cstdio>
+#include "daisy_seed.h"
+#include "dma2d.hpp"
+#include "frame_profiler.hpp"
+#include "stm32h7xx_hal.h"
+
+// Counts the DMA2D register writes of a mix of operations a UI makes: fills,
+// copies, A4 glyphs and ARGB4444 images blended over the frame. First through
+// Dma2DHandle, which writes only the registers that differ from the last
+// command, then the way the driver did before, through the HAL: Init() and
+// both ConfigLayer() calls for every operation, Start() and polling. Both
+// move the same pixels.
+//
+// Built with ILI9341_PROFILER, both are also timed by the profiler's
+// CycleCounter. Built for the Daisy Seed in place of main.cpp, which needs
+// the define, that is the DWT cycle counter and the cycles per operation go
+// to the USB log; the registers can't be counted there. On the host the
+// transfers run in software, so the time says nothing about the registers.
+
+#if defined(__arm__) && !defined(ILI9341_PROFILER)
+#error "Define ILI9341_PROFILER to time the DMA2D on the target"
+#endif
+
+static constexpr int width = 320, height = 240;
+static constexpr int operations = 4000;
+
+// Only the frame is read back by the DMA2D's blends after the CPU wrote it
+alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION frame[width * height * 2];
+alignas(4) static uint8_t source[width * height * 2];
+alignas(4) static uint8_t glyph[8 * 12 / 2];
+alignas(4) static uint8_t image[32 * 32 * 2];
+
+static Dma2DHandle         dma2d;
+static DMA2D_HandleTypeDef hal;
+
+static Rectangle Place(int i, int16_t w, int16_t h)
+{
+    return Rectangle(i * 37 % (width - w), i * 23 % (height - h), w, h);
+}
+
+static void Driver(int i)
+{
+    switch(i % 4)
+    {
+        case 0:
+            dma2d.FillRect(Place(i, 40, 20), i % NUMBER_OF_TFT_COLORS);
+            break;
+        case 1: dma2d.CopyRect(source, Place(i, 64, 32)); break;
+        case 2:
+            dma2d.DrawMask(glyph,
+                           Dma2DHandle::PixelFormat::A4,
+                           8,
+                           Place(i, 8, 12),
+                           COLOR_WHITE);
+            break;
+        case 3:
+            dma2d.DrawImage(image,
+                            Dma2DHandle::PixelFormat::ARGB4444,
+                            32,
+                            Place(i, 32, 32));
+            break;
+    }
+}
+
+// What one operation took through the HAL
+static void Hal(int i)
+{
+    static const int16_t sizes[4][2] = {{40, 20}, {64, 32}, {8, 12}, {32, 32}};
+    int16_t              w = sizes[i % 4][0], h = sizes[i % 4][1];
+    Rectangle            rect   = Place(i, w, h);
+    uintptr_t            offset = (rect.GetX() + rect.GetY() * width) * 2;
+    uintptr_t            dst    = reinterpret_cast<uintptr_t>(frame) + offset;
+
+    HAL_DMA2D_PollForTransfer(&hal, 100);
+    hal.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
+    hal.Init.OutputOffset = width - w;
+
+    auto& fg          = hal.LayerCfg[1];
+    auto& bg          = hal.LayerCfg[0];
+    fg.InputOffset    = 0;
+    fg.InputColorMode = DMA2D_INPUT_RGB565;
+    fg.AlphaMode      = DMA2D_NO_MODIF_ALPHA;
+    fg.InputAlpha     = 0xFF;
+    bg                = fg;
+    switch(i % 4)
+    {
+        case 0: hal.Init.Mode = DMA2D_R2M; break;
+        case 1:
+            hal.Init.Mode  = DMA2D_M2M;
+            fg.InputOffset = width - w;
+            break;
+        case 2:
+            hal.Init.Mode     = DMA2D_M2M_BLEND;
+            fg.InputColorMode = DMA2D_INPUT_A4;
+            fg.InputAlpha     = 0xFFFFFFFF;
+            break;
+        case 3:
+            hal.Init.Mode     = DMA2D_M2M_BLEND;
+            fg.InputColorMode = DMA2D_INPUT_ARGB4444;
+            break;
+    }
+    bg.InputOffset = width - w;
+    HAL_DMA2D_Init(&hal);
+    HAL_DMA2D_ConfigLayer(&hal, 0);
+    HAL_DMA2D_ConfigLayer(&hal, 1);
+
+    switch(i % 4)
+    {
+        case 0: HAL_DMA2D_Start(&hal, 0xFF808080, dst, w, h); break;
+        case 1:
+            HAL_DMA2D_Start(&hal,
+                            reinterpret_cast<uintptr_t>(source) + offset,
+                            dst,
+                            w,
+                            h);
+            break;
+        default:
+            HAL_DMA2D_BlendingStart(
+                &hal,
+                reinterpret_cast<uintptr_t>(i % 4 == 2 ? glyph : image),
+                dst,
+                dst,
+                w,
+                h);
+            break;
+    }
+    HAL_DMA2D_PollForTransfer(&hal, 100);
+}
+
+// Ticks of the mix through operation, or 0 without the profiler
+template <typename Operation>
+static uint32_t Time(Operation operation)
+{
+#ifdef ILI9341_PROFILER
+    uint32_t start = CycleCounter::Now();
+#endif
+    for(int i = 0; i < operations; i++)
+    {
+        operation(i);
+    }
+    dma2d.Flush();
+#ifdef ILI9341_PROFILER
+    return CycleCounter::Now() - start;
+#else
+    return 0;
+#endif
+}
+
+static void Setup()
+{
+#ifdef ILI9341_PROFILER
+    CycleCounter::Init();
+#endif
+    dma2d.Init(frame);
+    for(size_t i = 0; i < sizeof(source); i++)
+    {
+        source[i] = i * 7 + i / 640;
+    }
+    for(size_t i = 0; i < sizeof(glyph); i++)
+    {
+        glyph[i] = i * 29;
+    }
+    for(size_t i = 0; i < sizeof(image); i++)
+    {
+        image[i] = i * 13;
+    }
+}
+
+// The HAL path polls, so the driver's interrupts are turned off
+static void UseHal()
+{
+    DMA2D->CR    = 0;
+    hal.Instance = DMA2D;
+}
+
+#if defined(__arm__)
+static daisy::DaisySeed hw;
+
+template <typename Operation>
+static void Run(const char* name, Operation operation)
+{
+    uint32_t cycles = Time(operation);
+    hw.PrintLine("%-8s %lu cycles per operation",
+                 name,
+                 static_cast<unsigned long>(cycles / operations));
+}
+
+int main()
+{
+    hw.Init(true);
+    hw.StartLog(true);
+    Setup();
+    Run("shadowed", Driver);
+    UseHal();
+    Run("HAL", Hal);
+    for(;;) {}
+}
+#else
+template <typename Operation>
+static HostDma2DStats Run(const char* name, Operation operation)
+{
+    host_dma2d_stats = {};
+    uint32_t ticks   = Time(operation);
+
+    auto stats = host_dma2d_stats;
+    printf("%-8s %5.2f register writes per operation, %llu pixels",
+           name,
+           stats.register_writes / double(operations),
+           static_cast<unsigned long long>(stats.pixels));
+#ifdef ILI9341_PROFILER
+    printf(", %.2f us per operation",
+           ticks / double(CycleCounter::TicksPerUs()) / operations);
+#else
+    (void)ticks;
+#endif
+    printf("\n");
+    return stats;
+}
+
+int main()
+{
+    Setup();
+    auto shadowed = Run("shadowed", Driver);
+    UseHal();
+    auto baseline = Run("HAL", Hal);
+
+    bool same = shadowed.pixels == baseline.pixels
+                && shadowed.transfers == baseline.transfers;
+    if(!same)
+    {
+        printf("the two paths moved different pixels\n");
+    }
+    return !same || shadowed.register_writes >= baseline.register_writes;
+}
+#endif
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+#include "rle_encoder.hpp"
+
+// Draws a knob with a soft edge and a pointer, encoded in each RleImage
+// format, at a few positions partly off screen and with the image alpha,
+// and checks every pixel on screen against blending the encoded pixels in
+// software. Then times decoding and drawing alone, without sending, and
+// prints how many bytes of image are read per draw against the raw pixels.
+
+ILI9341UiDriver driver;
+
+static constexpr uint16_t size = 96;
+
+// 0xAARRGGBB knob: shaded rings, a pointer and a two pixel soft edge
+static std::vector<uint32_t> MakeKnob()
+{
+    std::vector<uint32_t> argb(size * size);
+    float                 c = (size - 1) / 2.f;
+    for(int y = 0; y < size; y++)
+    {
+        for(int x = 0; x < size; x++)
+        {
+            float   d     = std::hypot(x - c, y - c);
+            float   edge  = std::clamp((c - d) / 2, 0.f, 1.f);
+            uint8_t alpha = edge * 255;
+            uint8_t shade = 60 + int(d / c * 8) * 20;
+            uint32_t rgb  = shade << 16 | shade << 8 | (shade / 2 + 100);
+            // Pointer towards the top right
+            if(std::abs((x - c) + (y - c)) < 3 && x > c && d < c - 8)
+            {
+                rgb = 0xFFA000;
+            }
+            argb[y * size + x] = uint32_t(alpha) << 24 | rgb;
+        }
+    }
+    return argb;
+}
+
+struct Placement
+{
+    int16_t x, y;
+    uint8_t alpha;
+};
+
+static const Placement placements[] = {{10, 10, 255},
+                                       {60, 40, 255},
+                                       {-30, 150, 255},
+                                       {260, -20, 255},
+                                       {150, 120, 128},
+                                       {240, 170, 200}};
+
+// Blends the image into screen the way DrawImage() is meant to
+static void Expect(const RleImage&        image,
+                   std::vector<uint16_t>& screen,
+                   const Placement&       at)
+{
+    for(uint16_t row = 0; row < image.Height(); row++)
+    {
+        int16_t y = at.y + row;
+        image.DecodeRow(
+            row,
+            [&](RleImage::Op op, uint16_t x0, uint16_t n, const uint8_t* p)
+            {
+                for(uint16_t i = 0; i < n; i++)
+                {
+                    auto pixel = op == RleImage::Op::Run
+                                     ? p
+                                     : p + i * image.PixelSize();
+                    int16_t  x = at.x + x0 + i;
+                    uint16_t color;
+                    uint8_t  a = at.alpha;
+                    switch(image.GetFormat())
+                    {
+                        case RleImage::Format::ARGB4444:
+                            color = RleImage::Argb4444ToRgb565(
+                                RleImage::Read16(pixel));
+                            a = RleImage::Argb4444Alpha(
+                                    RleImage::Read16(pixel))
+                                    * (at.alpha + 1)
+                                >> 8;
+                            break;
+                        case RleImage::Format::L8:
+                            color = image.PaletteColor(*pixel);
+                            break;
+                        default: color = RleImage::Read16(pixel); break;
+                    }
+                    if(x >= 0 && x < 320 && y >= 0 && y < 240 && a > 0)
+                    {
+                        auto& dst = screen[y * 320 + x];
+                        dst       = Blend565(color, dst, a);
+                    }
+                }
+            });
+    }
+}
+
+// Largest difference of a channel, in its own bits
+static int Difference(uint16_t a, uint16_t b)
+{
+    int r = std::abs((a >> 11) - (b >> 11));
+    int g = std::abs((a >> 5 & 0x3F) - (b >> 5 & 0x3F));
+    int l = std::abs((a & 0x1F) - (b & 0x1F));
+    return std::max({r, g, l});
+}
+
+static void Check(const char* name, const RleImage& image)
+{
+    driver.Fill(COLOR_BLUE);
+    driver.Update();
+    while(!driver.IsRender()) {}
+    std::vector<uint16_t> screen(320 * 240, host_panel.GetPixel(0, 0));
+
+    for(auto& at : placements)
+    {
+        driver.DrawImage(image.Data(), at.x, at.y, at.alpha);
+        Expect(image, screen, at);
+    }
+    driver.Update();
+    while(!driver.IsRender()) {}
+
+    uint32_t mismatches = 0;
+    int      worst      = 0;
+    for(uint16_t y = 0; y < 240; y++)
+    {
+        for(uint16_t x = 0; x < 320; x++)
+        {
+            int d = Difference(host_panel.GetPixel(x, y), screen[y * 320 + x]);
+            mismatches += d != 0;
+            worst = std::max(worst, d);
+        }
+    }
+    printf("%-9s %5u bytes (%5u raw), %u pixels off by up to %d\n",
+           name,
+           image.Size(),
+           size * size * 2,
+           mismatches,
+           worst);
+}
+
+#ifndef ILI9341_BAND_RENDERER
+static void Time(const char* name, const RleImage& image)
+{
+    static constexpr int rounds = 2000;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        driver.DrawImage(image.Data(), i % 200, i % 120);
+    }
+    driver.Update();
+    while(!driver.IsRender()) {}
+    std::chrono::duration<double, std::micro> elapsed
+        = std::chrono::steady_clock::now() - start;
+    printf("%-9s %6.1f Mpixel/s\n",
+           name,
+           double(size) * size * rounds / elapsed.count());
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    static const char* const names[] = {"rgb565", "argb4444", "l8"};
+
+    auto argb = MakeKnob();
+    driver.Init();
+
+    std::vector<uint8_t> images[3];
+    for(int f = 0; f < 3; f++)
+    {
+        images[f] = EncodeRleImage(
+            argb.data(), size, size, static_cast<RleImage::Format>(f));
+        Check(names[f], RleImage(images[f].data()));
+    }
+#ifndef ILI9341_BAND_RENDERER
+    for(int f = 0; f < 3; f++)
+    {
+        Time(names[f], RleImage(images[f].data()));
+    }
+#endif
+
+    if(argc > 1)
+    {
+        return !host_panel.WritePpm(argv[1]);
+    }
+    return 0;
+}
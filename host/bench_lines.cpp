@@ -0,0 +1,213 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+#include "stm32h7xx_hal.h"
+
+// Checks DrawLine() against the per pixel Bresenham the driver had before,
+// which is kept here, over thousands of random lines: short and long, steep
+// and flat, axis aligned and reaching off the right and bottom edges (the
+// coordinates are unsigned). Both must set the same pixels. Then times both
+// for each kind of line, the old one painting pixels into a frame of its own
+// as DrawPixel() did. Runs of 64 pixels or more go to the DMA2D, which the
+// host runs in software when they are queued. That time is shown on its own,
+// as on the target the DMA2D works alongside the CPU. Build it with -O2 for
+// the timings; with ILI9341_BAND_RENDERER DrawLine() only records the line.
+
+ILI9341UiDriver driver;
+
+static constexpr int width = 320, height = 240;
+static constexpr int lines = 4000, per_frame = 100, runs = 5;
+
+struct Line
+{
+    int16_t x0, y0, x1, y1;
+    uint8_t color;
+};
+
+static const char* kinds[] = {"short", "anywhere", "axis aligned", "trace"};
+
+static uint16_t    frame[height][width]; // in the frame buffer's byte order
+static uint16_t    palette[NUMBER_OF_TFT_COLORS];
+static DirtyRegion old_dirty;
+
+// What DrawPixel() and PaintPixel() did for every pixel
+static void OldPixel(uint_fast16_t x,
+                     uint_fast16_t y,
+                     uint8_t       color,
+                     uint8_t       alpha)
+{
+    if(x >= width || y >= height)
+        return;
+    auto pixel = &frame[y][x];
+    auto value = palette[color];
+    if(alpha != 255)
+    {
+        value = Blend565(value, FrameBufferPixel(*pixel), alpha);
+    }
+    *pixel = FrameBufferPixel(value);
+}
+
+// The line drawing DrawLine() replaced, which also marked the line dirty
+static void OldLine(const Line& line, uint8_t alpha = 255)
+{
+    int_fast16_t x1 = line.x0, y1 = line.y0, x2 = line.x1, y2 = line.y1;
+    old_dirty.Add(
+        std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2));
+
+    auto deltaX = abs(x2 - x1);
+    auto deltaY = abs(y2 - y1);
+    auto signX  = ((x1 < x2) ? 1 : -1);
+    auto signY  = ((y1 < y2) ? 1 : -1);
+    auto error  = deltaX - deltaY;
+
+    OldPixel(x2, y2, line.color, alpha);
+    while((x1 != x2) || (y1 != y2))
+    {
+        OldPixel(x1, y1, line.color, alpha);
+        auto error2 = error * 2;
+        if(error2 > -deltaY)
+        {
+            error -= deltaY;
+            x1 += signX;
+        }
+        if(error2 < deltaX)
+        {
+            error += deltaX;
+            y1 += signY;
+        }
+    }
+}
+
+static std::vector<Line> MakeLines()
+{
+    std::vector<Line> made;
+    for(int i = 0; i < lines; i++)
+    {
+        Line line;
+        line.x0    = rand() % (width + 20);
+        line.y0    = rand() % (height + 20);
+        line.color = 1 + rand() % (NUMBER_OF_TFT_COLORS - 1);
+        switch(i % std::size(kinds))
+        {
+            case 0: // short, as in a meter or a knob
+                line.x1 = std::max(line.x0 + rand() % 31 - 15, 0);
+                line.y1 = std::max(line.y0 + rand() % 31 - 15, 0);
+                break;
+            case 1: // anywhere
+                line.x1 = rand() % (width + 20);
+                line.y1 = rand() % (height + 20);
+                break;
+            case 2: // a grid line
+                line.x1 = rand() % 2 ? line.x0 : rand() % width;
+                line.y1 = line.x1 == line.x0 ? rand() % height : line.y0;
+                break;
+            case 3: // a scope trace segment
+                line.x1 = line.x0 + 1 + rand() % 3;
+                line.y1 = rand() % height;
+                break;
+        }
+        made.push_back(line);
+    }
+    return made;
+}
+
+// Pixels where the panel doesn't show what OldLine() drew
+static int Check(const std::vector<Line>& made)
+{
+    int failures = 0;
+    for(int first = 0; first < lines; first += per_frame)
+    {
+        // Clearing the screen also empties the band renderer's list
+        driver.Fill(COLOR_BLACK);
+        std::fill(&frame[0][0],
+                  &frame[0][0] + width * height,
+                  FrameBufferPixel(palette[0]));
+        for(int i = first; i < first + per_frame; i++)
+        {
+            auto& line = made[i];
+            driver.DrawLine(line.x0, line.y0, line.x1, line.y1, line.color);
+            OldLine(line);
+        }
+        driver.Update();
+        while(!driver.IsRender()) {}
+        for(uint16_t y = 0; y < height; y++)
+        {
+            for(uint16_t x = 0; x < width; x++)
+            {
+                uint16_t drawn = FrameBufferPixel(frame[y][x]);
+                failures += host_panel.GetPixel(x, y) != drawn;
+            }
+        }
+    }
+    return failures;
+}
+
+// Microseconds to draw every line of kind, the best of a few runs
+template <typename Draw>
+static double Time(const std::vector<Line>& made, size_t kind, Draw draw)
+{
+    double best = 1e12;
+    for(int run = 0; run < runs; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = kind; i < made.size(); i += std::size(kinds))
+        {
+            draw(made[i]);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(
+            best, std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    return best;
+}
+
+int main()
+{
+    driver.Init();
+    for(uint8_t color = 0; color < NUMBER_OF_TFT_COLORS; color++)
+    {
+        driver.FillRect(Rectangle(color, 0, 1, 1), color);
+    }
+    driver.Update();
+    while(!driver.IsRender()) {}
+    for(uint8_t color = 0; color < NUMBER_OF_TFT_COLORS; color++)
+    {
+        palette[color] = host_panel.GetPixel(color, 0);
+    }
+
+    srand(3);
+    auto made     = MakeLines();
+    int  failures = Check(made);
+    printf("pixels unlike the old lines  %d\n", failures);
+
+    printf("%d lines of each kind  per pixel  DrawLine()  "
+           "+ software DMA2D\n",
+           lines / int(std::size(kinds)));
+    for(size_t kind = 0; kind < std::size(kinds); kind++)
+    {
+        // Both start with nothing dirty
+        old_dirty.Init(width, height);
+        driver.Update();
+        while(!driver.IsRender()) {}
+
+        double old_us
+            = Time(made, kind, [](const Line& line) { OldLine(line); });
+        host_dma2d_stats = {};
+        double new_us    = Time(made,
+                             kind,
+                             [](const Line& l) {
+                                 driver.DrawLine(l.x0, l.y0, l.x1, l.y1, l.color);
+                             });
+        double dma2d_us = host_dma2d_stats.busy_ns / 1e3 / runs;
+        printf("%-22s %7.1f us %8.1f us %8.1f us, %llu pixels\n",
+               kinds[kind],
+               old_us,
+               new_us - dma2d_us,
+               dma2d_us,
+               static_cast<unsigned long long>(host_dma2d_stats.pixels / runs));
+    }
+    return failures != 0;
+}
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+
+// Checks PolygonRaster pixel for pixel: a jittered grid of triangles, reaching
+// off screen, must cover every pixel once, with and without a scissor, a
+// convex polygon must fill what its triangle fan does, and a translucent mesh
+// drawn through the driver must come out even. Then times the rasterizer
+// against the Adafruit-GFX style triangle filler the driver used before.
+
+ILI9341UiDriver driver;
+
+using Vertex = PolygonRaster::Vertex;
+
+static constexpr int     screen_w = 320, screen_h = 240;
+static constexpr int     rounds   = 2000;
+static constexpr int16_t grid_x0 = -40, grid_y0 = -30, cell = 40;
+static constexpr int     cells_x = 10, cells_y = 8;
+
+// Times each pixel was filled
+struct Coverage
+{
+    std::vector<uint8_t> count = std::vector<uint8_t>(screen_w * screen_h);
+
+    void operator()(int32_t x0, int32_t x1, int32_t y)
+    {
+        for(int32_t x = x0; x <= x1; x++)
+        {
+            count[y * screen_w + x]++;
+        }
+    }
+};
+
+// Grid corners, the inner ones moved by up to 8 pixels each way, which
+// keeps every cell convex
+static std::vector<Vertex> Grid()
+{
+    std::vector<Vertex> grid;
+    for(int j = 0; j <= cells_y; j++)
+    {
+        for(int i = 0; i <= cells_x; i++)
+        {
+            bool    inner = i > 0 && i < cells_x && j > 0 && j < cells_y;
+            int16_t dx    = inner ? rand() % 17 - 8 : 0;
+            int16_t dy    = inner ? rand() % 17 - 8 : 0;
+            grid.push_back(Vertex{int16_t(grid_x0 + i * cell + dx),
+                                  int16_t(grid_y0 + j * cell + dy)});
+        }
+    }
+    return grid;
+}
+
+// Calls triangle(a, b, c) for the two triangles of each grid cell, split
+// along alternating diagonals and wound both ways
+template <typename Triangle>
+static void Mesh(const std::vector<Vertex>& grid, Triangle triangle)
+{
+    auto at = [&](int i, int j) { return grid[j * (cells_x + 1) + i]; };
+    for(int j = 0; j < cells_y; j++)
+    {
+        for(int i = 0; i < cells_x; i++)
+        {
+            Vertex a = at(i, j), b = at(i + 1, j);
+            Vertex c = at(i + 1, j + 1), d = at(i, j + 1);
+            if((i + j) % 2)
+            {
+                triangle(a, b, c);
+                triangle(d, c, a);
+            }
+            else
+            {
+                triangle(a, b, d);
+                triangle(b, d, c);
+            }
+        }
+    }
+}
+
+// Pixels the grid should fill once but doesn't, within clip
+static int CheckMesh(const PolygonRaster::Clip& clip)
+{
+    int failures = 0;
+    for(int round = 0; round < 50; round++)
+    {
+        auto     grid = Grid();
+        Coverage coverage;
+        Mesh(grid,
+             [&](Vertex a, Vertex b, Vertex c)
+             {
+                 PolygonRaster::Triangle(
+                     a.x, a.y, b.x, b.y, c.x, c.y, clip, coverage);
+             });
+        for(int y = 0; y < screen_h; y++)
+        {
+            for(int x = 0; x < screen_w; x++)
+            {
+                bool inside = x >= clip.x0 && x <= clip.x1 && y >= clip.y0
+                              && y <= clip.y1;
+                failures += coverage.count[y * screen_w + x] != inside;
+            }
+        }
+    }
+    return failures;
+}
+
+static int64_t Cross(Vertex o, Vertex a, Vertex b)
+{
+    return int64_t(a.x - o.x) * (b.y - o.y) - int64_t(a.y - o.y) * (b.x - o.x);
+}
+
+// Polygons, or pixels of them, that don't match their triangle fan
+static int CheckFans()
+{
+    static constexpr PolygonRaster::Clip screen
+        = {0, 0, screen_w - 1, screen_h - 1};
+    int failures = 0, polygons = 0;
+    while(polygons < 2000)
+    {
+        // Corners at sorted angles around a circle, partly off screen
+        int    count = 3 + rand() % 14;
+        double angles[16];
+        for(int i = 0; i < count; i++)
+        {
+            angles[i] = rand() * 6.2831853 / RAND_MAX;
+        }
+        std::sort(angles, angles + count);
+        int    radius = 20 + rand() % 150;
+        int    cx = rand() % 400 - 40, cy = rand() % 320 - 40;
+        bool   reverse = rand() % 2; // either winding
+        Vertex v[16];
+        for(int i = 0; i < count; i++)
+        {
+            int k = reverse ? count - 1 - i : i;
+            v[k]  = Vertex{int16_t(cx + radius * cos(angles[i])),
+                          int16_t(cy + radius * sin(angles[i]))};
+        }
+        // Rounding may have made it concave or left a corner in line
+        bool convex = true;
+        for(int i = 0; i < count && convex; i++)
+        {
+            int64_t turn
+                = Cross(v[i], v[(i + 1) % count], v[(i + 2) % count]);
+            convex = turn != 0 && (turn > 0) == (Cross(v[0], v[1], v[2]) > 0);
+        }
+        if(!convex)
+        {
+            continue;
+        }
+        polygons++;
+
+        Coverage polygon, fan;
+        PolygonRaster::Convex(v, count, screen, polygon);
+        for(int i = 1; i + 1 < count; i++)
+        {
+            PolygonRaster::Triangle(v[0].x,
+                                    v[0].y,
+                                    v[i].x,
+                                    v[i].y,
+                                    v[i + 1].x,
+                                    v[i + 1].y,
+                                    screen,
+                                    fan);
+        }
+        failures += polygon.count != fan.count;
+    }
+    return failures;
+}
+
+// Pixels of a half transparent mesh over the screen that differ from the
+// first one
+static int CheckBlend()
+{
+    auto grid = Grid();
+    driver.Fill(COLOR_BLACK);
+    Mesh(grid,
+         [&](Vertex a, Vertex b, Vertex c)
+         {
+             driver.FillTriangle(
+                 a.x, a.y, b.x, b.y, c.x, c.y, COLOR_WHITE, 128);
+         });
+    driver.Update();
+    while(!driver.IsRender()) {}
+
+    int      failures = host_panel.GetPixel(0, 0) == 0;
+    uint16_t first    = host_panel.GetPixel(0, 0);
+    for(int y = 0; y < screen_h; y++)
+    {
+        for(int x = 0; x < screen_w; x++)
+        {
+            failures += host_panel.GetPixel(x, y) != first;
+        }
+    }
+    return failures;
+}
+
+// The triangle filler the driver had before PolygonRaster, spans to sink
+template <typename Sink>
+static void OldTriangle(int16_t x0,
+                        int16_t y0,
+                        int16_t x1,
+                        int16_t y1,
+                        int16_t x2,
+                        int16_t y2,
+                        Sink&   sink)
+{
+    auto span = [&](int16_t a, int16_t b, int16_t y)
+    {
+        if(a > b)
+        {
+            std::swap(a, b);
+        }
+        a = std::max<int16_t>(a, 0);
+        b = std::min<int16_t>(b, screen_w - 1);
+        if(y >= 0 && y < screen_h && a <= b)
+        {
+            sink(a, b, y);
+        }
+    };
+    if(y0 > y1)
+    {
+        std::swap(y0, y1);
+        std::swap(x0, x1);
+    }
+    if(y1 > y2)
+    {
+        std::swap(y2, y1);
+        std::swap(x2, x1);
+    }
+    if(y0 > y1)
+    {
+        std::swap(y0, y1);
+        std::swap(x0, x1);
+    }
+    if(y0 == y2)
+    {
+        span(std::min({x0, x1, x2}), std::max({x0, x1, x2}), y0);
+        return;
+    }
+    int16_t dx01 = x1 - x0, dy01 = y1 - y0, dx02 = x2 - x0, dy02 = y2 - y0,
+            dx12 = x2 - x1, dy12 = y2 - y1;
+    int32_t sa = 0, sb = 0;
+    int16_t y, last = y1 == y2 ? y1 : y1 - 1;
+    for(y = y0; y <= last; y++)
+    {
+        span(x0 + sa / dy01, x0 + sb / dy02, y);
+        sa += dx01;
+        sb += dx02;
+    }
+    sa = int32_t(dx12) * (y - y1);
+    sb = int32_t(dx02) * (y - y0);
+    for(; y <= y2; y++)
+    {
+        span(x1 + sa / dy12, x0 + sb / dy02, y);
+        sa += dx12;
+        sb += dx02;
+    }
+}
+
+// Sink that only adds up the pixels, so the rasterizers are timed alone
+struct Count
+{
+    uint64_t pixels = 0;
+
+    void operator()(int32_t x0, int32_t x1, int32_t)
+    {
+        pixels += x1 - x0 + 1;
+    }
+};
+
+template <typename Draw>
+static double Time(Draw draw)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        draw(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count()
+           / rounds;
+}
+
+int main(int argc, char** argv)
+{
+    driver.Init();
+    srand(7);
+
+    int mesh     = CheckMesh({0, 0, screen_w - 1, screen_h - 1});
+    int scissor  = CheckMesh({37, 29, 250, 190});
+    int fans     = CheckFans();
+    int blend    = CheckBlend();
+    int failures = mesh + scissor + fans + blend;
+    printf("mesh pixels not filled once      %d\n", mesh);
+    printf("same, scissored                  %d\n", scissor);
+    printf("polygons unlike their fan        %d\n", fans);
+    printf("uneven pixels in blended mesh    %d\n", blend);
+
+    // Triangles as a UI draws them: small, and some large
+    static constexpr PolygonRaster::Clip screen
+        = {0, 0, screen_w - 1, screen_h - 1};
+    std::vector<Vertex> small, large;
+    for(int i = 0; i < 3 * 256; i++)
+    {
+        small.push_back(Vertex{int16_t(rand() % 300), int16_t(rand() % 220)});
+        large.push_back(
+            Vertex{int16_t(rand() % 400 - 40), int16_t(rand() % 300 - 30)});
+    }
+    for(size_t i = 0; i < small.size(); i += 3)
+    {
+        for(int k = 1; k < 3; k++)
+        {
+            small[i + k].x = small[i].x + rand() % 21;
+            small[i + k].y = small[i].y + rand() % 21;
+        }
+    }
+
+    Count count;
+    auto  each = [](const std::vector<Vertex>& v, auto draw)
+    {
+        return [&v, draw](int)
+        {
+            for(size_t i = 0; i < v.size(); i += 3)
+            {
+                draw(v[i], v[i + 1], v[i + 2]);
+            }
+        };
+    };
+    auto old_raster = [&](Vertex a, Vertex b, Vertex c)
+    { OldTriangle(a.x, a.y, b.x, b.y, c.x, c.y, count); };
+    auto new_raster = [&](Vertex a, Vertex b, Vertex c)
+    { PolygonRaster::Triangle(a.x, a.y, b.x, b.y, c.x, c.y, screen, count); };
+    auto fill = [&](Vertex a, Vertex b, Vertex c)
+    { driver.FillTriangle(a.x, a.y, b.x, b.y, c.x, c.y, COLOR_ORANGE); };
+
+    printf("256 small, old raster            %9.2f us\n",
+           Time(each(small, old_raster)));
+    printf("256 small, PolygonRaster         %9.2f us\n",
+           Time(each(small, new_raster)));
+    printf("256 large, old raster            %9.2f us\n",
+           Time(each(large, old_raster)));
+    printf("256 large, PolygonRaster         %9.2f us\n",
+           Time(each(large, new_raster)));
+    printf("256 small, FillTriangle()        %9.2f us\n",
+           Time(each(small, fill)));
+    printf("(%llu pixels counted)\n",
+           static_cast<unsigned long long>(count.pixels));
+
+    if(argc > 1)
+    {
+        driver.Fill(COLOR_BLACK);
+        Vertex hexagon[6] = {
+            {160, 40}, {230, 80}, {230, 160}, {160, 200}, {90, 160}, {90, 80}};
+        driver.FillPolygon(hexagon, 6, COLOR_BLUE);
+        Mesh(Grid(),
+             [&](Vertex a, Vertex b, Vertex c)
+             {
+                 driver.FillTriangle(
+                     a.x, a.y, b.x, b.y, c.x, c.y, rand() % 8, 96);
+             });
+        driver.Update();
+        while(!driver.IsRender()) {}
+        if(!host_panel.WritePpm(argv[1]))
+        {
+            return 1;
+        }
+    }
+    return failures != 0;
+}
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "ili9341_ui_driver.hpp"
+
+// Times filling the screen with text, in Font_7x10, which the CPU draws a
+// row of runs at a time, and in Font_11x18, which the DMA2D draws from the
+// glyph cache (except with ILI9341_INDEXED_FRAMEBUFFER or the band renderer,
+// where the CPU draws it too). After each screen every pixel must be set
+// exactly where the font has a bit. Build it with -O2 for the timings; the
+// host runs the DMA2D in software, so its time is part of the second. The
+// band renderer keeps a screen of Font_7x10 text in its list, which takes
+// -DILI9341_DISPLAY_LIST_TEXT=2048 for every file.
+
+ILI9341UiDriver driver;
+
+static constexpr int width = 320, height = 240;
+static constexpr int rounds = 50;
+
+#ifdef ILI9341_BAND_RENDERER
+static_assert(DisplayList::max_text >= (width / 7 + 1) * (height / 10),
+              "build with -DILI9341_DISPLAY_LIST_TEXT=2048");
+#endif
+
+// Printable characters, shifted along with each line
+static void Line(char* text, int columns, int line)
+{
+    for(int i = 0; i < columns; i++)
+    {
+        text[i] = ' ' + 1 + (line * 7 + i) % (126 - ' ');
+    }
+    text[columns] = 0;
+}
+
+static void Screen(const FontDef& font)
+{
+    char text[width + 1];
+    int  columns = width / font.FontWidth;
+    for(int line = 0; line < height / font.FontHeight; line++)
+    {
+        Line(text, columns, line);
+        driver.WriteString(text, 0, line * font.FontHeight, font, COLOR_WHITE);
+    }
+}
+
+// Pixels unlike the font's bits
+static int Check(const FontDef& font, uint16_t black, uint16_t white)
+{
+    driver.Fill(COLOR_BLACK);
+    Screen(font);
+    driver.Update();
+    while(!driver.IsRender()) {}
+
+    char text[width + 1];
+    int  columns  = width / font.FontWidth;
+    int  lines    = height / font.FontHeight;
+    int  failures = 0;
+    for(int y = 0; y < height; y++)
+    {
+        int line = y / font.FontHeight;
+        Line(text, columns, line);
+        for(int x = 0; x < width; x++)
+        {
+            bool set = false;
+            if(line < lines && x < columns * font.FontWidth)
+            {
+                char ch  = text[x / font.FontWidth];
+                auto row = font.data[(ch - 32) * font.FontHeight
+                                     + y % font.FontHeight];
+                set      = row << (x % font.FontWidth) & 0x8000;
+            }
+            failures += host_panel.GetPixel(x, y) != (set ? white : black);
+        }
+    }
+    return failures;
+}
+
+static double Time(const FontDef& font)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++)
+    {
+        Screen(font);
+        driver.Update();
+        while(!driver.IsRender()) {}
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count()
+           / rounds;
+}
+
+int main()
+{
+    driver.Init();
+    driver.Fill(COLOR_BLACK);
+    driver.FillRect(Rectangle(0, 0, 1, 1), COLOR_WHITE);
+    driver.Update();
+    while(!driver.IsRender()) {}
+    uint16_t white = host_panel.GetPixel(0, 0);
+    uint16_t black = host_panel.GetPixel(1, 0);
+
+    int failures = 0;
+    for(auto font : {&Font_7x10, &Font_11x18})
+    {
+        int wrong = Check(*font, black, white);
+        failures += wrong;
+        int chars = width / font->FontWidth * (height / font->FontHeight);
+        printf("Font_%dx%-3d %4d characters %8.1f us per screen, "
+               "%d pixels wrong\n",
+               font->FontWidth,
+               font->FontHeight,
+               chars,
+               Time(*font),
+               wrong);
+    }
+    return failures != 0;
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include "ili9341_transport.hpp"
+
+// Times setting the address window on the simulated bus: a new window each
+// time, a new row range over the same columns as bands and lines of an area
+// do, and the same window again.
+
+ILI9341SpiTransport transport;
+
+static constexpr int windows = 1000;
+
+template <typename NextWindow>
+static void Run(const char* name, NextWindow next)
+{
+    host_panel.ResetStats();
+    for(int i = 0; i < windows; i++)
+    {
+        DirtyRegion::Area w = next(i);
+        transport.SetAddressWindow(w.x0, w.y0, w.x1, w.y1);
+    }
+    auto& stats = host_panel.GetStats();
+    printf("%-12s %5.2f us, %.0f transfers, %.0f bytes per window\n",
+           name,
+           stats.busy_ns / 1e3 / windows,
+           stats.transfers / double(windows),
+           stats.bytes / double(windows));
+}
+
+int main()
+{
+    transport.Init();
+    transport.Reset();
+#ifdef ILI9341_SPI_16BIT
+    transport.UseWordFrames();
+#endif
+
+    Run("new window",
+        [](int i)
+        {
+            uint16_t x = i % 300, y = i % 220;
+            return DirtyRegion::Area{x, y, uint16_t(x + 19), uint16_t(y + 19)};
+        });
+    Run("new rows",
+        [](int i)
+        {
+            uint16_t y = i % 15 * 16;
+            return DirtyRegion::Area{0, y, 319, uint16_t(y + 15)};
+        });
+    Run("same window",
+        [](int) { return DirtyRegion::Area{0, 0, 319, 239}; });
+    return 0;
+}
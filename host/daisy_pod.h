@@ -0,0 +1,4 @@
+#pragma once
+
+// Host stand-in for libDaisy's daisy_pod.h, the driver doesn't use the Pod
+#include "daisy_seed.h"
@@ -0,0 +1,334 @@
+#pragma once
+
+// Host stand-in for libDaisy's daisy_seed.h, only what the driver uses. The
+// SPI bus and the DC and reset pins lead to host_panel, and System's clock is
+// the time the panel spent on the bus.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include "util/oled_fonts.h"
+#include "hid/disp/graphics_common.h"
+#include "ili9341_panel.hpp"
+
+#define DMA_BUFFER_MEM_SECTION
+#define DSY_SDRAM_BSS
+
+#define ILI9341_BREAKPOINT() abort()
+
+enum dsy_gpio_port
+{
+    DSY_GPIOA,
+    DSY_GPIOB,
+    DSY_GPIOC,
+    DSY_GPIOD,
+    DSY_GPIOE,
+    DSY_GPIOF,
+    DSY_GPIOG,
+    DSY_GPIOH,
+    DSY_GPIOI,
+    DSY_GPIOJ,
+    DSY_GPIOK,
+    DSY_GPIOX,
+};
+
+struct dsy_gpio_pin
+{
+    dsy_gpio_port port;
+    uint8_t       pin;
+
+    bool operator==(const dsy_gpio_pin& other) const
+    {
+        return port == other.port && pin == other.pin;
+    }
+};
+
+namespace daisy
+{
+using Pin = dsy_gpio_pin;
+
+namespace seed
+{
+    constexpr Pin D7  = {DSY_GPIOG, 10};
+    constexpr Pin D8  = {DSY_GPIOG, 11};
+    constexpr Pin D9  = {DSY_GPIOB, 4};
+    constexpr Pin D10 = {DSY_GPIOB, 5};
+    constexpr Pin D11 = {DSY_GPIOB, 8};
+    constexpr Pin D17 = {DSY_GPIOB, 1};
+    constexpr Pin D23 = {DSY_GPIOA, 4};
+} // namespace seed
+
+// Where the panel's DC and reset lines are, as in ILI9341SpiTransport::Init(),
+// and its TE output. D9 is SPI_1's MISO, for the scan line reads.
+inline Pin host_dc_pin    = seed::D17;
+inline Pin host_reset_pin = seed::D23;
+inline Pin host_te_pin    = seed::D11;
+
+// Simulated time each System::GetUs() takes. Code checking the clock between
+// units of work, like the render budget, then sees time pass as it works.
+inline uint64_t host_us_read_ns = 0;
+
+class System
+{
+  public:
+    static uint32_t GetNow() { return host_panel.Now() / 1000000; }
+    static uint32_t GetUs()
+    {
+        host_panel.Wait(host_us_read_ns);
+        return host_panel.Now() / 1000;
+    }
+    static uint32_t GetTick() { return host_panel.Now() / 5; }
+    static uint32_t GetTickFreq() { return 200000000; }
+    static void     Delay(uint32_t ms) { host_panel.Wait(ms * 1000000ull); }
+    static void     DelayUs(uint32_t us) { host_panel.Wait(us * 1000ull); }
+};
+
+class GPIO
+{
+  public:
+    enum class Mode
+    {
+        INPUT,
+        OUTPUT,
+        OPEN_DRAIN,
+        ANALOG,
+    };
+
+    enum class Pull
+    {
+        NOPULL,
+        PULLUP,
+        PULLDOWN,
+    };
+
+    enum class Speed
+    {
+        LOW,
+        MEDIUM,
+        HIGH,
+        VERY_HIGH,
+    };
+
+    void Init(Pin   pin,
+              Mode  mode  = Mode::INPUT,
+              Pull  pull  = Pull::NOPULL,
+              Speed speed = Speed::LOW)
+    {
+        pin_ = pin;
+    }
+
+    void Write(bool state)
+    {
+        state_ = state;
+        if(pin_ == host_dc_pin)
+        {
+            host_panel.SetDataCommand(state);
+        }
+        else if(pin_ == host_reset_pin)
+        {
+            host_panel.SetReset(state);
+        }
+    }
+
+    bool Read()
+    {
+        return pin_ == host_te_pin ? host_panel.TearingEffect() : state_;
+    }
+
+    void Toggle() { Write(!state_); }
+
+  private:
+    Pin  pin_   = {DSY_GPIOX, 0};
+    bool state_ = false;
+};
+
+// Blocking SPI transfers made from a DMA end callback, which on the target
+// runs in the SPI interrupt
+inline uint32_t host_spi_blocking_in_interrupt = 0;
+
+class SpiHandle
+{
+  public:
+    struct Config
+    {
+        enum class Peripheral
+        {
+            SPI_1,
+            SPI_2,
+            SPI_3,
+            SPI_4,
+            SPI_5,
+            SPI_6,
+        };
+
+        enum class Mode
+        {
+            MASTER,
+            SLAVE,
+        };
+
+        enum class Direction
+        {
+            TWO_LINES,
+            TWO_LINES_TX_ONLY,
+            TWO_LINES_RX_ONLY,
+            ONE_LINE,
+        };
+
+        enum class ClockPolarity
+        {
+            LOW,
+            HIGH,
+        };
+
+        enum class ClockPhase
+        {
+            ONE_EDGE,
+            TWO_EDGE,
+        };
+
+        enum class NSS
+        {
+            SOFT,
+            HARD_INPUT,
+            HARD_OUTPUT,
+        };
+
+        enum class BaudPrescaler
+        {
+            PS_2,
+            PS_4,
+            PS_8,
+            PS_16,
+            PS_32,
+            PS_64,
+            PS_128,
+            PS_256,
+        };
+
+        struct
+        {
+            Pin sclk, miso, mosi, nss;
+        } pin_config;
+
+        Peripheral    periph;
+        Mode          mode;
+        Direction     direction;
+        unsigned long datasize;
+        ClockPolarity clock_polarity;
+        ClockPhase    clock_phase;
+        NSS           nss;
+        BaudPrescaler baud_prescaler;
+    };
+
+    enum class Result
+    {
+        OK,
+        ERR,
+    };
+
+    typedef void (*StartCallbackFunctionPtr)(void* context);
+    typedef void (*EndCallbackFunctionPtr)(void* context, Result result);
+
+    Result Init(const Config& config)
+    {
+        frame_bytes_ = config.datasize > 8 ? 2 : 1;
+        return Result::OK;
+    }
+
+    // Sizes count frames, 16 bit ones are sent high byte first
+    Result BlockingTransmit(uint8_t* buff, size_t size, uint32_t timeout = 100)
+    {
+        host_spi_blocking_in_interrupt += completing_;
+        Transfer(buff, size);
+        return Result::OK;
+    }
+
+    Result BlockingReceive(uint8_t* buff, uint16_t size, uint32_t timeout)
+    {
+        host_panel.Read(buff, size * frame_bytes_);
+        if(frame_bytes_ == 2)
+        {
+            for(size_t i = 0; i < size * 2u; i += 2)
+            {
+                std::swap(buff[i], buff[i + 1]);
+            }
+        }
+        return Result::OK;
+    }
+
+    /**
+     * @brief Transfers right away, then completes. Transfers started from the
+     * end callback complete once it returned, so chained transfers don't
+     * nest one call deeper each.
+     */
+    Result DmaTransmit(uint8_t*                 buff,
+                       size_t                   size,
+                       StartCallbackFunctionPtr start_callback,
+                       EndCallbackFunctionPtr   end_callback,
+                       void*                    callback_context)
+    {
+        if(start_callback)
+        {
+            start_callback(callback_context);
+        }
+        Transfer(buff, size);
+
+        pending_callback_ = end_callback;
+        pending_context_  = callback_context;
+        if(completing_)
+        {
+            return Result::OK;
+        }
+        completing_ = true;
+        while(pending_callback_)
+        {
+            auto callback     = pending_callback_;
+            auto context      = pending_context_;
+            pending_callback_ = nullptr;
+            callback(context, Result::OK);
+        }
+        completing_ = false;
+        return Result::OK;
+    }
+
+  private:
+    // size counts frames, as for the HAL
+    void Transfer(const uint8_t* buff, size_t size)
+    {
+        if(frame_bytes_ == 1)
+        {
+            host_panel.Transfer(buff, size);
+            return;
+        }
+        // Words are in memory little endian. Only the bytes passed are
+        // read, an odd one out goes as it is.
+        size_t bytes = size * frame_bytes_;
+        wire_.assign(buff, buff + bytes);
+        for(size_t i = 0; i + 1 < bytes; i += 2)
+        {
+            std::swap(wire_[i], wire_[i + 1]);
+        }
+        host_panel.Transfer(wire_.data(), wire_.size());
+    }
+
+    uint8_t              frame_bytes_ = 1;
+    std::vector<uint8_t> wire_;
+    static inline EndCallbackFunctionPtr pending_callback_ = nullptr;
+    static inline void*                  pending_context_  = nullptr;
+    static inline bool                   completing_       = false;
+};
+
+class DaisySeed
+{
+  public:
+    void Init(bool boost = false) {}
+};
+} // namespace daisy
+
+using UIFont = daisy::FontDef;
@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+
+// Draws the same frames twice, sending only the damaged areas and then the
+// whole frame buffer each time (SetPartialUpdate(false)). Checks that the
+// panel shows the same after every frame, that a frame with nothing drawn
+// (or only an empty string) sends nothing and that nothing blocks on the SPI
+// from its interrupt, and prints the bytes sent per frame both ways.
+
+ILI9341UiDriver driver;
+
+static constexpr int frames = 120;
+
+static void Send()
+{
+    driver.Update();
+    while(!driver.IsRender()) {}
+}
+
+static uint32_t Checksum()
+{
+    uint32_t sum = 0;
+    for(uint16_t y = 0; y < 240; y++)
+    {
+        for(uint16_t x = 0; x < 320; x++)
+        {
+            sum = sum * 31 + host_panel.GetPixel(x, y);
+        }
+    }
+    return sum;
+}
+
+// A 40x12 counter, a level meter and a couple of small primitives somewhere,
+// the kind of frame where little changes
+static void Draw(int frame)
+{
+    char text[12];
+    snprintf(text, sizeof(text), "%04d", frame);
+    driver.FillRect(Rectangle(8, 8, 40, 12), COLOR_BLACK);
+    driver.WriteString(text, 10, 9, Font_7x10, COLOR_WHITE);
+
+    int16_t level = 10 + frame * 37 % 180;
+    driver.FillRect(Rectangle(300, 20, 10, 200 - level), COLOR_DARK_GRAY);
+    driver.FillRect(Rectangle(300, 220 - level, 10, level), COLOR_GREEN);
+
+    int16_t x = rand() % 300, y = rand() % 220;
+    int16_t w = rand() % 20, h = rand() % 20;
+    uint8_t c = rand() % NUMBER_OF_TFT_COLORS;
+    switch(rand() % 6)
+    {
+        case 0: driver.DrawLine(x, y, x + w, y + h, c); break;
+        case 1: driver.DrawRect(Rectangle(x, y, 12, 9), c); break;
+        case 2: driver.FillCircle(x + 8, y + 8, w / 3, c); break;
+        case 3:
+            driver.FillTriangle(x, y, x + 15, y + 3, x + 6, y + 14, c);
+            break;
+        case 4: driver.WriteString("ok", x, y, Font_6x8, c); break;
+        case 5: driver.FillRect(Rectangle(x, y, 16, 16), c, 128); break;
+    }
+}
+
+// Bytes sent per frame, and the panel after each
+static double Run(bool partial, std::vector<uint32_t>& shown)
+{
+    driver.SetPartialUpdate(true);
+    driver.Fill(COLOR_BLACK);
+    Send();
+
+    srand(11);
+    driver.SetPartialUpdate(partial);
+    host_panel.ResetStats();
+    for(int frame = 0; frame < frames; frame++)
+    {
+        Draw(frame);
+        Send();
+        shown.push_back(Checksum());
+    }
+    return host_panel.GetStats().bytes / double(frames);
+}
+
+int main()
+{
+    driver.Init();
+
+    std::vector<uint32_t> full, partial;
+    double                full_bytes    = Run(false, full);
+    double                partial_bytes = Run(true, partial);
+
+    int mismatches = 0;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        mismatches += full[frame] != partial[frame];
+    }
+
+    host_panel.ResetStats();
+    Send();
+    uint64_t idle = host_panel.GetStats().bytes;
+
+    // An empty string damages nothing
+    host_panel.ResetStats();
+    driver.WriteString("", 100, 100, Font_7x10, COLOR_WHITE);
+    Send();
+    idle += host_panel.GetStats().bytes;
+
+    printf("full frames     %8.0f bytes per frame\n", full_bytes);
+    printf("damaged areas   %8.0f bytes per frame, %.1f%%\n",
+           partial_bytes,
+           100 * partial_bytes / full_bytes);
+    printf("%d of %d frames differ, %llu bytes sent for frames without "
+           "drawing\n",
+           mismatches,
+           frames,
+           static_cast<unsigned long long>(idle));
+    printf("%u blocking transfers from the SPI interrupt\n",
+           host_spi_blocking_in_interrupt);
+    return mismatches != 0 || idle != 0 || partial_bytes >= full_bytes
+           || host_spi_blocking_in_interrupt != 0;
+}
@@ -0,0 +1,470 @@
+#include "stm32h7xx_hal.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+// Software DMA2D: runs what the registers describe, pixel by pixel, the way
+// the reference manual has it. Pixels go through ARGB8888 on their way from
+// the inputs to the output, like in the peripheral.
+
+DMA2D_TypeDef  host_dma2d;
+HostDma2DStats host_dma2d_stats;
+bool           host_dma2d_deferred = false;
+
+// Set once a deferred transfer is started, cleared by whoever completes it,
+// which may be another thread standing in for the peripheral
+static std::atomic<bool> pending{false};
+
+namespace
+{
+struct Argb
+{
+    uint8_t a, r, g, b;
+};
+
+// Bits per pixel of a format, 0 for the ones this DMA2D can't convert
+uint8_t InputBits(uint32_t color_mode)
+{
+    switch(color_mode)
+    {
+        case DMA2D_INPUT_ARGB8888: return 32;
+        case DMA2D_INPUT_RGB888: return 24;
+        case DMA2D_INPUT_RGB565:
+        case DMA2D_INPUT_ARGB1555:
+        case DMA2D_INPUT_ARGB4444: return 16;
+        case DMA2D_INPUT_A8: return 8;
+        case DMA2D_INPUT_A4: return 4;
+        default: return 0; // CLUT formats, no CLUT is loaded
+    }
+}
+
+// Narrower channels are widened by repeating their top bits
+uint8_t Expand(uint32_t value, uint8_t bits)
+{
+    value &= (1u << bits) - 1;
+    return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+// A layer as its PFCCR, COLR and memory describe it
+struct Layer
+{
+    const uint8_t* memory;
+    uint32_t       offset; // pixels skipped after each line
+    uint32_t       pfccr;
+    uint32_t       colr;
+
+    uint32_t ColorMode() const { return pfccr & DMA2D_FGPFCCR_CM; }
+
+    Argb Read(uint32_t x, uint32_t y, uint32_t width) const
+    {
+        uint32_t n    = y * (width + offset) + x;
+        auto     bits = InputBits(ColorMode());
+        auto     p    = memory + n * bits / 8;
+        uint32_t word = 0;
+        memcpy(&word, p, bits >= 8 ? bits / 8 : 1);
+
+        Argb color = {0xFF,
+                      uint8_t(colr >> 16),
+                      uint8_t(colr >> 8),
+                      uint8_t(colr)};
+        switch(ColorMode())
+        {
+            case DMA2D_INPUT_ARGB8888:
+                color = {uint8_t(word >> 24),
+                         uint8_t(word >> 16),
+                         uint8_t(word >> 8),
+                         uint8_t(word)};
+                break;
+            case DMA2D_INPUT_RGB888:
+                color = {0xFF,
+                         uint8_t(word >> 16),
+                         uint8_t(word >> 8),
+                         uint8_t(word)};
+                break;
+            case DMA2D_INPUT_RGB565:
+                color = {0xFF,
+                         Expand(word >> 11, 5),
+                         Expand(word >> 5, 6),
+                         Expand(word, 5)};
+                break;
+            case DMA2D_INPUT_ARGB1555:
+                color = {uint8_t(word & 0x8000 ? 0xFF : 0),
+                         Expand(word >> 10, 5),
+                         Expand(word >> 5, 5),
+                         Expand(word, 5)};
+                break;
+            case DMA2D_INPUT_ARGB4444:
+                color = {Expand(word >> 12, 4),
+                         Expand(word >> 8, 4),
+                         Expand(word >> 4, 4),
+                         Expand(word, 4)};
+                break;
+            case DMA2D_INPUT_A8: color.a = word; break;
+            case DMA2D_INPUT_A4:
+                // The first pixel of a byte is in its low nibble
+                color.a = Expand(n & 1 ? word >> 4 : word, 4);
+                break;
+        }
+        return Modify(color);
+    }
+
+    // Alpha mode, alpha inversion and red/blue swap
+    Argb Modify(Argb color) const
+    {
+        uint8_t alpha = pfccr >> 24;
+        switch((pfccr & DMA2D_FGPFCCR_AM) >> 16)
+        {
+            case DMA2D_REPLACE_ALPHA: color.a = alpha; break;
+            case DMA2D_COMBINE_ALPHA: color.a = color.a * alpha / 255; break;
+        }
+        if(pfccr & DMA2D_FGPFCCR_AI)
+        {
+            color.a = 255 - color.a;
+        }
+        if(pfccr & DMA2D_FGPFCCR_RBS)
+        {
+            std::swap(color.r, color.b);
+        }
+        return color;
+    }
+
+    // A whole layer of COLR, for the blending modes with a fixed color
+    Argb Fixed() const
+    {
+        return {uint8_t(pfccr >> 24),
+                uint8_t(colr >> 16),
+                uint8_t(colr >> 8),
+                uint8_t(colr)};
+    }
+};
+
+uint8_t Mix(uint8_t fg, uint8_t bg, uint32_t fg_a, uint32_t bg_a, uint32_t a)
+{
+    // Reference manual: Cout = (Cfg.αfg + Cbg.αbg - Cbg.αmult) / αout
+    auto mult = fg_a * bg_a / 255;
+    return (fg * fg_a + bg * bg_a - bg * mult) / a;
+}
+
+Argb Blend(Argb fg, Argb bg)
+{
+    uint32_t mult = fg.a * bg.a / 255;
+    uint32_t a    = fg.a + bg.a - mult;
+    if(a == 0)
+    {
+        return {0, 0, 0, 0};
+    }
+    return {uint8_t(a),
+            Mix(fg.r, bg.r, fg.a, bg.a, a),
+            Mix(fg.g, bg.g, fg.a, bg.a, a),
+            Mix(fg.b, bg.b, fg.a, bg.a, a)};
+}
+
+uint8_t OutputBytes(uint32_t color_mode)
+{
+    switch(color_mode)
+    {
+        case DMA2D_OUTPUT_ARGB8888: return 4;
+        case DMA2D_OUTPUT_RGB888: return 3;
+        default: return 2;
+    }
+}
+
+// Output pixels are truncated to the output format, alpha included
+uint32_t Pack(Argb c, uint32_t opfccr)
+{
+    if(opfccr & DMA2D_OPFCCR_AI)
+    {
+        c.a = 255 - c.a;
+    }
+    if(opfccr & DMA2D_OPFCCR_RBS)
+    {
+        std::swap(c.r, c.b);
+    }
+    switch(opfccr & DMA2D_OPFCCR_CM)
+    {
+        case DMA2D_OUTPUT_ARGB8888:
+            return uint32_t(c.a) << 24 | c.r << 16 | c.g << 8 | c.b;
+        case DMA2D_OUTPUT_RGB888: return c.r << 16 | c.g << 8 | c.b;
+        case DMA2D_OUTPUT_ARGB1555:
+            return (c.a >> 7) << 15 | (c.r >> 3) << 10 | (c.g >> 3) << 5
+                   | c.b >> 3;
+        case DMA2D_OUTPUT_ARGB4444:
+            return (c.a >> 4) << 12 | (c.r >> 4) << 8 | (c.g >> 4) << 4
+                   | c.b >> 4;
+        default: return (c.r >> 3) << 11 | (c.g >> 2) << 5 | c.b >> 3;
+    }
+}
+
+void Store(uint8_t* p, uint32_t value, uint8_t bytes, bool swap)
+{
+    memcpy(p, &value, bytes);
+    if(swap)
+    {
+        // Bytes are swapped two by two
+        for(uint8_t i = 0; i + 1 < bytes; i += 2)
+        {
+            std::swap(p[i], p[i + 1]);
+        }
+    }
+}
+
+// Returns false on a configuration the DMA2D would reject
+bool Run(const DMA2D_TypeDef& regs)
+{
+    uint32_t mode   = regs.CR.value & DMA2D_CR_MODE;
+    uint32_t width  = (regs.NLR & DMA2D_NLR_PL) >> 16;
+    uint32_t height = regs.NLR & DMA2D_NLR_NL;
+    Layer    fg     = {reinterpret_cast<const uint8_t*>(regs.FGMAR),
+                       regs.FGOR,
+                       regs.FGPFCCR,
+                       regs.FGCOLR};
+    Layer    bg     = {reinterpret_cast<const uint8_t*>(regs.BGMAR),
+                       regs.BGOR,
+                       regs.BGPFCCR,
+                       regs.BGCOLR};
+    auto     output = reinterpret_cast<uint8_t*>(regs.OMAR);
+    bool     swap   = regs.OPFCCR & DMA2D_OPFCCR_SB;
+    uint8_t  bytes  = OutputBytes(regs.OPFCCR & DMA2D_OPFCCR_CM);
+
+    bool reads_fg = mode != DMA2D_R2M && mode != DMA2D_M2M_BLEND_FG;
+    bool reads_bg = mode == DMA2D_M2M_BLEND || mode == DMA2D_M2M_BLEND_FG;
+    if(mode == DMA2D_M2M)
+    {
+        // Copies pixels as they are, only their size matters
+        bytes = InputBits(fg.ColorMode()) / 8;
+        if(fg.ColorMode() == DMA2D_INPUT_L8)
+        {
+            bytes = 1;
+        }
+        if(bytes == 0)
+        {
+            return false;
+        }
+    }
+    else if((reads_fg && InputBits(fg.ColorMode()) == 0)
+            || (reads_bg && InputBits(bg.ColorMode()) == 0))
+    {
+        return false;
+    }
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        auto line = output + y * (width + regs.OOR) * bytes;
+        for(uint32_t x = 0; x < width; x++)
+        {
+            auto p = line + x * bytes;
+            switch(mode)
+            {
+                case DMA2D_R2M: Store(p, regs.OCOLR, bytes, swap); break;
+                case DMA2D_M2M:
+                    memcpy(p,
+                           fg.memory + (y * (width + fg.offset) + x) * bytes,
+                           bytes);
+                    break;
+                case DMA2D_M2M_PFC:
+                    Store(p, Pack(fg.Read(x, y, width), regs.OPFCCR), bytes,
+                          swap);
+                    break;
+                case DMA2D_M2M_BLEND:
+                    Store(p,
+                          Pack(Blend(fg.Read(x, y, width),
+                                     bg.Read(x, y, width)),
+                               regs.OPFCCR),
+                          bytes,
+                          swap);
+                    break;
+                case DMA2D_M2M_BLEND_FG:
+                    Store(p,
+                          Pack(Blend(fg.Fixed(), bg.Read(x, y, width)),
+                               regs.OPFCCR),
+                          bytes,
+                          swap);
+                    break;
+                case DMA2D_M2M_BLEND_BG:
+                    Store(p,
+                          Pack(Blend(fg.Read(x, y, width), bg.Fixed()),
+                               regs.OPFCCR),
+                          bytes,
+                          swap);
+                    break;
+                default: return false;
+            }
+        }
+    }
+
+    host_dma2d_stats.transfers++;
+    host_dma2d_stats.pixels += width * height;
+    return true;
+}
+} // namespace
+
+DMA2D_ControlRegister& DMA2D_ControlRegister::operator=(uint32_t cr)
+{
+    value = cr;
+    if(!(cr & DMA2D_CR_START))
+    {
+        return *this;
+    }
+
+    if(host_dma2d_deferred)
+    {
+        pending.store(true, std::memory_order_release);
+        return *this;
+    }
+    // Done as soon as it started, the interrupt comes right away
+    Finish();
+    return *this;
+}
+
+void DMA2D_ControlRegister::Finish()
+{
+    auto start = std::chrono::steady_clock::now();
+    bool ok    = Run(host_dma2d);
+    host_dma2d_stats.busy_ns += std::chrono::nanoseconds(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+    value &= ~DMA2D_CR_START;
+    host_dma2d.ISR = ok ? DMA2D_ISR_TCIF : DMA2D_ISR_CEIF;
+    if(value & (ok ? DMA2D_CR_TCIE : DMA2D_CR_CEIE))
+    {
+        DMA2D_IRQHandler();
+    }
+}
+
+bool HostDma2DComplete()
+{
+    if(!pending.exchange(false, std::memory_order_acquire))
+    {
+        return false;
+    }
+    host_dma2d.CR.Finish();
+    return true;
+}
+
+HAL_StatusTypeDef HAL_DMA2D_Init(DMA2D_HandleTypeDef* hdma2d)
+{
+    HAL_DMA2D_MspInit(hdma2d);
+
+    auto& init = hdma2d->Init;
+    auto  regs = hdma2d->Instance;
+    MODIFY_REG(regs->CR, DMA2D_CR_MODE, init.Mode);
+    MODIFY_REG(regs->OPFCCR,
+               DMA2D_OPFCCR_CM | DMA2D_OPFCCR_SB,
+               init.ColorMode | init.BytesSwap << 8);
+    MODIFY_REG(regs->OOR, 0xFFFFu, init.OutputOffset);
+    MODIFY_REG(regs->OPFCCR, DMA2D_OPFCCR_AI, init.AlphaInverted << 20);
+    MODIFY_REG(regs->OPFCCR, DMA2D_OPFCCR_RBS, init.RedBlueSwap << 21);
+
+    hdma2d->ErrorCode = HAL_DMA2D_ERROR_NONE;
+    hdma2d->State     = HAL_DMA2D_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA2D_ConfigLayer(DMA2D_HandleTypeDef* hdma2d,
+                                        uint32_t             layer)
+{
+    auto&    cfg   = hdma2d->LayerCfg[layer];
+    uint32_t pfccr = cfg.InputColorMode | cfg.AlphaMode << 16
+                     | cfg.AlphaInverted << 20 | cfg.RedBlueSwap << 21;
+    // For A8 and A4 the input alpha holds the color too
+    bool     mask  = cfg.InputColorMode == DMA2D_INPUT_A8
+                || cfg.InputColorMode == DMA2D_INPUT_A4;
+    pfccr |= mask ? cfg.InputAlpha & DMA2D_FGPFCCR_ALPHA
+                  : cfg.InputAlpha << 24;
+
+    auto regs = hdma2d->Instance;
+    if(layer == 1)
+    {
+        WRITE_REG(regs->FGPFCCR, pfccr);
+        WRITE_REG(regs->FGOR, cfg.InputOffset);
+        if(mask)
+        {
+            WRITE_REG(regs->FGCOLR, cfg.InputAlpha & 0xFFFFFF);
+        }
+    }
+    else
+    {
+        WRITE_REG(regs->BGPFCCR, pfccr);
+        WRITE_REG(regs->BGOR, cfg.InputOffset);
+        if(mask)
+        {
+            WRITE_REG(regs->BGCOLR, cfg.InputAlpha & 0xFFFFFF);
+        }
+    }
+    return HAL_OK;
+}
+
+// Size, output address and the first input, or the color for R2M
+static void SetConfig(DMA2D_HandleTypeDef* hdma2d,
+                      uintptr_t            pdata,
+                      uintptr_t            dst,
+                      uint32_t             width,
+                      uint32_t             height)
+{
+    auto regs = hdma2d->Instance;
+    MODIFY_REG(regs->NLR, DMA2D_NLR_NL | DMA2D_NLR_PL, height | width << 16);
+    WRITE_REG(regs->OMAR, dst);
+    if(hdma2d->Init.Mode != DMA2D_R2M)
+    {
+        WRITE_REG(regs->FGMAR, pdata);
+        return;
+    }
+    // The color comes as ARGB8888 and is packed to the output format
+    uint32_t color = pdata;
+    switch(hdma2d->Init.ColorMode)
+    {
+        case DMA2D_OUTPUT_RGB565:
+            color = (color >> 8 & 0xF800) | (color >> 5 & 0x07E0)
+                    | (color >> 3 & 0x001F);
+            break;
+        case DMA2D_OUTPUT_RGB888: color &= 0xFFFFFF; break;
+        default: break;
+    }
+    WRITE_REG(regs->OCOLR, color);
+}
+
+HAL_StatusTypeDef HAL_DMA2D_Start(DMA2D_HandleTypeDef* hdma2d,
+                                  uintptr_t            pdata,
+                                  uintptr_t            dst,
+                                  uint32_t             width,
+                                  uint32_t             height)
+{
+    hdma2d->State = HAL_DMA2D_STATE_BUSY;
+    SetConfig(hdma2d, pdata, dst, width, height);
+    MODIFY_REG(hdma2d->Instance->CR, 0, DMA2D_CR_START);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA2D_BlendingStart(DMA2D_HandleTypeDef* hdma2d,
+                                          uintptr_t            src1,
+                                          uintptr_t            src2,
+                                          uintptr_t            dst,
+                                          uint32_t             width,
+                                          uint32_t             height)
+{
+    hdma2d->State = HAL_DMA2D_STATE_BUSY;
+    WRITE_REG(hdma2d->Instance->BGMAR, src2);
+    SetConfig(hdma2d, src1, dst, width, height);
+    MODIFY_REG(hdma2d->Instance->CR, 0, DMA2D_CR_START);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA2D_PollForTransfer(DMA2D_HandleTypeDef* hdma2d,
+                                            uint32_t             timeout)
+{
+    auto regs = hdma2d->Instance;
+    if(regs->CR & DMA2D_CR_START)
+    {
+        while(!(regs->ISR & (DMA2D_ISR_TCIF | DMA2D_ISR_CEIF))) {}
+        if(regs->ISR & DMA2D_ISR_CEIF)
+        {
+            hdma2d->ErrorCode = HAL_DMA2D_ERROR_CE;
+            return HAL_ERROR;
+        }
+    }
+    WRITE_REG(regs->IFCR, DMA2D_ISR_TCIF);
+    hdma2d->State = HAL_DMA2D_STATE_READY;
+    return HAL_OK;
+}
@@ -0,0 +1,155 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "dma2d.hpp"
+#include "stm32h7xx_hal.h"
+
+// Checks the DMA2D queue against the software DMA2D with deferred transfers.
+// A run where every operation is done before the next one is queued gives
+// the reference. Then operations are queued while nothing completes and
+// completed one at a time, each must leave memory as the reference did after
+// it. Last, a thread completes transfers behind the CPU's back, as the
+// peripheral does, while more are queued than the queue holds, and after
+// every Flush() all of them must be done and memory as in the reference.
+// Fills, translucent fills, copies and save/restore pairs overlap, so any
+// reordering shows.
+
+static constexpr int width = 320, height = 240;
+static constexpr int operations = 600, flush_every = 50, steps = 8;
+
+alignas(4) static uint8_t frame[width * height * 2];
+alignas(4) static uint8_t source[width * height * 2];
+alignas(4) static uint8_t saved[width * height * 2];
+
+static Dma2DHandle dma2d;
+
+struct Operation
+{
+    uint8_t   kind;
+    Rectangle rect;
+    uint8_t   color;
+};
+
+static std::vector<Operation> MakeOperations()
+{
+    std::vector<Operation> ops;
+    Rectangle              last_saved;
+    for(int i = 0; i < operations; i++)
+    {
+        int16_t   x = rand() % 280, y = rand() % 200;
+        Rectangle rect(x, y, 1 + rand() % (width - x), 1 + rand() % 40);
+        uint8_t   kind = rand() % 5;
+        if(kind == 4)
+        {
+            // Restores what was saved last, over whatever came since
+            rect = last_saved;
+        }
+        else if(kind == 3)
+        {
+            last_saved = rect;
+        }
+        ops.push_back({kind, rect, uint8_t(rand() % NUMBER_OF_TFT_COLORS)});
+    }
+    return ops;
+}
+
+static void Queue(const Operation& op)
+{
+    switch(op.kind)
+    {
+        case 0: dma2d.FillRect(op.rect, op.color); break;
+        case 1: dma2d.FillRect(op.rect, op.color, 128); break;
+        case 2: dma2d.CopyRect(source, op.rect); break;
+        case 3: dma2d.SaveRect(saved, op.rect); break;
+        case 4: dma2d.RestoreRect(saved, op.rect); break;
+    }
+}
+
+// Memory the DMA2D writes
+static std::vector<uint8_t> Snapshot()
+{
+    std::vector<uint8_t> memory(sizeof(frame) + sizeof(saved));
+    memcpy(memory.data(), frame, sizeof(frame));
+    memcpy(memory.data() + sizeof(frame), saved, sizeof(saved));
+    return memory;
+}
+
+static void Reset()
+{
+    memset(frame, 0, sizeof(frame));
+    memset(saved, 0, sizeof(saved));
+    host_dma2d_stats = {};
+}
+
+int main()
+{
+    dma2d.Init(frame);
+    for(size_t i = 0; i < sizeof(source); i++)
+    {
+        source[i] = i * 7 + i / 640;
+    }
+    auto ops = MakeOperations();
+
+    // Reference, and the transfers each operation took
+    Reset();
+    std::vector<std::vector<uint8_t>> after;
+    std::vector<uint64_t>             transfers;
+    for(auto& op : ops)
+    {
+        Queue(op);
+        dma2d.Flush();
+        after.push_back(Snapshot());
+        transfers.push_back(host_dma2d_stats.transfers);
+    }
+
+    // Queued with nothing completing, then completed one by one
+    int failures = 0;
+    Reset();
+    auto initial        = Snapshot();
+    host_dma2d_deferred = true;
+    for(int i = 0; i < steps; i++)
+    {
+        Queue(ops[i]);
+    }
+    failures += dma2d.IsIdle() || Snapshot() != initial;
+    for(int i = 0; i < steps; i++)
+    {
+        failures += !HostDma2DComplete() || Snapshot() != after[i];
+    }
+    failures += !dma2d.IsIdle() || HostDma2DComplete();
+    printf("completed in order    %s\n", failures ? "no" : "yes");
+
+    // The peripheral on its own thread, taking its time
+    std::atomic<bool> stop{false};
+    std::thread       peripheral(
+        [&]
+        {
+            while(!stop.load())
+            {
+                for(volatile int spin = rand() % 2000; spin > 0; spin--) {}
+                HostDma2DComplete();
+            }
+        });
+
+    Reset();
+    int fences = 0;
+    for(int i = 0; i < operations; i++)
+    {
+        Queue(ops[i]);
+        if((i + 1) % flush_every == 0)
+        {
+            dma2d.Flush();
+            fences += !dma2d.IsIdle()
+                      || host_dma2d_stats.transfers != transfers[i]
+                      || Snapshot() != after[i];
+        }
+    }
+    stop = true;
+    peripheral.join();
+    host_dma2d_deferred = false;
+    printf("fences not honored    %d of %d\n", fences, operations / flush_every);
+    return failures + fences != 0;
+}
@@ -0,0 +1,291 @@
+#include "ili9341_panel.hpp"
+
+#include <cstdio>
+
+ILI9341Panel host_panel;
+
+void ILI9341Panel::SetReset(bool high)
+{
+    if(high)
+    {
+        return;
+    }
+
+    // Registers go back to their defaults, the GRAM keeps whatever it had
+    landscape_    = false;
+    deep_color_   = true;
+    column_start_ = 0;
+    column_end_   = short_side - 1;
+    page_start_   = 0;
+    page_end_     = long_side - 1;
+    scrolling_    = false;
+    top_fixed_    = 0;
+    scroll_lines_ = long_side;
+    scroll_start_ = 0;
+    tearing_on_   = false;
+    command_      = 0;
+    partial_id_   = 0;
+}
+
+void ILI9341Panel::Transfer(const uint8_t* data, size_t size)
+{
+    stats_.transfers++;
+    stats_.bytes += size;
+    auto ns = config_.overhead_ns
+              + size * 8 * 1000000000ull / config_.bit_rate;
+    stats_.busy_ns += ns;
+    now_ns_ += config_.clock_transfers ? ns : 0;
+
+    for(size_t i = 0; i < size; i++)
+    {
+        if(data_)
+        {
+            Parameter(data[i]);
+        }
+        else
+        {
+            Command(data[i]);
+        }
+    }
+
+    bool writing = command_ == 0x2C || command_ == 0x3C;
+    if(writing && data_ && !write_torn_ && RefreshCrossedWrite())
+    {
+        stats_.tears++;
+        write_torn_ = true;
+    }
+}
+
+void ILI9341Panel::Read(uint8_t* data, size_t size)
+{
+    stats_.transfers++;
+    auto ns = config_.overhead_ns
+              + size * 8 * 1000000000ull / config_.bit_rate;
+    stats_.busy_ns += ns;
+    now_ns_ += config_.clock_transfers ? ns : 0;
+
+    // A dummy byte, then the line
+    uint16_t line     = Scanline();
+    uint8_t  reply[3] = {0, uint8_t(line >> 8), uint8_t(line & 0xFF)};
+    for(size_t i = 0; i < size; i++)
+    {
+        data[i] = command_ == 0x45 && i < sizeof(reply) ? reply[i] : 0;
+    }
+}
+
+uint16_t ILI9341Panel::Scanline() const
+{
+    uint32_t lines = long_side + config_.vblank_lines;
+    return (now_ns_ % RefreshPeriod()) * lines / RefreshPeriod();
+}
+
+bool ILI9341Panel::RefreshCrossedWrite() const
+{
+    // Lines the write covers, scrolling aside
+    uint16_t first = landscape_ ? column_start_ : page_start_;
+    uint16_t last  = landscape_ ? column_end_ : page_end_;
+    last           = last < long_side ? last : long_side - 1;
+    if(first > last)
+    {
+        return false;
+    }
+
+    uint64_t period = RefreshPeriod();
+    if(now_ns_ - write_start_ >= period)
+    {
+        return true;
+    }
+
+    // When the refresh is on those lines, within a period and the next
+    uint64_t lines = long_side + config_.vblank_lines;
+    uint64_t on    = first * period / lines;
+    uint64_t off   = (last + 1) * period / lines;
+    uint64_t start = write_start_ % period;
+    uint64_t end   = start + (now_ns_ - write_start_);
+    return (start < off && on < end)
+           || (start < off + period && on + period < end);
+}
+
+void ILI9341Panel::Command(uint8_t command)
+{
+    command_    = command;
+    param_id_   = 0;
+    partial_id_ = 0;
+
+    switch(command)
+    {
+        case 0x01: // SWRESET
+            SetReset(false);
+            break;
+        case 0x13: // NORON, leaves scrolling
+            scrolling_ = false;
+            break;
+        case 0x2C: // RAMWR
+            column_      = column_start_;
+            page_        = page_start_;
+            write_start_ = now_ns_;
+            write_torn_  = false;
+            break;
+        case 0x3C: // RAMWRC
+            write_start_ = now_ns_;
+            write_torn_  = false;
+            break;
+        case 0x34: // TEOFF
+            tearing_on_ = false;
+            break;
+        case 0x35: // TEON
+            tearing_on_ = true;
+            break;
+        default: break;
+    }
+}
+
+void ILI9341Panel::Parameter(uint8_t value)
+{
+    // Memory writes take any number of bytes, everything else a few
+    if(command_ == 0x2C || command_ == 0x3C)
+    {
+        uint8_t bytes = deep_color_ ? 3 : 2;
+        if(partial_id_ + 1 < bytes)
+        {
+            partial_[partial_id_++] = value;
+            return;
+        }
+        partial_id_ = 0;
+        if(deep_color_)
+        {
+            // 6 bits per channel, in the top of each byte
+            Pixel(((partial_[0] & 0xF8) << 8) | ((partial_[1] & 0xFC) << 3)
+                  | (value >> 3));
+        }
+        else
+        {
+            Pixel((partial_[0] << 8) | value);
+        }
+        return;
+    }
+
+    if(param_id_ == sizeof(params_))
+    {
+        return;
+    }
+    params_[param_id_++] = value;
+
+    auto word = [this](uint8_t i) { return params_[i] << 8 | params_[i + 1]; };
+    switch(command_)
+    {
+        case 0x2A: // CASET
+            if(param_id_ == 4)
+            {
+                column_start_ = word(0);
+                column_end_   = word(2);
+            }
+            break;
+        case 0x2B: // PASET
+            if(param_id_ == 4)
+            {
+                page_start_ = word(0);
+                page_end_   = word(2);
+            }
+            break;
+        case 0x33: // VSCRDEF, the bottom fixed area follows from the others
+            if(param_id_ == 6)
+            {
+                top_fixed_    = word(0);
+                scroll_lines_ = word(2);
+            }
+            break;
+        case 0x37: // VSCRSADD
+            if(param_id_ == 2)
+            {
+                scroll_start_ = word(0);
+                scrolling_    = true;
+            }
+            break;
+        case 0x36: // MADCTL
+            if(param_id_ == 1)
+            {
+                landscape_ = value & 0x20;
+            }
+            break;
+        case 0x3A: // COLMOD, DBI bits
+            if(param_id_ == 1)
+            {
+                deep_color_ = (value & 0x07) == 0x06;
+            }
+            break;
+        default: break;
+    }
+}
+
+void ILI9341Panel::Pixel(uint16_t color)
+{
+    if(column_ < Width() && page_ < Height())
+    {
+        auto line   = landscape_ ? column_ : page_;
+        auto column = landscape_ ? page_ : column_;
+        gram_[column + line * short_side] = color;
+        stats_.pixels++;
+    }
+
+    // Row by row through the window, starting over past its end
+    if(++column_ > column_end_)
+    {
+        column_ = column_start_;
+        if(++page_ > page_end_)
+        {
+            page_ = page_start_;
+        }
+    }
+}
+
+uint16_t ILI9341Panel::ShownLine(uint16_t line) const
+{
+    if(!scrolling_ || scroll_lines_ == 0 || line < top_fixed_
+       || line >= top_fixed_ + scroll_lines_)
+    {
+        return line;
+    }
+    // The scroll area shows memory from scroll_start_ on, wrapping around
+    int32_t offset = scroll_start_ - top_fixed_ + line - top_fixed_;
+    offset %= scroll_lines_;
+    if(offset < 0)
+    {
+        offset += scroll_lines_;
+    }
+    return top_fixed_ + offset;
+}
+
+uint16_t ILI9341Panel::GetPixel(uint16_t x, uint16_t y) const
+{
+    auto line   = ShownLine(landscape_ ? x : y);
+    auto column = landscape_ ? y : x;
+    return gram_[column + line * short_side];
+}
+
+bool ILI9341Panel::WritePpm(const char* path) const
+{
+    auto file = fopen(path, "wb");
+    if(!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", Width(), Height());
+    for(uint16_t y = 0; y < Height(); y++)
+    {
+        for(uint16_t x = 0; x < Width(); x++)
+        {
+            auto    color = GetPixel(x, y);
+            uint8_t r     = (color >> 11) & 0x1F;
+            uint8_t g     = (color >> 5) & 0x3F;
+            uint8_t b     = color & 0x1F;
+
+            uint8_t rgb[3] = {uint8_t(r << 3 | r >> 2),
+                              uint8_t(g << 2 | g >> 4),
+                              uint8_t(b << 3 | b >> 2)};
+            fwrite(rgb, 1, sizeof(rgb), file);
+        }
+    }
+    return fclose(file) == 0;
+}
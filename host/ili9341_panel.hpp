@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Simulated ILI9341 on the far end of the host SPI bus.
+ *
+ * Bytes are decoded the way the controller does: the DC pin tells commands
+ * from their parameters, CASET/RASET set the address window and RAMWR fills
+ * it, so what ends up in the GRAM is exactly what the driver sent. Every
+ * transfer also takes simulated time at the configured bit rate, which is
+ * the only clock the host System has.
+ *
+ * Addresses are taken after MADCTL's row/column exchange and the mirroring
+ * as the way the panel is mounted, so the GRAM reads as the driver draws.
+ *
+ * The panel also refreshes on its own clock, line by line along the long
+ * side, which drives the TE output and GET_SCANLINE. Memory writes the
+ * refresh passes through while they are under way are counted as tears.
+ */
+class ILI9341Panel
+{
+  public:
+    static constexpr uint16_t long_side  = 320;
+    static constexpr uint16_t short_side = 240;
+
+    struct Config
+    {
+        uint32_t bit_rate    = 50000000; // SPI clock in Hz
+        uint32_t overhead_ns = 1000;     // setting up each transfer
+        uint32_t refresh_hz   = 79; // as set up by the driver's 0xB1
+        uint16_t vblank_lines = 4;  // front and back porch, in lines
+        // Transfers pass time as if the CPU waited for them, otherwise only
+        // drawing and Wait() do
+        bool clock_transfers = true;
+    };
+
+    struct Stats
+    {
+        uint64_t transfers; // SPI transactions, blocking or DMA
+        uint64_t bytes;     // commands and parameters included
+        uint64_t pixels;    // written to the GRAM
+        uint64_t busy_ns;   // time spent on the bus
+        uint64_t tears;     // memory writes the refresh passed through
+    };
+
+    void Configure(const Config& config) { config_ = config; }
+
+    // Level of the DC pin, high for parameters and pixels
+    void SetDataCommand(bool data) { data_ = data; }
+
+    // Level of the reset pin, the controller resets while it's low
+    void SetReset(bool high);
+
+    /**
+     * @brief One SPI transfer, decoded byte by byte.
+     */
+    void Transfer(const uint8_t* data, size_t size);
+
+    /**
+     * @brief One SPI read, answering the last command. Only GET_SCANLINE
+     * has anything to say, the rest read as 0.
+     */
+    void Read(uint8_t* data, size_t size);
+
+    // Line being refreshed, long_side and above during vertical blanking
+    uint16_t Scanline() const;
+
+    // Level of the TE output, high during vertical blanking once TEON
+    bool TearingEffect() const
+    {
+        return tearing_on_ && Scanline() >= long_side;
+    }
+
+    // Passes time with the bus idle, e.g. System::Delay()
+    void Wait(uint64_t ns) { now_ns_ += ns; }
+
+    // Simulated time since start
+    uint64_t Now() const { return now_ns_; }
+
+    const Stats& GetStats() const { return stats_; }
+
+    void ResetStats() { stats_ = {}; }
+
+    uint16_t Width() const { return landscape_ ? long_side : short_side; }
+
+    uint16_t Height() const { return landscape_ ? short_side : long_side; }
+
+    /**
+     * @brief RGB565 color shown at x, y, with scrolling applied.
+     */
+    uint16_t GetPixel(uint16_t x, uint16_t y) const;
+
+    /**
+     * @brief Writes what the panel shows as a binary PPM, false if the file
+     * can't be written. Colors are expanded to 8 bits per channel the same
+     * way every time, so dumps can be compared byte for byte.
+     */
+    bool WritePpm(const char* path) const;
+
+  private:
+    void Command(uint8_t command);
+    void Parameter(uint8_t value);
+    void Pixel(uint16_t color);
+
+    // Scan line shown at line, lines run along the long side
+    uint16_t ShownLine(uint16_t line) const;
+
+    // Whether the refresh went through the lines being written, from when
+    // the memory write started until now
+    bool RefreshCrossedWrite() const;
+
+    uint64_t RefreshPeriod() const
+    {
+        return 1000000000ull / config_.refresh_hz;
+    }
+
+    Config   config_;
+    Stats    stats_{};
+    uint64_t now_ns_ = 0;
+    bool     data_   = false;
+
+    // Scan lines along the long side, as the controller stores them
+    uint16_t gram_[long_side * short_side] = {};
+    bool     landscape_ = false; // MADCTL MV, lines become columns
+
+    uint8_t  command_    = 0;
+    uint8_t  params_[6]  = {};
+    uint8_t  param_id_   = 0;
+    bool     deep_color_ = true; // COLMOD 18 bits, the reset default
+    uint8_t  partial_[2] = {};   // bytes of a pixel that isn't complete yet
+    uint8_t  partial_id_ = 0;
+
+    uint16_t column_start_ = 0, column_end_ = short_side - 1;
+    uint16_t page_start_ = 0, page_end_ = long_side - 1;
+    uint16_t column_ = 0, page_ = 0;
+
+    bool     scrolling_ = false;
+    uint16_t top_fixed_ = 0, scroll_lines_ = long_side, scroll_start_ = 0;
+
+    bool     tearing_on_  = false;
+    uint64_t write_start_ = 0;     // time of the last RAMWR
+    bool     write_torn_  = false; // already counted as a tear
+
+};
+
+// The panel on the host SPI bus, see daisy_seed.h
+extern ILI9341Panel host_panel;
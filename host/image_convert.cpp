@@ -0,0 +1,161 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "rle_encoder.hpp"
+
+// Converts a PAM (RGB or RGB_ALPHA) or PPM file into an RleImage, written as
+// a C array to include in the firmware. PNGs go through netpbm first, e.g.
+// pngtopam -alphapam knob.png > knob.pam
+//
+// image_convert knob.pam argb4444 knob_frame > knob_frame.h
+
+static bool ReadToken(FILE* file, char* token, size_t size)
+{
+    int c = fgetc(file);
+    while(c == '#' || (c != EOF && strchr(" \t\r\n", c)))
+    {
+        if(c == '#')
+        {
+            while(c != EOF && c != '\n')
+            {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+    size_t n = 0;
+    while(c != EOF && !strchr(" \t\r\n", c) && n + 1 < size)
+    {
+        token[n++] = c;
+        c          = fgetc(file);
+    }
+    token[n] = '\0';
+    return n > 0;
+}
+
+// Reads 8 bit PPM (P6) or PAM (P7) pixels as 0xAARRGGBB
+static bool ReadImage(FILE*                  file,
+                      uint16_t&              width,
+                      uint16_t&              height,
+                      std::vector<uint32_t>& pixels)
+{
+    char     token[32];
+    unsigned w = 0, h = 0, depth = 3, maxval = 0;
+    if(!ReadToken(file, token, sizeof(token)))
+    {
+        return false;
+    }
+    if(strcmp(token, "P6") == 0)
+    {
+        char wt[16], ht[16], mt[16];
+        if(!ReadToken(file, wt, 16) || !ReadToken(file, ht, 16)
+           || !ReadToken(file, mt, 16))
+        {
+            return false;
+        }
+        w      = atoi(wt);
+        h      = atoi(ht);
+        maxval = atoi(mt);
+    }
+    else if(strcmp(token, "P7") == 0)
+    {
+        while(ReadToken(file, token, sizeof(token))
+              && strcmp(token, "ENDHDR") != 0)
+        {
+            char value[32];
+            if(!ReadToken(file, value, sizeof(value)))
+            {
+                return false;
+            }
+            if(strcmp(token, "WIDTH") == 0)
+                w = atoi(value);
+            else if(strcmp(token, "HEIGHT") == 0)
+                h = atoi(value);
+            else if(strcmp(token, "DEPTH") == 0)
+                depth = atoi(value);
+            else if(strcmp(token, "MAXVAL") == 0)
+                maxval = atoi(value);
+        }
+    }
+    if(w == 0 || h == 0 || w > 0xFFFF || h > 0xFFFF || maxval != 255
+       || (depth != 3 && depth != 4))
+    {
+        return false;
+    }
+
+    width  = w;
+    height = h;
+    pixels.resize(w * h);
+    for(auto& pixel : pixels)
+    {
+        uint8_t c[4] = {0, 0, 0, 255};
+        if(fread(c, 1, depth, file) != depth)
+        {
+            return false;
+        }
+        pixel = uint32_t(c[3]) << 24 | c[0] << 16 | c[1] << 8 | c[2];
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 4)
+    {
+        fprintf(stderr,
+                "usage: %s image.pam|image.ppm rgb565|argb4444|l8 name\n",
+                argv[0]);
+        return 2;
+    }
+
+    RleImage::Format format;
+    if(strcmp(argv[2], "rgb565") == 0)
+        format = RleImage::Format::RGB565;
+    else if(strcmp(argv[2], "argb4444") == 0)
+        format = RleImage::Format::ARGB4444;
+    else if(strcmp(argv[2], "l8") == 0)
+        format = RleImage::Format::L8;
+    else
+    {
+        fprintf(stderr, "Unknown format %s\n", argv[2]);
+        return 2;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if(!file)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return 1;
+    }
+    uint16_t              width, height;
+    std::vector<uint32_t> pixels;
+    bool                  read = ReadImage(file, width, height, pixels);
+    fclose(file);
+    if(!read)
+    {
+        fprintf(stderr, "%s is not an 8 bit PPM or PAM\n", argv[1]);
+        return 1;
+    }
+
+    auto image = EncodeRleImage(pixels.data(), width, height, format);
+    if(image.empty())
+    {
+        fprintf(stderr, "More than 256 colors for l8\n");
+        return 1;
+    }
+
+    printf("// %s: %ux%u %s, %zu bytes (%u uncompressed)\n",
+           argv[1],
+           width,
+           height,
+           argv[2],
+           image.size(),
+           width * height * RleImage(image.data()).PixelSize());
+    printf("alignas(4) const uint8_t %s[] = {", argv[3]);
+    for(size_t i = 0; i < image.size(); i++)
+    {
+        printf("%s0x%02X,", i % 12 ? " " : "\n    ", image[i]);
+    }
+    printf("\n};\n");
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include "ili9341_ui_driver.hpp"
+
+// Draws the screen from main.cpp on the simulated panel, reports how long it
+// took to send and saves what the panel shows.
+
+ILI9341UiDriver driver;
+
+int main(int argc, char** argv)
+{
+    driver.Init();
+
+    driver.Fill(COLOR_BLACK);
+    driver.FillRect(Rectangle(100, 100, 50, 50), COLOR_RED);
+    driver.DrawRect(Rectangle(100, 120, 50, 50), COLOR_WHITE);
+
+    host_panel.ResetStats();
+    driver.Update();
+
+    auto& stats = host_panel.GetStats();
+    printf("%llu bytes in %llu transfers, %.2f ms at %u Hz\n",
+           static_cast<unsigned long long>(stats.bytes),
+           static_cast<unsigned long long>(stats.transfers),
+           stats.busy_ns / 1e6,
+           ILI9341Panel::Config{}.bit_rate);
+
+#ifdef ILI9341_PROFILER
+    // A second frame closes the first one in the profiler
+    driver.Update();
+    auto& profiler = driver.Profiler();
+    for(uint8_t i = 0; i < FrameProfiler::num_metrics; i++)
+    {
+        auto metric  = static_cast<ProfileMetric>(i);
+        auto summary = profiler.Summarize(metric);
+        printf("%-14s %8u %8u %8u %8u%s\n",
+               FrameProfiler::Name(metric),
+               summary.min,
+               summary.avg,
+               summary.max,
+               summary.p99,
+               FrameProfiler::IsTime(metric) ? " us" : "");
+    }
+#endif
+
+    auto path = argc > 1 ? argv[1] : "frame.ppm";
+    if(!host_panel.WritePpm(path))
+    {
+        fprintf(stderr, "Can't write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
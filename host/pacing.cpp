@@ -0,0 +1,60 @@
+#include <cstdio>
+#include "ili9341_ui_driver.hpp"
+
+// Animates a row of level meters with each frame sync and counts how often
+// the simulated refresh went through a memory write. The panel refreshes its
+// lines along the screen columns, so the meters are tall and narrow.
+
+ILI9341UiDriver driver;
+
+static void Run(const char* name, int frames)
+{
+    host_panel.ResetStats();
+    auto start = host_panel.Now();
+    for(int i = 0; i < frames; i++)
+    {
+        // Polling the TE pin or the clock takes a little time too
+        while(!driver.IsRender())
+        {
+            host_panel.Wait(5000);
+        }
+        for(int16_t m = 0; m < 4; m++)
+        {
+            int16_t top = (i * (m + 3) * 7) % 240;
+            int16_t x   = 160 + m * 40;
+            driver.FillRect(Rectangle(x, 0, 16, top), COLOR_DARK_GRAY);
+            driver.FillRect(Rectangle(x, top, 16, 240 - top), COLOR_GREEN);
+        }
+        driver.Update();
+    }
+    while(!driver.IsRender())
+    {
+        host_panel.Wait(5000);
+    }
+
+    auto seconds = (host_panel.Now() - start) / 1e9;
+    printf("%-12s %3llu torn writes in %d frames, %.1f fps\n",
+           name,
+           static_cast<unsigned long long>(host_panel.GetStats().tears),
+           frames,
+           frames / seconds);
+}
+
+int main()
+{
+    driver.Init();
+    driver.Fill(COLOR_BLACK);
+    driver.Update();
+
+    driver.SetFrameSync(FramePacer::Sync::None);
+    Run("none", 200);
+    driver.SetFrameSync(FramePacer::Sync::Timer);
+    Run("timer", 200);
+    driver.SetScanlinePin(seed::D9);
+    Run("scanline", 200);
+    driver.SetTearingPin(host_te_pin);
+    Run("te pin", 200);
+    driver.SetFpsCap(30);
+    Run("te pin 30", 200);
+    return 0;
+}
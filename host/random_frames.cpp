@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+#include "ili9341_ui_driver.hpp"
+
+// Draws 40 frames of random opaque primitives and text, clearing the screen
+// every 10, and checksums what the panel shows after each. Every build
+// (single and double buffer, indexed, band renderer, SPI_16BIT, profiler)
+// must show the same frames. The text comes from libDaisy's fonts, so the
+// checksum is only fixed for a given libDaisy: one build writes it to a file
+// and the others must match it, as with band_compare:
+//   random_frames -w frames.sum   (the reference build)
+//   random_frames frames.sum      (every other build)
+// Opaque drawing in the 16 palette colors is all the indexed frame buffer
+// can show alike. Saves the last frame if given a further file name.
+
+ILI9341UiDriver driver;
+
+static constexpr int width = 320, height = 240;
+static constexpr int frames = 40, clear_every = 10, per_frame = 6;
+
+// Its own generator, so the frames don't depend on the C library's rand()
+static uint32_t Random(uint32_t range)
+{
+    static uint32_t state = 3;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % range;
+}
+
+static uint32_t Checksum()
+{
+    uint32_t sum = 0;
+    for(uint16_t y = 0; y < height; y++)
+    {
+        for(uint16_t x = 0; x < width; x++)
+        {
+            sum = sum * 31 + host_panel.GetPixel(x, y);
+        }
+    }
+    return sum;
+}
+
+static void Primitive()
+{
+    int16_t x = Random(width - 20), y = Random(height - 20);
+    uint8_t color = Random(NUMBER_OF_TFT_COLORS);
+    switch(Random(7))
+    {
+        case 0:
+            driver.FillRect(
+                Rectangle(x, y, 1 + Random(80), 1 + Random(60)), color);
+            break;
+        case 1:
+            driver.DrawLine(x, y, Random(width), Random(height), color);
+            break;
+        case 2:
+            driver.DrawRect(x, y, 1 + Random(80), 1 + Random(60), color);
+            break;
+        case 3:
+        {
+            char text[12];
+            for(auto& ch : text)
+            {
+                ch = ' ' + Random(95);
+            }
+            text[11]              = 0;
+            const FontDef* fonts[] = {&Font_7x10, &Font_11x18, &Font_16x26};
+            driver.WriteString(text, x, y, *fonts[Random(3)], color);
+            break;
+        }
+        case 4: driver.FillCircle(x, y, Random(30), color); break;
+        case 5: driver.DrawCircle(x, y, Random(30), color); break;
+        case 6:
+            driver.FillTriangle(x,
+                                y,
+                                Random(width),
+                                Random(height),
+                                Random(width),
+                                Random(height),
+                                color);
+            break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool write = argc > 1 && strcmp(argv[1], "-w") == 0;
+    if(argc < 2 + write)
+    {
+        printf("usage: %s [-w] frames.sum [last.ppm]\n", argv[0]);
+        return 1;
+    }
+    const char* name = argv[1 + write];
+    const char* ppm  = argc > 2 + write ? argv[2 + write] : nullptr;
+
+    driver.Init();
+    uint32_t sum = 0;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        if(frame % clear_every == 0)
+        {
+            driver.Fill(Random(NUMBER_OF_TFT_COLORS));
+        }
+        for(int i = 0; i < per_frame; i++)
+        {
+            Primitive();
+        }
+        driver.Update();
+        while(!driver.IsRender()) {}
+        sum = sum * 31 + Checksum();
+    }
+    if(ppm && !host_panel.WritePpm(ppm))
+    {
+        return 1;
+    }
+
+    FILE* file = fopen(name, write ? "w" : "r");
+    if(!file)
+    {
+        perror(name);
+        return 1;
+    }
+    unsigned expected = 0;
+    bool     ok       = write ? fprintf(file, "%08X\n", sum) > 0
+                              : fscanf(file, "%X", &expected) == 1;
+    fclose(file);
+    if(!ok)
+    {
+        printf("can't %s %s\n", write ? "write" : "read", name);
+        return 1;
+    }
+    if(write)
+    {
+        printf("frames checksum  %08X, written to %s\n", sum, name);
+        return 0;
+    }
+    printf("frames checksum  %08X, %s %s\n",
+           sum,
+           sum == expected ? "matches" : "does NOT match",
+           name);
+    return sum != expected;
+}
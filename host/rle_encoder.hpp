@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "rle_image.hpp"
+
+/**
+ * Encodes 8 bit ARGB pixels (0xAARRGGBB, rows top to bottom) as an
+ * RleImage. Pixels with alpha below 128 are skipped in RGB565 and L8
+ * images, and with alpha 0 in ARGB4444 ones. L8 images take the RGB565
+ * colors in order of appearance and fail, returning nothing, beyond 256.
+ */
+inline std::vector<uint8_t> EncodeRleImage(const uint32_t*  argb,
+                                           uint16_t         width,
+                                           uint16_t         height,
+                                           RleImage::Format format)
+{
+    using Op = RleImage::Op;
+
+    auto to565 = [](uint32_t c)
+    {
+        return uint16_t((c >> 8 & 0xF800) | (c >> 5 & 0x07E0)
+                        | (c >> 3 & 0x001F));
+    };
+    auto to4444 = [](uint32_t c)
+    {
+        return uint16_t((c >> 16 & 0xF000) | (c >> 12 & 0x0F00)
+                        | (c >> 8 & 0x00F0) | (c >> 4 & 0x000F));
+    };
+
+    // Stored values, palette indices for L8, and which pixels are skipped
+    std::vector<uint16_t> palette;
+    std::vector<uint16_t> values(size_t(width) * height);
+    std::vector<bool>     skipped(values.size());
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        uint8_t alpha = argb[i] >> 24;
+        switch(format)
+        {
+            case RleImage::Format::ARGB4444:
+                values[i]  = to4444(argb[i]);
+                skipped[i] = values[i] >> 12 == 0;
+                break;
+            case RleImage::Format::L8:
+            {
+                skipped[i] = alpha < 128;
+                if(skipped[i])
+                {
+                    break;
+                }
+                uint16_t color = to565(argb[i]);
+                size_t   index = 0;
+                while(index < palette.size() && palette[index] != color)
+                {
+                    index++;
+                }
+                if(index == palette.size())
+                {
+                    if(palette.size() == 256)
+                    {
+                        return {};
+                    }
+                    palette.push_back(color);
+                }
+                values[i] = index;
+                break;
+            }
+            default:
+                values[i]  = to565(argb[i]);
+                skipped[i] = alpha < 128;
+                break;
+        }
+    }
+
+    uint8_t size = format == RleImage::Format::L8 ? 1 : 2;
+    uint8_t last = palette.empty() ? 0 : palette.size() - 1;
+
+    std::vector<uint8_t> out = {'R',
+                                'I',
+                                uint8_t(format),
+                                last,
+                                uint8_t(width),
+                                uint8_t(width >> 8),
+                                uint8_t(height),
+                                uint8_t(height >> 8)};
+    auto put16 = [&](uint16_t v)
+    {
+        out.push_back(v);
+        out.push_back(v >> 8);
+    };
+    auto put = [&](uint16_t v) { size == 2 ? put16(v) : out.push_back(v); };
+    auto packet = [&](Op op, uint16_t count)
+    { out.push_back(uint8_t(op) << 6 | (count - 1)); };
+
+    for(auto color : palette)
+    {
+        put16(color);
+    }
+    size_t table = out.size();
+    out.resize(table + (height + 1) * 4);
+    auto set_offset = [&](uint16_t row)
+    {
+        uint32_t offset = out.size();
+        for(int b = 0; b < 4; b++)
+        {
+            out[table + row * 4 + b] = offset >> (b * 8);
+        }
+    };
+
+    for(uint16_t y = 0; y < height; y++)
+    {
+        set_offset(y);
+        auto value = [&](uint16_t x) { return values[y * width + x]; };
+        auto skip  = [&](uint16_t x) { return skipped[y * width + x]; };
+        // Pixels from x repeating value(x), up to a packet's worth
+        auto repeats = [&](uint16_t x)
+        {
+            uint16_t n = 1;
+            while(x + n < width && n < RleImage::max_count && !skip(x + n)
+                  && value(x + n) == value(x))
+            {
+                n++;
+            }
+            return n;
+        };
+
+        uint16_t x = 0;
+        while(x < width)
+        {
+            if(skip(x))
+            {
+                uint16_t n = 1;
+                while(x + n < width && skip(x + n))
+                {
+                    n++;
+                }
+                if(x + n == width)
+                {
+                    packet(Op::EndOfRow, 1);
+                    break;
+                }
+                for(uint16_t left = n; left > 0;)
+                {
+                    uint16_t count
+                        = std::min<uint16_t>(left, RleImage::max_count);
+                    packet(Op::Skip, count);
+                    left -= count;
+                }
+                x += n;
+                continue;
+            }
+
+            uint16_t n = repeats(x);
+            if(n >= 3)
+            {
+                packet(Op::Run, n);
+                put(value(x));
+                x += n;
+                continue;
+            }
+
+            // A literal, until the next run of 3 or skipped pixel
+            n = 0;
+            while(x + n < width && n < RleImage::max_count && !skip(x + n)
+                  && repeats(x + n) < 3)
+            {
+                n++;
+            }
+            packet(Op::Literal, n);
+            out.resize(RleImage::LiteralOffset(out.size(), size));
+            for(uint16_t i = 0; i < n; i++)
+            {
+                put(value(x + i));
+            }
+            x += n;
+        }
+    }
+    set_offset(height);
+    return out;
+}
@@ -0,0 +1,216 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include "waveform.hpp"
+
+// A 320 column scope of a 48 kHz signal at 60 frames per second. A producer
+// thread stands in for the audio callback and writes blocks of 48 samples to
+// a SampleRing, which the main loop reads while it fills. Each frame the
+// callback is let run for 800 more samples and the frame shows the last 800,
+// drawn as a line per sample, as a Waveform redrawn whole and as one redrawn
+// incrementally, then sweeps the ring across the screen with Push(). Checks
+// that both Waveforms show the same frames and prints the CPU time spent per
+// frame on the trace (build with -O2 for meaningful times) and the bytes
+// sent. Saves the last frame if given a file name.
+//
+// The host DMA2D runs on the CPU, so the viewport fills the whole redraws
+// start count here, while on the target they run alongside. With
+// ILI9341_BAND_RENDERER the calls only record, and drawing happens in
+// Update(), which isn't counted. Build with -fsanitize=thread to check the
+// ring for races.
+
+ILI9341UiDriver driver;
+
+static constexpr int      frames = 240;
+static constexpr uint32_t block  = 48;
+static constexpr uint32_t shown  = 48000 / 60;
+
+static const Rectangle         viewport(0, 20, 320, 200);
+static SampleRing<float, 4096> ring;
+static float                   heard[frames * shown]; // what a run read
+static Waveform                waveform(viewport, COLOR_GREEN);
+
+// Samples the callback may write up to, and has written
+static std::atomic<uint32_t> allowed{0};
+static std::atomic<uint32_t> produced{0};
+static std::atomic<bool>     done{false};
+
+// A chord with a slow swell, as the audio callback would produce it. Every
+// Run() hears the same audio.
+static void AudioCallback(uint32_t& t)
+{
+    float out[block];
+    for(uint32_t i = 0; i < block; i++, t++)
+    {
+        float s = t % (frames * shown) / 48000.f;
+        float a = 0.5f + 0.4f * std::sin(s * 1.3f);
+        out[i]  = a
+                 * (0.6f * std::sin(s * 2 * M_PI * 110)
+                    + 0.3f * std::sin(s * 2 * M_PI * 331)
+                    + 0.1f * std::sin(s * 2 * M_PI * 1750));
+    }
+    ring.Write(out, block);
+}
+
+static void Producer()
+{
+    uint32_t t = 0;
+    while(!done)
+    {
+        if(t < allowed.load(std::memory_order_acquire))
+        {
+            AudioCallback(t);
+            produced.store(t, std::memory_order_release);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void DrawLines(const float* samples)
+{
+    driver.FillRect(viewport, COLOR_BLACK);
+    auto y = [](float s) { return uint16_t(119 - s * 99); };
+    for(uint32_t i = 1; i < shown; i++)
+    {
+        driver.DrawLine((i - 1) * 320 / shown,
+                        y(samples[i - 1]),
+                        i * 320 / shown,
+                        y(samples[i]),
+                        COLOR_GREEN);
+    }
+}
+
+static uint32_t Checksum()
+{
+    uint32_t sum = 0;
+    for(uint16_t y = 0; y < 240; y++)
+    {
+        for(uint16_t x = 0; x < 320; x++)
+        {
+            sum = sum * 31 + host_panel.GetPixel(x, y);
+        }
+    }
+    return sum;
+}
+
+enum class Mode
+{
+    Lines,
+    Whole,
+    Incremental,
+    Sweep,
+};
+
+static uint32_t checksums[frames];
+
+static void Run(Mode mode)
+{
+    static const char* const names[]
+        = {"lines", "whole", "incremental", "sweep"};
+
+    driver.Fill(COLOR_BLACK);
+    driver.Update();
+    while(!driver.IsRender()) {}
+    waveform.Invalidate();
+    waveform.SetIncremental(mode != Mode::Whole);
+    host_panel.ResetStats();
+
+    uint32_t base = produced, heard_n = 0, mismatches = 0, columns = 0;
+    double   us    = 0;
+    auto     timed = [&](auto work)
+    {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        std::chrono::duration<double, std::micro> elapsed
+            = std::chrono::steady_clock::now() - start;
+        us += elapsed.count();
+    };
+    for(int frame = 0; frame < frames; frame++)
+    {
+        // Read while the callback writes the frame's audio, then what is
+        // left once it has written it all
+        uint32_t end = base + uint32_t(frame + 1) * shown;
+        allowed.store(end, std::memory_order_release);
+        bool written;
+        do
+        {
+            written = produced.load(std::memory_order_acquire) >= end;
+            if(mode == Mode::Sweep && ring.Available() > 0)
+            {
+                timed([] { waveform.Push(ring); });
+            }
+            else if(mode != Mode::Sweep)
+            {
+                heard_n += ring.Read(heard + heard_n, frames * shown - heard_n);
+            }
+        } while(!written);
+
+        if(mode == Mode::Sweep)
+        {
+            timed([] { waveform.Draw(driver); });
+        }
+        else if(mode == Mode::Lines)
+        {
+            timed([&] { DrawLines(heard + heard_n - shown); });
+        }
+        else
+        {
+            timed(
+                [&]
+                {
+                    waveform.Set(heard + heard_n - shown, shown);
+                    waveform.Draw(driver);
+                });
+        }
+        columns += mode == Mode::Lines ? 0 : waveform.Changed();
+
+        driver.Update();
+        while(!driver.IsRender()) {}
+        if(mode == Mode::Whole)
+        {
+            checksums[frame] = Checksum();
+        }
+        else if(mode == Mode::Incremental)
+        {
+            mismatches += Checksum() != checksums[frame];
+        }
+    }
+
+    printf("%-11s %7.1f us %4.2f%% of a frame, %6.0f bytes, %3u columns",
+           names[int(mode)],
+           us / frames,
+           us / frames / (1e6 / 60) * 100,
+           host_panel.GetStats().bytes / double(frames),
+           columns / frames);
+    if(mode == Mode::Incremental)
+    {
+        printf(", %u of %d frames differ", mismatches, frames);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    driver.Init();
+    waveform.SetSamplesPerColumn(10);
+    std::thread producer(Producer);
+
+    Run(Mode::Lines);
+    Run(Mode::Whole);
+    Run(Mode::Incremental);
+    Run(Mode::Sweep);
+    done = true;
+    producer.join();
+    printf("%u samples dropped\n", ring.Dropped());
+
+    if(argc > 1)
+    {
+        return !host_panel.WritePpm(argv[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "ili9341_ui_driver.hpp"
+#include "rle_encoder.hpp"
+
+// Sweeps a playhead over a static waveform, with a translucent cursor image
+// circling over both and a counter redrawn under them now and then. Runs it
+// once with sprites and once redrawing the whole screen every frame, checks
+// that every frame looks the same and prints the bytes sent per frame. Saves
+// the last frame if given a file name. With ILI9341_INDEXED_FRAMEBUFFER,
+// which can't draw images, the cursor is a plain square.
+
+ILI9341UiDriver driver;
+
+static constexpr int      frames = 120;
+static constexpr uint16_t cursor = 16;
+
+alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION
+    playhead_under[Sprite::BufferSize(2, 200)];
+alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION
+    cursor_under[Sprite::BufferSize(cursor, cursor)];
+
+static Sprite playhead(2, 200, playhead_under);
+static Sprite pointer(cursor, cursor, cursor_under);
+
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+static std::vector<uint8_t> cursor_image;
+
+// Translucent ring with an opaque dot in the middle
+static void MakeCursor()
+{
+    std::vector<uint32_t> argb(cursor * cursor);
+    for(int y = 0; y < cursor; y++)
+    {
+        for(int x = 0; x < cursor; x++)
+        {
+            float d = std::hypot(x - 7.5f, y - 7.5f);
+            argb[y * cursor + x] = d < 2.5f   ? 0xFFFFFFFF
+                                   : d < 7.5f ? 0x80FFA000
+                                              : 0;
+        }
+    }
+    cursor_image = EncodeRleImage(
+        argb.data(), cursor, cursor, RleImage::Format::ARGB4444);
+    pointer.SetImage(cursor_image.data());
+}
+
+static void DrawCursor(int16_t x, int16_t y)
+{
+    driver.DrawImage(cursor_image.data(), x, y);
+}
+#else
+static void MakeCursor()
+{
+    pointer.SetColor(COLOR_ORANGE);
+}
+
+static void DrawCursor(int16_t x, int16_t y)
+{
+    driver.FillRect(Rectangle(x, y, cursor, cursor), COLOR_ORANGE);
+}
+#endif
+
+static void DrawWaveform()
+{
+    driver.Fill(COLOR_BLACK);
+    for(int16_t x = 10; x < 309; x++)
+    {
+        auto y0 = int16_t(120 + 80 * std::sin(x * 0.05f) * std::cos(x * 0.013f));
+        auto y1 = int16_t(120 + 80 * std::sin((x + 1) * 0.05f)
+                                   * std::cos((x + 1) * 0.013f));
+        driver.DrawLine(x, y0, x + 1, y1, COLOR_GREEN);
+    }
+}
+
+static void DrawCounter(int frame)
+{
+    char text[12];
+    snprintf(text, sizeof(text), "%03d", frame / 10);
+    driver.FillRect(Rectangle(140, 112, 21, 10), COLOR_BLACK);
+    driver.WriteString(text, 140, 112, Font_7x10, COLOR_WHITE);
+}
+
+static void Place(int frame, int16_t& x, int16_t& cx, int16_t& cy)
+{
+    x  = 10 + frame * 5 % 300;
+    cx = 150 + int16_t(40 * std::cos(frame * 0.2f)) - cursor / 2;
+    cy = 117 + int16_t(40 * std::sin(frame * 0.2f)) - cursor / 2;
+}
+
+static void Send()
+{
+    driver.Update();
+    while(!driver.IsRender()) {}
+}
+
+static uint32_t Checksum()
+{
+    uint32_t sum = 0;
+    for(uint16_t y = 0; y < 240; y++)
+    {
+        for(uint16_t x = 0; x < 320; x++)
+        {
+            sum = sum * 31 + host_panel.GetPixel(x, y);
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char** argv)
+{
+    MakeCursor();
+    driver.Init();
+
+    // Everything redrawn every frame, the way it had to be done
+    std::vector<uint32_t> expected;
+    host_panel.ResetStats();
+    for(int frame = 0; frame < frames; frame++)
+    {
+        int16_t x, cx, cy;
+        Place(frame, x, cx, cy);
+        DrawWaveform();
+        DrawCounter(frame);
+        driver.FillRect(Rectangle(x, 20, 2, 200), COLOR_WHITE, 192);
+        DrawCursor(cx, cy);
+        Send();
+        expected.push_back(Checksum());
+    }
+    double redraw_bytes = host_panel.GetStats().bytes / double(frames);
+
+    // The waveform drawn once, the rest as sprites
+    driver.AddSprite(playhead);
+    driver.AddSprite(pointer);
+    playhead.SetColor(COLOR_WHITE, 192);
+    DrawWaveform();
+    Send();
+
+    host_panel.ResetStats();
+    int mismatches = 0;
+    for(int frame = 0; frame < frames; frame++)
+    {
+        int16_t x, cx, cy;
+        Place(frame, x, cx, cy);
+        if(frame % 10 == 0)
+        {
+            DrawCounter(frame);
+        }
+        playhead.MoveTo(x, 20);
+        pointer.MoveTo(cx, cy);
+        Send();
+        mismatches += Checksum() != expected[frame];
+    }
+    auto& stats = host_panel.GetStats();
+    printf("redraw   %6.0f bytes per frame\n", redraw_bytes);
+    printf("sprites  %6.0f bytes per frame, %d of %d frames differ\n",
+           stats.bytes / double(frames),
+           mismatches,
+           frames);
+
+    if(argc > 1)
+    {
+        return !host_panel.WritePpm(argv[1]);
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+// Host stand-in for the HAL parts dma2d.cpp uses. The DMA2D registers are
+// plain memory except CR: writing START to it runs the transfer in software,
+// see dma2d_engine.cpp, and raises the interrupt when it's done.
+
+#include <cstdint>
+
+#define POSITION_VAL(VAL) (__builtin_ctz(VAL))
+
+// Writes are counted in host_dma2d_stats, for comparing register traffic
+#define READ_REG(REG) ((REG))
+#define WRITE_REG(REG, VAL) ((REG) = (VAL), host_dma2d_stats.register_writes++)
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) \
+    WRITE_REG((REG), ((READ_REG(REG) & ~(CLEARMASK)) | (SETMASK)))
+
+#define DMA2D_CR_START 0x00000001u
+#define DMA2D_CR_TEIE 0x00000100u
+#define DMA2D_CR_TCIE 0x00000200u
+#define DMA2D_CR_CEIE 0x00002000u
+#define DMA2D_CR_MODE 0x00070000u
+
+#define DMA2D_ISR_TEIF 0x00000001u
+#define DMA2D_ISR_TCIF 0x00000002u
+#define DMA2D_ISR_CEIF 0x00000020u
+
+#define DMA2D_FGPFCCR_CM 0x0000000Fu
+#define DMA2D_FGPFCCR_AM 0x00030000u
+#define DMA2D_FGPFCCR_AI 0x00100000u
+#define DMA2D_FGPFCCR_RBS 0x00200000u
+#define DMA2D_FGPFCCR_ALPHA 0xFF000000u
+#define DMA2D_BGPFCCR_CM 0x0000000Fu
+#define DMA2D_BGPFCCR_AM 0x00030000u
+#define DMA2D_BGPFCCR_AI 0x00100000u
+#define DMA2D_BGPFCCR_RBS 0x00200000u
+#define DMA2D_BGPFCCR_ALPHA 0xFF000000u
+#define DMA2D_OPFCCR_CM 0x00000007u
+#define DMA2D_OPFCCR_SB 0x00000100u
+#define DMA2D_OPFCCR_AI 0x00100000u
+#define DMA2D_OPFCCR_RBS 0x00200000u
+
+#define DMA2D_NLR_NL 0x0000FFFFu
+#define DMA2D_NLR_PL 0x3FFF0000u
+
+#define DMA2D_M2M 0x00000000u
+#define DMA2D_M2M_PFC 0x00010000u
+#define DMA2D_M2M_BLEND 0x00020000u
+#define DMA2D_R2M 0x00030000u
+#define DMA2D_M2M_BLEND_FG 0x00040000u
+#define DMA2D_M2M_BLEND_BG 0x00050000u
+
+#define DMA2D_OUTPUT_ARGB8888 0u
+#define DMA2D_OUTPUT_RGB888 1u
+#define DMA2D_OUTPUT_RGB565 2u
+#define DMA2D_OUTPUT_ARGB1555 3u
+#define DMA2D_OUTPUT_ARGB4444 4u
+
+#define DMA2D_INPUT_ARGB8888 0u
+#define DMA2D_INPUT_RGB888 1u
+#define DMA2D_INPUT_RGB565 2u
+#define DMA2D_INPUT_ARGB1555 3u
+#define DMA2D_INPUT_ARGB4444 4u
+#define DMA2D_INPUT_L8 5u
+#define DMA2D_INPUT_AL44 6u
+#define DMA2D_INPUT_AL88 7u
+#define DMA2D_INPUT_L4 8u
+#define DMA2D_INPUT_A8 9u
+#define DMA2D_INPUT_A4 10u
+
+#define DMA2D_NO_MODIF_ALPHA 0u
+#define DMA2D_REPLACE_ALPHA 1u
+#define DMA2D_COMBINE_ALPHA 2u
+
+#define DMA2D_REGULAR_ALPHA 0u
+#define DMA2D_INVERTED_ALPHA 1u
+#define DMA2D_RB_REGULAR 0u
+#define DMA2D_RB_SWAP 1u
+#define DMA2D_BYTES_REGULAR 0u
+#define DMA2D_BYTES_SWAP 1u
+#define DMA2D_NO_CSS 0u
+
+#define HAL_DMA2D_ERROR_NONE 0u
+#define HAL_DMA2D_ERROR_CE 0x2u
+
+#define __HAL_RCC_DMA2D_CLK_ENABLE()
+#define __HAL_RCC_DMA2D_CLK_DISABLE()
+
+typedef enum
+{
+    HAL_OK,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT,
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    DMA2D_IRQn = 90,
+} IRQn_Type;
+
+inline void HAL_NVIC_SetPriority(IRQn_Type irq, uint32_t pre, uint32_t sub) {}
+inline void HAL_NVIC_EnableIRQ(IRQn_Type irq) {}
+
+// The CMSIS DSP intrinsics BlendSpan565() uses, so its Cortex-M7 path can be
+// checked by building with -D__ARM_FEATURE_DSP
+#define __PKHBT(ARG1, ARG2, ARG3)                     \
+    ((((uint32_t)(ARG1)) & 0x0000FFFFu)               \
+     | ((((uint32_t)(ARG2)) << (ARG3)) & 0xFFFF0000u))
+#define __PKHTB(ARG1, ARG2, ARG3)                     \
+    ((((uint32_t)(ARG1)) & 0xFFFF0000u)               \
+     | ((((uint32_t)(ARG2)) >> (ARG3)) & 0x0000FFFFu))
+inline uint32_t __SMUAD(uint32_t op1, uint32_t op2)
+{
+    return int16_t(op1) * int16_t(op2) + int16_t(op1 >> 16) * int16_t(op2 >> 16);
+}
+
+// Runs the transfer set up in the other registers when START is written
+struct DMA2D_ControlRegister
+{
+    DMA2D_ControlRegister& operator=(uint32_t value);
+    operator uint32_t() const { return value; }
+
+    // Runs the transfer and raises its interrupt
+    void Finish();
+
+    uint32_t value = 0;
+};
+
+// Addresses are as wide as host pointers, the rest as on the target
+typedef struct
+{
+    DMA2D_ControlRegister CR;
+    volatile uint32_t     ISR;
+    volatile uint32_t     IFCR;
+    volatile uintptr_t    FGMAR;
+    volatile uint32_t     FGOR;
+    volatile uintptr_t    BGMAR;
+    volatile uint32_t     BGOR;
+    volatile uint32_t     FGPFCCR;
+    volatile uint32_t     FGCOLR;
+    volatile uint32_t     BGPFCCR;
+    volatile uint32_t     BGCOLR;
+    volatile uintptr_t    FGCMAR;
+    volatile uintptr_t    BGCMAR;
+    volatile uint32_t     OPFCCR;
+    volatile uint32_t     OCOLR;
+    volatile uintptr_t    OMAR;
+    volatile uint32_t     OOR;
+    volatile uint32_t     NLR;
+    volatile uint32_t     LWR;
+    volatile uint32_t     AMTCR;
+} DMA2D_TypeDef;
+
+extern DMA2D_TypeDef host_dma2d;
+#define DMA2D (&host_dma2d)
+
+// What the software DMA2D did, for benchmarks
+struct HostDma2DStats
+{
+    uint64_t transfers;
+    uint64_t pixels;
+    uint64_t register_writes; // through WRITE_REG()
+    uint64_t busy_ns;         // running transfers in software
+};
+
+extern HostDma2DStats host_dma2d_stats;
+
+// With host_dma2d_deferred set, a transfer doesn't run when START is written
+// but waits for HostDma2DComplete(), like the peripheral working on its own
+// while the CPU goes on. Completing it raises the interrupt.
+extern bool host_dma2d_deferred;
+
+// Runs the pending transfer, false if none is
+bool HostDma2DComplete();
+
+typedef struct
+{
+    uint32_t Mode;
+    uint32_t ColorMode;
+    uint32_t OutputOffset;
+    uint32_t AlphaInverted;
+    uint32_t RedBlueSwap;
+    uint32_t BytesSwap;
+    uint32_t LineOffsetMode;
+} DMA2D_InitTypeDef;
+
+typedef struct
+{
+    uint32_t InputOffset;
+    uint32_t InputColorMode;
+    uint32_t AlphaMode;
+    uint32_t InputAlpha;
+    uint32_t AlphaInverted;
+    uint32_t RedBlueSwap;
+    uint32_t ChromaSubSampling;
+} DMA2D_LayerCfgTypeDef;
+
+typedef enum
+{
+    HAL_DMA2D_STATE_RESET,
+    HAL_DMA2D_STATE_READY,
+    HAL_DMA2D_STATE_BUSY,
+} HAL_DMA2D_StateTypeDef;
+
+typedef struct __DMA2D_HandleTypeDef
+{
+    DMA2D_TypeDef*        Instance;
+    DMA2D_InitTypeDef     Init;
+    void                  (*XferCpltCallback)(struct __DMA2D_HandleTypeDef*);
+    void                  (*XferErrorCallback)(struct __DMA2D_HandleTypeDef*);
+    DMA2D_LayerCfgTypeDef LayerCfg[2];
+    HAL_DMA2D_StateTypeDef State;
+    uint32_t               ErrorCode;
+} DMA2D_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_DMA2D_Init(DMA2D_HandleTypeDef* hdma2d);
+HAL_StatusTypeDef HAL_DMA2D_ConfigLayer(DMA2D_HandleTypeDef* hdma2d,
+                                        uint32_t             layer);
+
+// These write the registers the way the STM32H7 HAL does, for comparing the
+// HAL path with the driver's own register writes. Transfers started through
+// them raise no interrupt.
+HAL_StatusTypeDef HAL_DMA2D_Start(DMA2D_HandleTypeDef* hdma2d,
+                                  uintptr_t            pdata,
+                                  uintptr_t            dst,
+                                  uint32_t             width,
+                                  uint32_t             height);
+HAL_StatusTypeDef HAL_DMA2D_BlendingStart(DMA2D_HandleTypeDef* hdma2d,
+                                          uintptr_t            src1,
+                                          uintptr_t            src2,
+                                          uintptr_t            dst,
+                                          uint32_t             width,
+                                          uint32_t             height);
+HAL_StatusTypeDef HAL_DMA2D_PollForTransfer(DMA2D_HandleTypeDef* hdma2d,
+                                            uint32_t             timeout);
+
+// Defined by the application, as with the real HAL
+void HAL_DMA2D_MspInit(DMA2D_HandleTypeDef* hdma2d);
+
+extern "C" void DMA2D_IRQHandler(void);
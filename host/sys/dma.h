@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for libDaisy's sys/dma.h, there is no cache to maintain
+
+#include <cstddef>
+#include <cstdint>
+
+inline void dsy_dma_clear_cache_for_buffer(uint8_t* buffer, size_t size) {}
+
+inline void dsy_dma_invalidate_cache_for_buffer(uint8_t* buffer, size_t size)
+{
+}
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include "ili9341_ui_driver.hpp"
+
+// Fills rectangles of every alpha, some reaching off screen, over each other
+// and after each checks every pixel the panel shows against blending it with
+// Blend565() over what the panel showed before, in the color an opaque fill
+// shows. Then does the same with a translucent sprite over the result. With
+// ILI9341_SPI_16BIT the DMA2D blends, which rounds differently and may be a
+// step off in any channel.
+// With ILI9341_INDEXED_FRAMEBUFFER pixels can't be blended, and mostly opaque
+// fills are expected to paint over. The band renderer's list must hold all
+// the fills.
+
+ILI9341UiDriver driver;
+
+static constexpr int width = 320, height = 240;
+static constexpr int fills = 200;
+
+static uint16_t expected[height][width];
+static uint16_t palette[NUMBER_OF_TFT_COLORS];
+
+#ifndef ILI9341_BAND_RENDERER
+alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION
+    under[Sprite::BufferSize(48, 40)];
+static Sprite sprite(48, 40, under);
+#endif
+
+static void Expect(const Rectangle& rect, uint8_t color, uint8_t alpha)
+{
+    uint16_t fg = palette[color];
+    for(int y = std::max<int>(rect.GetY(), 0);
+        y < std::min<int>(rect.GetBottom(), height);
+        y++)
+    {
+        for(int x = std::max<int>(rect.GetX(), 0);
+            x < std::min<int>(rect.GetRight(), width);
+            x++)
+        {
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+            expected[y][x] = alpha >= 128 ? fg : expected[y][x];
+#else
+            expected[y][x]
+                = alpha == 255 ? fg : Blend565(fg, expected[y][x], alpha);
+#endif
+        }
+    }
+}
+
+// Whether every channel of a and b is within tolerance steps
+static bool Near(uint16_t a, uint16_t b)
+{
+#ifdef ILI9341_SPI_16BIT
+    constexpr int tolerance = 1;
+#else
+    constexpr int tolerance = 0;
+#endif
+    return abs((a >> 11) - (b >> 11)) <= tolerance
+           && abs((a >> 5 & 0x3F) - (b >> 5 & 0x3F)) <= tolerance
+           && abs((a & 0x1F) - (b & 0x1F)) <= tolerance;
+}
+
+// Pixels the panel shows differently from expected, which then takes what
+// the panel shows
+static int Compare()
+{
+    driver.Update();
+    while(!driver.IsRender()) {}
+    int failures = 0;
+    for(uint16_t y = 0; y < height; y++)
+    {
+        for(uint16_t x = 0; x < width; x++)
+        {
+            uint16_t shown = host_panel.GetPixel(x, y);
+            failures += !Near(shown, expected[y][x]);
+            expected[y][x] = shown;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    driver.Init();
+    for(uint8_t color = 0; color < NUMBER_OF_TFT_COLORS; color++)
+    {
+        driver.FillRect(Rectangle(color, 0, 1, 1), color);
+    }
+    driver.Update();
+    while(!driver.IsRender()) {}
+    for(uint8_t color = 0; color < NUMBER_OF_TFT_COLORS; color++)
+    {
+        palette[color] = host_panel.GetPixel(color, 0);
+    }
+    srand(5);
+
+    driver.Fill(COLOR_BLUE);
+    Expect(Rectangle(0, 0, width, height), COLOR_BLUE, 255);
+    int fill_failures = 0;
+    for(int i = 0; i < fills; i++)
+    {
+        int16_t   x = rand() % (width + 40) - 20;
+        int16_t   y = rand() % (height + 40) - 20;
+        int16_t   w = 1 + rand() % 80, h = 1 + rand() % 60;
+        uint8_t   color = rand() % NUMBER_OF_TFT_COLORS;
+        uint8_t   alpha = i % 8 == 0 ? 255 : rand() % 256;
+        Rectangle rect(x, y, w, h);
+        driver.FillRect(rect, color, alpha);
+        Expect(rect, color, alpha);
+        fill_failures += Compare();
+    }
+    printf("fills                %d pixels differ from Blend565()\n",
+           fill_failures);
+
+    int sprite_failures = 0;
+#ifndef ILI9341_BAND_RENDERER
+    sprite.SetColor(COLOR_RED, 128);
+    sprite.MoveTo(100, 90);
+    driver.AddSprite(sprite);
+    Expect(Rectangle(100, 90, 48, 40), COLOR_RED, 128);
+    sprite_failures = Compare();
+    printf("translucent sprite   %d pixels differ from Blend565()\n",
+           sprite_failures);
+#endif
+    return fill_failures + sprite_failures != 0;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// dma2d.hpp includes the driver interface by its path in the application
+#include "../../src/ui_driver.hpp"
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "ui_command_queue.hpp"
+
+// A producer thread stands in for the audio callback: a thousand times a
+// second it posts the levels of 8 meters, numbered so the order can be
+// checked, and every tenth time a small drawing call without a target. Then
+// it posts as fast as it can, to overflow the ring of drawing calls. The main
+// loop drains the queue into the meters and the driver before each frame.
+// Checks that values only arrive for the meters, that every meter only ever
+// moves forward and ends on the last level posted, and that every command is
+// accounted for. Build with -fsanitize=thread to check the queue for races
+// as well.
+
+ILI9341UiDriver driver;
+UiCommandQueue  queue;
+
+static constexpr uint8_t  meters    = 8;
+static constexpr uint32_t callbacks = 1000;
+static constexpr uint32_t burst     = 200000;
+
+static std::atomic<bool> done{false};
+static uint32_t          posted = 0;
+static uint32_t          draws  = 0;
+
+static void Producer()
+{
+    uint32_t level = 0;
+    auto     post  = [&](uint32_t i)
+    {
+        level++;
+        for(uint8_t m = 0; m < meters; m++)
+        {
+            queue.PostValue(m, level);
+            posted++;
+        }
+        if(i % 10 == 0)
+        {
+            queue.PostFillRect(UiCommand::no_target,
+                               Rectangle(i % 300, 0, 8, 8),
+                               COLOR_ORANGE);
+            posted++;
+            draws++;
+        }
+    };
+    auto next = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < callbacks; i++)
+    {
+        post(i);
+        next += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next);
+    }
+    for(uint32_t i = 0; i < burst; i++)
+    {
+        post(i);
+    }
+    done = true;
+}
+
+int main()
+{
+    driver.Init();
+
+    float    shown[meters] = {};
+    uint32_t backwards = 0, strays = 0, handled = 0, drawn = 0, frames = 0;
+    auto     handle    = [&](const UiCommand& cmd)
+    {
+        handled++;
+        if(cmd.op != UiCommand::Op::Value)
+        {
+            cmd.Draw(driver);
+            drawn++;
+            return;
+        }
+        if(cmd.target >= meters)
+        {
+            strays++; // a value for a target nothing posted to
+            return;
+        }
+        backwards += cmd.value < shown[cmd.target];
+        shown[cmd.target] = cmd.value;
+        driver.FillRect(Rectangle(cmd.target * 40, 40, 30, 200), COLOR_BLACK);
+        int16_t height = int32_t(cmd.value) % 200;
+        driver.FillRect(Rectangle(cmd.target * 40, 240 - height, 30, height),
+                        COLOR_GREEN);
+    };
+
+    std::thread producer(Producer);
+    while(!done)
+    {
+        queue.Drain(handle);
+        driver.Update();
+        while(!driver.IsRender()) {}
+        frames++;
+    }
+    producer.join();
+    queue.Drain(handle);
+
+    uint32_t last = 0;
+    for(uint8_t m = 0; m < meters; m++)
+    {
+        last += shown[m] != shown[0];
+    }
+    uint32_t accounted = handled + queue.Coalesced() + queue.Overflows();
+    printf("%u frames, %u posted: %u handled (%u draws of %u), %u coalesced, "
+           "%u overflowed\n",
+           frames,
+           posted,
+           handled,
+           drawn,
+           draws,
+           queue.Coalesced(),
+           queue.Overflows());
+    printf("%u meters moved backwards, %u meters not on the last level, "
+           "%u values for other targets, %s\n",
+           backwards,
+           last,
+           strays,
+           accounted == posted ? "all accounted for" : "COMMANDS LOST");
+    return backwards != 0 || strays != 0 || accounted != posted;
+}
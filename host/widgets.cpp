@@ -0,0 +1,98 @@
+#include <cstdio>
+#include "widget_tree.hpp"
+
+// Runs a synth page through WidgetTree: one knob turning and a meter moving
+// per frame, the rest static. Prints the widgets redrawn and skipped and the
+// bytes sent per frame next to redrawing the whole page, and saves the last
+// frame if given a file name.
+
+ILI9341UiDriver driver;
+WidgetTree      tree;
+
+static const char* const presets[]
+    = {"Init", "Bass", "Pad", "Pluck", "Lead", "Brass", "Keys", "Drone"};
+
+Label    title(Rectangle(8, 4, 200, 18), "Filter", Font_11x18);
+Label    value(Rectangle(220, 8, 92, 10), "", Font_7x10, COLOR_CYAN);
+Knob     knobs[4] = {Knob(Rectangle(8, 30, 56, 56)),
+                     Knob(Rectangle(72, 30, 56, 56)),
+                     Knob(Rectangle(136, 30, 56, 56)),
+                     Knob(Rectangle(200, 30, 56, 56))};
+ValueBar bars[4]  = {ValueBar(Rectangle(8, 92, 56, 10)),
+                     ValueBar(Rectangle(72, 92, 56, 10)),
+                     ValueBar(Rectangle(136, 92, 56, 10)),
+                     ValueBar(Rectangle(200, 92, 56, 10))};
+Meter    meters[2] = {Meter(Rectangle(272, 30, 16, 200)),
+                      Meter(Rectangle(296, 30, 16, 200))};
+List     list(Rectangle(8, 112, 248, 120), presets, 8, Font_7x10);
+
+static constexpr int frames = 100;
+
+static void Animate(int frame)
+{
+    int   k = frame / 25 % 4;
+    float v = (frame % 25) / 24.f;
+    knobs[k].SetValue(v);
+    bars[k].SetValue(v);
+    meters[frame & 1].SetLevel((frame * 37 % 100) / 100.f);
+
+    char text[16];
+    snprintf(text, sizeof(text), "%d%%", int(v * 100));
+    value.SetText(text);
+}
+
+int main(int argc, char** argv)
+{
+    driver.Init();
+    driver.Fill(COLOR_BLACK);
+    driver.Update();
+    while(!driver.IsRender()) {}
+
+    tree.Add(title);
+    tree.Add(value);
+    for(int i = 0; i < 4; i++)
+    {
+        tree.Add(knobs[i]);
+        tree.Add(bars[i]);
+    }
+    tree.Add(meters[0]);
+    tree.Add(meters[1]);
+    tree.Add(list);
+    tree.Render(driver);
+    driver.Update();
+    while(!driver.IsRender()) {}
+
+    for(int full = 0; full < 2; full++)
+    {
+        host_panel.ResetStats();
+        uint32_t redrawn = 0, skipped = 0;
+        for(int frame = 0; frame < frames; frame++)
+        {
+            Animate(frame);
+            list.Select(frame / 10 % 8);
+            if(full)
+            {
+                tree.Invalidate();
+            }
+            tree.Render(driver);
+            driver.Update();
+            while(!driver.IsRender()) {}
+            redrawn += tree.Redrawn();
+            skipped += tree.Skipped();
+        }
+        auto& stats = host_panel.GetStats();
+        printf("%-8s %5.2f redrawn %5.2f skipped, %6.0f bytes %5.2f ms "
+               "per frame\n",
+               full ? "all" : "changed",
+               redrawn / double(frames),
+               skipped / double(frames),
+               stats.bytes / double(frames),
+               stats.busy_ns / 1e6 / frames);
+    }
+
+    if(argc > 1)
+    {
+        return !host_panel.WritePpm(argv[1]);
+    }
+    return 0;
+}
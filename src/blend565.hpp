@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include "ili9341_pixel.hpp"
+#if defined(__ARM_FEATURE_DSP)
+#include "stm32h7xx_hal.h" // CMSIS __SMUAD(), __PKHBT() and __PKHTB()
+#endif
+
+inline uint16_t Blend565(uint16_t fg, uint16_t bg, uint8_t alpha)
+{
+    int max_alpha   = 64;
+    int mask_mul_rb = 4065216; // 0b1111100000011111
+    int mask_mul_g  = 129024;  // 0b0000011111100000
+    int mask_rb     = 63519;   // 0b1111100000011111000000
+    int mask_g      = 2016;    // 0b0000011111100000000000
+
+    // alpha for foreground multiplication  convert from 8bit to (6bit+1) with rounding will be in [0..64] inclusive
+    alpha = (alpha + 2) >> 2;
+    // "beta" for background multiplication; (6bit+1); will be in [0..64] inclusive
+    uint8_t beta = max_alpha - alpha;
+    // so (0..64)*alpha + (0..64)*beta always in 0..64
+    return (uint16_t)((((alpha * (uint32_t)(fg & mask_rb)
+                         + beta * (uint32_t)(bg & mask_rb))
+                        & mask_mul_rb)
+                       | ((alpha * (fg & mask_g) + beta * (bg & mask_g))
+                          & mask_mul_g))
+                      >> 6);
+}
+
+/**
+ * Blends color over n pixels of a frame buffer row, giving bit for bit what
+ * Blend565() gives for each pixel.
+ *
+ * Where the target has the DSP extension (the Cortex-M7), pixels are loaded
+ * and stored two per 32 bit word. The blend's operands, channels of 0..63
+ * and weights of 0..64, fit signed halfwords, so one SMUAD gives a channel's
+ * fg * a + bg * beta. Elsewhere each channel is blended in 16 bit steps, the
+ * color's share worked out once per span, over blocks of 8 pixels the
+ * compiler vectorizes where it has SIMD (a block per SSE register on the
+ * host).
+ */
+inline void BlendSpan565(uint16_t* pixels,
+                         uint32_t  n,
+                         uint16_t  color,
+                         uint8_t   alpha)
+{
+    uint16_t a = (alpha + 2) >> 2;
+    if(a == 0)
+    {
+        return; // Blend565() gives the background back
+    }
+    uint16_t beta = 64 - a;
+
+#if defined(__ARM_FEATURE_DSP)
+    // beta in the low halfword, paired with the background's channel, and a
+    // in the high one, paired with the color's
+    const uint32_t weights = __PKHBT(beta, a, 16);
+    const uint32_t r_fg    = uint32_t(color >> 11) << 16;
+    const uint32_t g_fg    = uint32_t(color >> 5 & 0x3F) << 16;
+    const uint32_t b_fg    = uint32_t(color & 0x1F) << 16;
+
+    // Native pixels in, native pixels out
+    auto blend_pair = [=](uint32_t bg)
+    {
+        uint32_t r = bg >> 11 & 0x001F001F;
+        uint32_t g = bg >> 5 & 0x003F003F;
+        uint32_t b = bg & 0x001F001F;
+        // Each pixel's channel next to the color's, then a multiply-add
+        r = __PKHBT(__SMUAD(__PKHBT(r, r_fg, 0), weights),
+                    __SMUAD(__PKHTB(r_fg, r, 16), weights),
+                    16);
+        g = __PKHBT(__SMUAD(__PKHBT(g, g_fg, 0), weights),
+                    __SMUAD(__PKHTB(g_fg, g, 16), weights),
+                    16);
+        b = __PKHBT(__SMUAD(__PKHBT(b, b_fg, 0), weights),
+                    __SMUAD(__PKHTB(b_fg, b, 16), weights),
+                    16);
+        // Each sum divided by 64 and moved back into place, both at once
+        return (r << 5 & 0xF800F800) | (g >> 1 & 0x07E007E0)
+               | (b >> 6 & 0x001F001F);
+    };
+    auto blend_one = [&](uint16_t* pixel)
+    {
+        *pixel = FrameBufferPixel(
+            uint16_t(blend_pair(FrameBufferPixel(*pixel))));
+    };
+
+    if(n > 0 && reinterpret_cast<uintptr_t>(pixels) & 0x2)
+    {
+        blend_one(pixels++);
+        n--;
+    }
+    auto pair = reinterpret_cast<uint32_t*>(pixels);
+    for(; n >= 2; n -= 2, pair++)
+    {
+        *pair = FrameBufferPixels(blend_pair(FrameBufferPixels(*pair)));
+    }
+    if(n)
+    {
+        blend_one(reinterpret_cast<uint16_t*>(pair));
+    }
+#else
+    // The color's share of each channel
+    uint16_t r_fg = a * (color >> 11);
+    uint16_t g_fg = a * (color >> 5 & 0x3F);
+    uint16_t b_fg = a * (color & 0x1F);
+
+    auto blend = [=](uint16_t* pixel)
+    {
+        uint16_t bg = FrameBufferPixel(*pixel);
+        uint16_t r  = uint16_t(bg >> 11) * beta + r_fg;
+        uint16_t g  = uint16_t(bg >> 5 & 0x3F) * beta + g_fg;
+        uint16_t b  = uint16_t(bg & 0x1F) * beta + b_fg;
+        // Each sum divided by 64 and moved back into place
+        *pixel = FrameBufferPixel(
+            uint16_t((r << 5 & 0xF800) | (g >> 1 & 0x07E0) | b >> 6));
+    };
+
+    // Blocks of a fixed size, so the compiler needn't peel them to vectorize
+    for(; n >= 8; n -= 8, pixels += 8)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            blend(pixels + i);
+        }
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        blend(pixels + i);
+    }
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// Set in a command's parameter count when a delay in ms follows them
+constexpr uint8_t command_delay_flag = 0x80;
+
+/**
+ * Panel commands packed back to back into bytes, each as
+ *   command, count, count parameters[, delay in ms]
+ * where the delay is only there if count has command_delay_flag set. Fixed
+ * sequences such as the init sequence are constant tables in this format,
+ * so they stay in flash, and CommandStream builds them at run time. The
+ * transport's SendCommands() plays either back.
+ */
+template <size_t capacity>
+class CommandStream
+{
+  public:
+    /**
+     * @brief Appends cmd with its parameters, then a pause of delay_ms.
+     * Commands that don't fit are dropped and Overflowed() says so.
+     */
+    CommandStream& Command(uint8_t                        cmd,
+                           std::initializer_list<uint8_t> params   = {},
+                           uint8_t                        delay_ms = 0)
+    {
+        size_t needed = 2 + params.size() + (delay_ms ? 1 : 0);
+        if(params.size() >= command_delay_flag || size_ + needed > capacity)
+        {
+            overflowed_ = true;
+            return *this;
+        }
+
+        bytes_[size_++] = cmd;
+        bytes_[size_++] = params.size() | (delay_ms ? command_delay_flag : 0);
+        for(auto param : params)
+        {
+            bytes_[size_++] = param;
+        }
+        if(delay_ms)
+        {
+            bytes_[size_++] = delay_ms;
+        }
+        return *this;
+    }
+
+    void Clear()
+    {
+        size_       = 0;
+        overflowed_ = false;
+    }
+
+    const uint8_t* Data() const { return bytes_; }
+
+    size_t Size() const { return size_; }
+
+    bool Overflowed() const { return overflowed_; }
+
+  private:
+    uint8_t bytes_[capacity];
+    size_t  size_       = 0;
+    bool    overflowed_ = false;
+};
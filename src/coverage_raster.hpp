@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+/**
+ * Anti-aliased lines and rings, in integer math only.
+ *
+ * Shapes come out as runs of pixels sharing a coverage, passed to
+ * sink(x0, x1, y, coverage) with x0 <= x1 and coverage 1..255, so the solid
+ * parts stay long runs and only the edges go pixel by pixel. Pixel centers
+ * are at whole coordinates.
+ *
+ * Ring radii are in 1/16 pixel (Q4). A pixel's coverage follows its distance
+ * d from the edge, 0.5 + (r - d) clamped to 0..1, where r - d is taken as
+ * (r^2 - d^2) / 2r: near the edge that is within a few percent and needs no
+ * square root per pixel.
+ */
+class CoverageRaster
+{
+  public:
+    static constexpr int32_t one = 16; // a pixel in Q4
+
+    /**
+     * @brief Wu's line from (x0, y0) to (x1, y1): along the major axis each
+     * step covers the two pixels straddling the line, in proportion to how
+     * close it passes.
+     */
+    template <typename Sink>
+    static void
+    Line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, Sink&& sink)
+    {
+        bool steep = abs(y1 - y0) > abs(x1 - x0);
+        if(steep)
+        {
+            std::swap(x0, y0);
+            std::swap(x1, y1);
+        }
+        if(x0 > x1)
+        {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+        }
+
+        int32_t dx       = x1 - x0;
+        int32_t gradient = dx ? (y1 - y0) * 65536 / dx : 0; // Q16
+        int32_t y        = y0 * 65536;
+        for(int32_t x = x0; x <= x1; x++, y += gradient)
+        {
+            int32_t yi   = y >> 16;
+            uint8_t frac = y >> 8 & 0xFF;
+            if(steep)
+            {
+                sink(yi, yi, x, 255 - frac);
+                if(frac)
+                {
+                    sink(yi + 1, yi + 1, x, frac);
+                }
+            }
+            else
+            {
+                sink(x, x, yi, 255 - frac);
+                if(frac)
+                {
+                    sink(x, x, yi + 1, frac);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief The ring between radii inner and outer (Q4) around (cx, cy),
+     * from angle start to end in degrees, clockwise from 3 o'clock. inner 0
+     * makes a disc, a sweep of 360 or more a whole ring. Only rows top to
+     * bottom - 1 are rasterized.
+     *
+     * Without a sweep limit the solid part of each row is a single run, so
+     * a filled disc costs its edge pixels plus a run per row. Arcs check the
+     * angle at every pixel, cheap for the thin rings of a knob.
+     */
+    template <typename Sink>
+    static void Ring(int32_t cx,
+                     int32_t cy,
+                     int32_t outer,
+                     int32_t inner,
+                     int32_t start,
+                     int32_t end,
+                     int32_t top,
+                     int32_t bottom,
+                     Sink&&  sink)
+    {
+        int32_t sweep = end - start;
+        if(outer <= 0 || inner >= outer || sweep <= 0)
+        {
+            return;
+        }
+        inner = std::max<int32_t>(inner, 0);
+
+        // Edge coverage slopes, see Coverage()
+        int32_t outer2  = outer * outer;
+        int32_t inner2  = inner * inner;
+        int32_t outer_k = (8 << 16) / outer;
+        int32_t inner_k = inner ? (8 << 16) / inner : 0;
+
+        // Directions of the start and end rays, Q15
+        bool    whole   = sweep >= 360;
+        int32_t start_x = Cos(start);
+        int32_t start_y = Sin(start);
+        int32_t end_x   = Cos(end);
+        int32_t end_y   = Sin(end);
+
+        auto coverage = [&](int32_t dx, int32_t dy, int32_t dy2)
+        {
+            int32_t d2 = dx * dx * one * one + dy2;
+            int32_t c  = Coverage(outer2 - d2, outer_k);
+            if(inner)
+            {
+                c = std::min(c, Coverage(d2 - inner2, inner_k));
+            }
+            if(!whole && c > 0)
+            {
+                // Signed distances from the start and end rays, Q15 pixels
+                int32_t from_start = start_x * dy - start_y * dx;
+                int32_t to_end     = end_y * dx - end_x * dy;
+                int32_t a = std::clamp(128 + (from_start >> 7), 0, 255);
+                int32_t b = std::clamp(128 + (to_end >> 7), 0, 255);
+                // Both rays bound a sweep up to half a turn, either one a
+                // longer sweep
+                int32_t angle = sweep <= 180 ? std::min(a, b) : std::max(a, b);
+                c             = c * (angle + 1) >> 8;
+            }
+            return c;
+        };
+
+        // Rows with any coverage: d < outer + 0.5
+        int32_t reach = (outer + one / 2 + one - 1) / one;
+        int32_t y0    = std::max(cy - reach, top);
+        int32_t y1    = std::min(cy + reach, bottom - 1);
+        for(int32_t y = y0; y <= y1; y++)
+        {
+            int32_t dy  = y - cy;
+            int32_t dy2 = dy * dy * one * one;
+
+            // Half widths of the row: any coverage, full outer coverage,
+            // nothing inside the hole and full inner coverage
+            int32_t any   = HalfWidth(outer + one / 2, dy2) + 1;
+            int32_t solid = HalfWidth(outer - one / 2, dy2) - 1;
+            int32_t hole  = inner ? HalfWidth(inner - one / 2, dy2) - 1 : -1;
+            int32_t clear = inner ? HalfWidth(inner + one / 2, dy2) + 1 : -1;
+
+            // |dx| in solid_near..solid_far is fully covered
+            int32_t solid_near = clear + 1;
+            int32_t solid_far  = whole ? solid : -1;
+
+            Runs<Sink> runs{sink, y};
+            for(int32_t dx = -any; dx <= any; dx++)
+            {
+                int32_t ad = abs(dx);
+                if(ad <= hole)
+                {
+                    dx = hole;
+                    continue;
+                }
+                if(solid_near <= solid_far && ad == solid_far && dx < 0)
+                {
+                    // Through the middle at once if there is no hole
+                    int32_t last = solid_near > 0 ? -solid_near : solid_far;
+                    runs.Solid(cx + dx, cx + last);
+                    dx = last;
+                    continue;
+                }
+                if(solid_near <= solid_far && dx == solid_near && dx > 0)
+                {
+                    runs.Solid(cx + dx, cx + solid_far);
+                    dx = solid_far;
+                    continue;
+                }
+                runs.Add(cx + dx, coverage(dx, dy, dy2));
+            }
+            runs.Flush();
+        }
+    }
+
+    /**
+     * @brief sin() of a whole number of degrees in Q15.
+     */
+    static int32_t Sin(int32_t degrees)
+    {
+        // sin(0..90 degrees) in Q15
+        static const int16_t quarter[91]
+            = {0,     572,   1144,  1715,  2286,  2856,  3425,  3993,  4560,
+               5126,  5690,  6252,  6813,  7371,  7927,  8481,  9032,  9580,
+               10126, 10668, 11207, 11743, 12275, 12803, 13328, 13848, 14365,
+               14876, 15384, 15886, 16384, 16877, 17364, 17847, 18324, 18795,
+               19261, 19720, 20174, 20622, 21063, 21498, 21926, 22348, 22763,
+               23170, 23571, 23965, 24351, 24730, 25102, 25466, 25822, 26170,
+               26510, 26842, 27166, 27482, 27789, 28088, 28378, 28660, 28932,
+               29197, 29452, 29698, 29935, 30163, 30382, 30592, 30792, 30983,
+               31164, 31336, 31499, 31651, 31795, 31928, 32052, 32166, 32270,
+               32365, 32449, 32524, 32588, 32643, 32688, 32723, 32748, 32763,
+               32767};
+        degrees %= 360;
+        if(degrees < 0)
+        {
+            degrees += 360;
+        }
+        if(degrees <= 90)
+            return quarter[degrees];
+        if(degrees <= 180)
+            return quarter[180 - degrees];
+        if(degrees <= 270)
+            return -quarter[degrees - 180];
+        return -quarter[360 - degrees];
+    }
+
+    static int32_t Cos(int32_t degrees) { return Sin(degrees + 90); }
+
+  private:
+    /**
+     * Collects pixels of a row into runs of equal coverage for the sink,
+     * leaving out uncovered ones.
+     */
+    template <typename Sink>
+    struct Runs
+    {
+        Sink&   sink;
+        int32_t y;
+        int32_t x0 = 0, x1 = -1, coverage = 0;
+
+        void Add(int32_t x, int32_t c)
+        {
+            if(c == coverage && x == x1 + 1)
+            {
+                x1 = x;
+                return;
+            }
+            Flush();
+            x0 = x1  = x;
+            coverage = c;
+        }
+
+        void Solid(int32_t xa, int32_t xb)
+        {
+            if(xa > xb)
+            {
+                std::swap(xa, xb);
+            }
+            if(coverage == 255 && xa == x1 + 1)
+            {
+                x1 = xb;
+                return;
+            }
+            Flush();
+            x0       = xa;
+            x1       = xb;
+            coverage = 255;
+        }
+
+        void Flush()
+        {
+            if(coverage > 0 && x0 <= x1)
+            {
+                sink(x0, x1, y, coverage);
+            }
+            x1       = x0 - 1;
+            coverage = 0;
+        }
+    };
+
+    // 0.5 + (r^2 - d^2) / 2r in 1/255, with k = (8 << 16) / r (Q4 radii)
+    static int32_t Coverage(int32_t r2_minus_d2, int32_t k)
+    {
+        int32_t c = 128 + int32_t((int64_t(r2_minus_d2) * k) >> 16);
+        return std::clamp<int32_t>(c, 0, 255);
+    }
+
+    // Largest whole dx with dx^2 + dy^2 <= r^2, -1 if none (r Q4, dy2 Q8)
+    static int32_t HalfWidth(int32_t r, int32_t dy2)
+    {
+        int32_t left = r * r - dy2;
+        if(r <= 0 || left < 0)
+        {
+            return -1;
+        }
+        return ISqrt(left) / one;
+    }
+
+    static uint32_t ISqrt(uint32_t value)
+    {
+        uint32_t root = 0;
+        uint32_t bit  = 1u << 30;
+        while(bit > value)
+        {
+            bit >>= 2;
+        }
+        while(bit)
+        {
+            if(value >= root + bit)
+            {
+                value -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+            {
+                root >>= 1;
+            }
+            bit >>= 2;
+        }
+        return root;
+    }
+};
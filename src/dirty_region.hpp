@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Tracks the damaged areas of the frame buffer as a small set of rectangles.
+ *
+ * Every drawing call reports its bounding box, overlapping or touching areas
+ * are merged on the fly, and when the list is full the pair whose union wastes
+ * the least pixels is collapsed. The transport then only sends these areas.
+ */
+class DirtyRegion
+{
+  public:
+    // Inclusive screen coordinates, same convention as SetAddressWindow()
+    struct Area
+    {
+        uint16_t x0, y0, x1, y1;
+
+        uint32_t Width() const { return x1 - x0 + 1; }
+        uint32_t Height() const { return y1 - y0 + 1; }
+        uint32_t Size() const { return Width() * Height(); }
+    };
+
+    static constexpr uint8_t max_areas = 8;
+
+    void Init(uint16_t width, uint16_t height)
+    {
+        width_  = width;
+        height_ = height;
+        Clear();
+    }
+
+    void Clear() { count_ = 0; }
+
+    void MarkAll() { Add(0, 0, width_ - 1, height_ - 1); }
+
+    /**
+     * @brief Adds an inclusive rectangle, clipped to the screen. Nothing is
+     * added when x1 < x0 or y1 < y0, as for an empty string.
+     */
+    void Add(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+    {
+        if(x1 < x0 || y1 < y0)
+        {
+            return;
+        }
+        if(x1 < 0 || y1 < 0 || x0 >= width_ || y0 >= height_)
+        {
+            return;
+        }
+
+        Area area = {static_cast<uint16_t>(x0 < 0 ? 0 : x0),
+                     static_cast<uint16_t>(y0 < 0 ? 0 : y0),
+                     static_cast<uint16_t>(x1 >= width_ ? width_ - 1 : x1),
+                     static_cast<uint16_t>(y1 >= height_ ? height_ - 1 : y1)};
+
+        // Most calls land inside an area that is already dirty
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            if(Contains(areas_[i], area))
+            {
+                return;
+            }
+        }
+
+        areas_[count_++] = area;
+        Merge(count_ - 1);
+
+        if(count_ == max_areas)
+        {
+            Collapse();
+        }
+    }
+
+    bool IsEmpty() const { return count_ == 0; }
+
+    uint8_t Count() const { return count_; }
+
+    const Area& operator[](uint8_t i) const { return areas_[i]; }
+
+    /**
+     * @brief Number of pixels covered by the tracked areas.
+     */
+    uint32_t Coverage() const
+    {
+        uint32_t size = 0;
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            size += areas_[i].Size();
+        }
+        return size;
+    }
+
+  private:
+    static bool Contains(const Area& outer, const Area& inner)
+    {
+        return inner.x0 >= outer.x0 && inner.x1 <= outer.x1
+               && inner.y0 >= outer.y0 && inner.y1 <= outer.y1;
+    }
+
+    // Overlapping or directly adjacent areas
+    static bool Touches(const Area& a, const Area& b)
+    {
+        return a.x0 <= b.x1 + 1 && b.x0 <= a.x1 + 1 && a.y0 <= b.y1 + 1
+               && b.y0 <= a.y1 + 1;
+    }
+
+    static Area Union(const Area& a, const Area& b)
+    {
+        return {std::min(a.x0, b.x0),
+                std::min(a.y0, b.y0),
+                std::max(a.x1, b.x1),
+                std::max(a.y1, b.y1)};
+    }
+
+    // Pixels that would be sent without being damaged if a and b were merged
+    static uint32_t Waste(const Area& a, const Area& b)
+    {
+        auto size = a.Size() + b.Size();
+        auto u    = Union(a, b).Size();
+        return u > size ? u - size : 0;
+    }
+
+    void Remove(uint8_t i) { areas_[i] = areas_[--count_]; }
+
+    // Folds every area touching areas_[i] into it, cheap merges only
+    void Merge(uint8_t i)
+    {
+        bool merged = true;
+        while(merged)
+        {
+            merged = false;
+            for(uint8_t j = 0; j < count_; j++)
+            {
+                if(j == i || !Touches(areas_[i], areas_[j]))
+                {
+                    continue;
+                }
+                if(Waste(areas_[i], areas_[j]) > merge_slack)
+                {
+                    continue;
+                }
+
+                areas_[i] = Union(areas_[i], areas_[j]);
+                Remove(j);
+                if(i == count_)
+                {
+                    i = j;
+                }
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    // Frees one slot by merging the cheapest pair
+    void Collapse()
+    {
+        uint8_t  best_a = 0, best_b = 1;
+        uint32_t best_waste = UINT32_MAX;
+        for(uint8_t a = 0; a < count_; a++)
+        {
+            for(uint8_t b = a + 1; b < count_; b++)
+            {
+                auto waste = Waste(areas_[a], areas_[b]);
+                if(waste < best_waste)
+                {
+                    best_waste = waste;
+                    best_a     = a;
+                    best_b     = b;
+                }
+            }
+        }
+
+        areas_[best_a] = Union(areas_[best_a], areas_[best_b]);
+        Remove(best_b);
+        if(best_a == count_)
+        {
+            best_a = best_b;
+        }
+        Merge(best_a);
+    }
+
+    // Touching areas are merged as long as this many extra pixels are sent
+    static constexpr uint32_t merge_slack = 256;
+
+    Area     areas_[max_areas];
+    uint8_t  count_  = 0;
+    uint16_t width_  = 0;
+    uint16_t height_ = 0;
+};
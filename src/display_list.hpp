@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "util/oled_fonts.h"
+#include "hid/disp/graphics_common.h"
+#include "polygon_raster.hpp"
+
+#ifndef ILI9341_DISPLAY_LIST_SIZE
+#define ILI9341_DISPLAY_LIST_SIZE 256
+#endif
+
+#ifndef ILI9341_DISPLAY_LIST_TEXT
+#define ILI9341_DISPLAY_LIST_TEXT 1024
+#endif
+
+// Inclusive rows a column is filled from and to, none if top > bottom
+struct ColumnSpan
+{
+    int16_t top, bottom;
+};
+
+/**
+ * Drawing calls recorded for the band renderer.
+ *
+ * Without a frame buffer nothing remembers what was drawn, so the list is the
+ * picture: a band is rendered by replaying every command touching it. An
+ * opaque fill drops the commands it hides, which keeps the list short for
+ * screens that clear an area before redrawing it.
+ */
+class DisplayList
+{
+  public:
+    static constexpr uint16_t max_commands = ILI9341_DISPLAY_LIST_SIZE;
+    static constexpr uint16_t max_text     = ILI9341_DISPLAY_LIST_TEXT;
+
+    enum class Op : uint8_t
+    {
+        Line,
+        Rect,
+        FillRect,
+        FillTriangle,
+        Polygon, // convex, vertices read in place
+        Circle,
+        FillCircle,
+        String,
+        LineAA,
+        Ring, // anti-aliased circles and arcs
+        Image,
+        Columns, // vertical spans, see ColumnSpan
+    };
+
+    struct Command
+    {
+        Op       op;
+        uint8_t  color, alpha;
+        uint8_t  font_width, font_height;
+        int16_t  x0, y0, x1, y1, x2, y2; // as passed to the drawing call
+        int16_t  left, top, right, bottom; // inclusive screen bounds
+        uint16_t text;                     // offset of the string
+        union
+        {
+            const uint16_t*              font_data;
+            const uint8_t*               image; // see RleImage, drawn in place
+            const ColumnSpan*            spans; // read in place too
+            const PolygonRaster::Vertex* points; // and so are these
+        };
+
+        daisy::FontDef Font() const
+        {
+            return {font_width, font_height, font_data};
+        }
+
+        bool Overlaps(int16_t x0, int16_t y0, int16_t x1, int16_t y1) const
+        {
+            return left <= x1 && right >= x0 && top <= y1 && bottom >= y0;
+        }
+
+        bool Covers(const Command& other) const
+        {
+            return left <= other.left && right >= other.right
+                   && top <= other.top && bottom >= other.bottom;
+        }
+
+        // Clips the bounds to the screen, false if nothing is left
+        bool Clip(int16_t width, int16_t height)
+        {
+            left   = std::max<int16_t>(left, 0);
+            top    = std::max<int16_t>(top, 0);
+            right  = std::min<int16_t>(right, width - 1);
+            bottom = std::min<int16_t>(bottom, height - 1);
+            return left <= right && top <= bottom;
+        }
+    };
+
+    static Command Line(uint16_t x1,
+                        uint16_t y1,
+                        uint16_t x2,
+                        uint16_t y2,
+                        uint8_t  color,
+                        uint8_t  alpha)
+    {
+        Command cmd = Make(Op::Line, color, alpha);
+        Set(cmd, x1, y1, x2, y2);
+        Bounds(cmd,
+               std::min(x1, x2),
+               std::min(y1, y2),
+               std::max(x1, x2),
+               std::max(y1, y2));
+        return cmd;
+    }
+
+    static Command Rect(uint16_t x,
+                        uint16_t y,
+                        uint16_t w,
+                        uint16_t h,
+                        uint8_t  color,
+                        uint8_t  alpha)
+    {
+        Command cmd = Make(Op::Rect, color, alpha);
+        Set(cmd, x, y, w, h);
+        Bounds(cmd, x, y, x + w, y + h);
+        return cmd;
+    }
+
+    static Command FillRect(const daisy::Rectangle& rect,
+                            uint8_t                 color,
+                            uint8_t                 alpha)
+    {
+        Command cmd = Make(Op::FillRect, color, alpha);
+        Set(cmd, rect.GetX(), rect.GetY(), rect.GetWidth(), rect.GetHeight());
+        Bounds(cmd,
+               rect.GetX(),
+               rect.GetY(),
+               rect.GetRight() - 1,
+               rect.GetBottom() - 1);
+        return cmd;
+    }
+
+    static Command FillTriangle(int16_t x0,
+                                int16_t y0,
+                                int16_t x1,
+                                int16_t y1,
+                                int16_t x2,
+                                int16_t y2,
+                                uint8_t color,
+                                uint8_t alpha)
+    {
+        Command cmd = Make(Op::FillTriangle, color, alpha);
+        Set(cmd, x0, y0, x1, y1);
+        cmd.x2 = x2;
+        cmd.y2 = y2;
+        Bounds(cmd,
+               std::min({x0, x1, x2}),
+               std::min({y0, y1, y2}),
+               std::max({x0, x1, x2}),
+               std::max({y0, y1, y2}));
+        return cmd;
+    }
+
+    static Command Polygon(const PolygonRaster::Vertex* points,
+                           uint8_t                      count,
+                           uint8_t                      color,
+                           uint8_t                      alpha)
+    {
+        Command cmd = Make(Op::Polygon, color, alpha);
+        cmd.points  = points;
+        Set(cmd, count, 0, 0, 0);
+        int16_t left = INT16_MAX, top = INT16_MAX;
+        int16_t right = INT16_MIN, bottom = INT16_MIN;
+        for(uint8_t i = 0; i < count; i++)
+        {
+            left   = std::min(left, points[i].x);
+            top    = std::min(top, points[i].y);
+            right  = std::max(right, points[i].x);
+            bottom = std::max(bottom, points[i].y);
+        }
+        Bounds(cmd, left, top, right, bottom);
+        return cmd;
+    }
+
+    static Command Circle(int16_t x, int16_t y, int16_t r, uint8_t color)
+    {
+        Command cmd = Make(Op::Circle, color, 255);
+        Set(cmd, x, y, r, 0);
+        Bounds(cmd, x - r, y - r, x + r, y + r);
+        return cmd;
+    }
+
+    static Command FillCircle(int16_t x, int16_t y, int16_t r, uint8_t color)
+    {
+        Command cmd = Make(Op::FillCircle, color, 255);
+        Set(cmd, x, y, r, 0);
+        // FillCircle() draws its center line down to y + 2 * r + 1
+        Bounds(cmd, x - r, y - r, x + r, y + 2 * r + 1);
+        return cmd;
+    }
+
+    static Command LineAA(int16_t x1,
+                          int16_t y1,
+                          int16_t x2,
+                          int16_t y2,
+                          uint8_t color,
+                          uint8_t alpha)
+    {
+        Command cmd = Make(Op::LineAA, color, alpha);
+        Set(cmd, x1, y1, x2, y2);
+        // The pixel next to the line's path gets some coverage too
+        Bounds(cmd,
+               std::min(x1, x2) - 1,
+               std::min(y1, y2) - 1,
+               std::max(x1, x2) + 1,
+               std::max(y1, y2) + 1);
+        return cmd;
+    }
+
+    // Radii in 1/16 pixel, angles in degrees, see CoverageRaster::Ring()
+    static Command Ring(int16_t x,
+                        int16_t y,
+                        int16_t outer,
+                        int16_t inner,
+                        int16_t start,
+                        int16_t end,
+                        uint8_t color,
+                        uint8_t alpha)
+    {
+        Command cmd = Make(Op::Ring, color, alpha);
+        Set(cmd, x, y, outer, inner);
+        cmd.x2     = start;
+        cmd.y2     = end;
+        auto reach = outer / 16 + 2; // half a pixel of edge, rounded up
+        Bounds(cmd, x - reach, y - reach, x + reach, y + reach);
+        return cmd;
+    }
+
+    static Command String(uint16_t              x,
+                          uint16_t              y,
+                          const daisy::FontDef& font,
+                          uint16_t              text_width,
+                          uint8_t               color)
+    {
+        Command cmd     = Make(Op::String, color, 255);
+        cmd.font_width  = font.FontWidth;
+        cmd.font_height = font.FontHeight;
+        cmd.font_data   = font.data;
+        Set(cmd, x, y, 0, 0);
+        Bounds(cmd, x, y, x + text_width - 1, y + font.FontHeight - 1);
+        return cmd;
+    }
+
+    static Command Image(int16_t        x,
+                         int16_t        y,
+                         uint16_t       width,
+                         uint16_t       height,
+                         const uint8_t* image,
+                         uint8_t        alpha)
+    {
+        Command cmd = Make(Op::Image, 0, alpha);
+        cmd.image   = image;
+        Set(cmd, x, y, width, height);
+        Bounds(cmd, x, y, x + width - 1, y + height - 1);
+        return cmd;
+    }
+
+    // Bounds are those of the spans actually filled
+    static Command Columns(int16_t           x,
+                           const ColumnSpan* spans,
+                           uint16_t          count,
+                           int16_t           left,
+                           int16_t           top,
+                           int16_t           right,
+                           int16_t           bottom,
+                           uint8_t           color,
+                           uint8_t           alpha)
+    {
+        Command cmd = Make(Op::Columns, color, alpha);
+        cmd.spans   = spans;
+        Set(cmd, x, 0, count, 0);
+        Bounds(cmd, left, top, right, bottom);
+        return cmd;
+    }
+
+    /**
+     * @brief Appends a command, copying text for strings. Returns false and
+     * drops it when the list is full.
+     */
+    bool Add(const Command& cmd, const char* text = nullptr)
+    {
+        if(cmd.op == Op::FillRect && cmd.alpha == 255)
+        {
+            DropHiddenBy(cmd);
+        }
+
+        size_t size = text ? strlen(text) + 1 : 0;
+        if(count_ == max_commands || text_used_ + size > max_text)
+        {
+            dropped_++;
+            return false;
+        }
+
+        commands_[count_] = cmd;
+        if(text)
+        {
+            memcpy(&text_[text_used_], text, size);
+            commands_[count_].text = text_used_;
+            text_used_ += size;
+        }
+        count_++;
+        return true;
+    }
+
+    uint16_t Count() const { return count_; }
+
+    const Command& operator[](uint16_t i) const { return commands_[i]; }
+
+    const char* Text(const Command& cmd) const { return &text_[cmd.text]; }
+
+    // Commands lost because the list was full
+    uint32_t Dropped() const { return dropped_; }
+
+  private:
+    static Command Make(Op op, uint8_t color, uint8_t alpha)
+    {
+        Command cmd{};
+        cmd.op    = op;
+        cmd.color = color;
+        cmd.alpha = alpha;
+        return cmd;
+    }
+
+    static void
+    Set(Command& cmd, int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+    {
+        cmd.x0 = x0;
+        cmd.y0 = y0;
+        cmd.x1 = x1;
+        cmd.y1 = y1;
+    }
+
+    // Saturates to 16 bits, as coordinates are unsigned in some of the
+    // drawing calls and signed in others.
+    static void Bounds(Command& cmd,
+                       int32_t  left,
+                       int32_t  top,
+                       int32_t  right,
+                       int32_t  bottom)
+    {
+        cmd.left   = std::clamp<int32_t>(left, INT16_MIN, INT16_MAX);
+        cmd.top    = std::clamp<int32_t>(top, INT16_MIN, INT16_MAX);
+        cmd.right  = std::clamp<int32_t>(right, INT16_MIN, INT16_MAX);
+        cmd.bottom = std::clamp<int32_t>(bottom, INT16_MIN, INT16_MAX);
+    }
+
+    void DropHiddenBy(const Command& fill)
+    {
+        uint16_t count = 0;
+        uint16_t used  = 0;
+        for(uint16_t i = 0; i < count_; i++)
+        {
+            auto cmd = commands_[i];
+            if(fill.Covers(cmd))
+            {
+                continue;
+            }
+            if(cmd.op == Op::String)
+            {
+                // Strings stay in order, so they only ever move down
+                size_t size = strlen(&text_[cmd.text]) + 1;
+                memmove(&text_[used], &text_[cmd.text], size);
+                cmd.text = used;
+                used += size;
+            }
+            commands_[count++] = cmd;
+        }
+        count_     = count;
+        text_used_ = used;
+    }
+
+    Command  commands_[max_commands];
+    char     text_[max_text];
+    uint16_t count_     = 0;
+    uint16_t text_used_ = 0;
+    uint32_t dropped_   = 0;
+};
@@ -1,4 +1,7 @@
 #include "dma2d.hpp"
+#include "dma2d_queue.hpp"
+#include "frame_profiler.hpp"
+#include "ili9341_pixel.hpp"
 #include "stm32h7xx_hal.h"
 
 #define DMA2D_POSITION_NLR_PL \
@@ -6,23 +9,21 @@
         DMA2D_NLR_PL) /*!< Required left shift to set pixels per lines value */
 
 #define DMA2D_POSITION_FGPFCCR_AI (uint32_t) POSITION_VAL(DMA2D_FGPFCCR_AI)
-
-#define IS_DMA2D_READY() (hdma2d.Instance->CR & DMA2D_CR_START) == 0
-#define START_DMA2D() hdma2d.Instance->CR |= DMA2D_CR_START
-
-static const uint32_t         color_mem_size = 320 * 240;
-static uint32_t DSY_SDRAM_BSS color_mem[color_mem_size];
+#define DMA2D_POSITION_FGPFCCR_AM (uint32_t) POSITION_VAL(DMA2D_FGPFCCR_AM)
+#define DMA2D_POSITION_FGPFCCR_ALPHA \
+    (uint32_t) POSITION_VAL(DMA2D_FGPFCCR_ALPHA)
+#define DMA2D_POSITION_BGPFCCR_AM (uint32_t) POSITION_VAL(DMA2D_BGPFCCR_AM)
 
 static void CpltCallback(DMA2D_HandleTypeDef* hdma2d)
 {
     if(hdma2d->ErrorCode != HAL_DMA2D_ERROR_NONE)
     {
-        __asm__("BKPT");
+        ILI9341_BREAKPOINT();
     }
 }
 static void ErrorCallback(DMA2D_HandleTypeDef* hdma2d)
 {
-    __asm__("BKPT");
+    ILI9341_BREAKPOINT();
 }
 
 class Dma2DHandle::Impl
@@ -30,8 +31,6 @@ class Dma2DHandle::Impl
   public:
     void Init(uint8_t* buffer_)
     {
-        memset(color_mem, 0, color_mem_size);
-
         buffer = buffer_;
 
         // hdma2d.Instance           = DMA2D;
@@ -41,7 +40,14 @@ class Dma2DHandle::Impl
         // hdma2d.Init.AlphaInverted = DMA2D_REGULAR_ALPHA;
         // hdma2d.State = HAL_DMA2D_STATE_RESET;
         InitDma2D();
+        LoadShadow();
+
+        // Queued commands are chained from the transfer complete interrupt
+        HAL_NVIC_SetPriority(DMA2D_IRQn, ILI9341_DMA2D_IRQ_PRIORITY, 0);
+        HAL_NVIC_EnableIRQ(DMA2D_IRQn);
     }
+    void SetBuffer(uint8_t* buffer_) { buffer = buffer_; }
+
     void InitDma2D()
     {
         hdma2d.Instance       = DMA2D;
@@ -74,299 +80,306 @@ class Dma2DHandle::Impl
         hdma2d.XferErrorCallback             = ErrorCallback;
         if(HAL_DMA2D_Init(&hdma2d) != HAL_OK)
         {
-            __asm__("BKPT");
+            ILI9341_BREAKPOINT();
         }
         if(HAL_DMA2D_ConfigLayer(&hdma2d, 0) != HAL_OK)
         {
-            __asm__("BKPT");
+            ILI9341_BREAKPOINT();
         }
         if(HAL_DMA2D_ConfigLayer(&hdma2d, 1) != HAL_OK)
         {
-            __asm__("BKPT");
+            ILI9341_BREAKPOINT();
         }
     }
 
-    void FillRect(const Rectangle& rect, uint16_t color)
+    // M2M with pixel format conversion, or blending when the image has alpha
+    void DrawImage(const uint8_t*   src,
+                   uint32_t         color_mode,
+                   uint16_t         pitch,
+                   const Rectangle& rect,
+                   uint8_t          alpha)
     {
-        while(!IS_DMA2D_READY()) {}
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
-        auto offset = (rect.GetX() + rect.GetY() * screen_width)
-                      * 2; // 2 bytes per pixel
-
-        hdma2d.Init.Mode      = DMA2D_R2M;
-        hdma2d.Init.ColorMode = DMA2D_OUTPUT_RGB565;
-        // hdma2d.Init.AlphaInverted = DMA2D_INVERTED_ALPHA;
-        hdma2d.Init.OutputOffset = screen_width - rect.GetWidth();
-
-        _init2d();
-        auto result = HAL_DMA2D_Start(&hdma2d,
-                                      //   color,
-                                      __builtin_bswap16(color),
-                                      (uint32_t)(buffer + offset),
-                                      rect.GetWidth(),
-                                      rect.GetHeight());
-
-        if(result != HAL_OK)
+        auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
+        bool opaque = alpha == 255
+                      && (color_mode == DMA2D_INPUT_RGB565
+                          || color_mode == DMA2D_INPUT_RGB888);
+
+        Dma2DCommand cmd{};
+        cmd.uses  = Dma2DCommand::USES_FOREGROUND;
+        cmd.fgmar = reinterpret_cast<uintptr_t>(src);
+        cmd.fgor  = pitch - rect.GetWidth();
+        cmd.fgpfccr
+            = color_mode | (DMA2D_COMBINE_ALPHA << DMA2D_POSITION_FGPFCCR_AM)
+              | (alpha << DMA2D_POSITION_FGPFCCR_ALPHA);
+        cmd.omar = reinterpret_cast<uintptr_t>(buffer + offset);
+        cmd.oor  = screen_width - rect.GetWidth();
+        cmd.nlr  = NumberOfLines(rect);
+
+        if(opaque)
         {
-            __asm__("BKPT");
+            // Converted pixels don't depend on the frame buffer, so they
+            // can be written in its byte order whatever it is.
+            cmd.cr     = DMA2D_M2M_PFC;
+            cmd.opfccr = DMA2D_OUTPUT_RGB565 | output_swap;
         }
-
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
+        else
+        {
+            cmd.cr = DMA2D_M2M_BLEND;
+            cmd.uses |= Dma2DCommand::USES_BACKGROUND;
+            cmd.bgmar   = cmd.omar;
+            cmd.bgor    = cmd.oor;
+            cmd.bgpfccr = DMA2D_INPUT_RGB565;
+            cmd.opfccr  = DMA2D_OUTPUT_RGB565;
+        }
+        Submit(cmd);
     }
 
-    void DMA2D_DrawImage(const Rectangle& rect, uint16_t color, uint8_t alpha)
+    // Blends a solid color through an A8 or A4 mask, e.g. a glyph
+    void DrawMask(const uint8_t*   mask,
+                  uint32_t         color_mode,
+                  uint16_t         pitch,
+                  const Rectangle& rect,
+                  uint16_t         color,
+                  uint8_t          alpha)
     {
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
-
         auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
 
-        hdma2d.Instance           = DMA2D;
-        hdma2d.Init.Mode          = DMA2D_M2M_BLEND;
-        hdma2d.Init.ColorMode     = DMA2D_OUTPUT_RGB565;
-        hdma2d.Init.AlphaInverted = DMA2D_REGULAR_ALPHA;
-        hdma2d.Init.RedBlueSwap   = DMA2D_RB_REGULAR;
-        hdma2d.Init.OutputOffset  = screen_width - rect.GetWidth();
-        // Foreground
-        hdma2d.LayerCfg[1].AlphaMode      = DMA2D_REPLACE_ALPHA;
-        hdma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_RGB565;
-        hdma2d.LayerCfg[1].InputOffset    = 0;
-        hdma2d.LayerCfg[1].InputAlpha     = alpha;
-        hdma2d.LayerCfg[1].RedBlueSwap    = DMA2D_RB_REGULAR;
-        hdma2d.LayerCfg[1].AlphaInverted  = DMA2D_REGULAR_ALPHA;
-
-        // Background
-        hdma2d.LayerCfg[0].InputAlpha     = 255;
-        hdma2d.LayerCfg[0].AlphaMode      = DMA2D_REPLACE_ALPHA;
-        hdma2d.LayerCfg[0].InputColorMode = DMA2D_INPUT_RGB565;
-        hdma2d.LayerCfg[0].InputOffset    = screen_width - rect.GetWidth();
-        hdma2d.LayerCfg[0].RedBlueSwap    = DMA2D_RB_REGULAR;
-        hdma2d.LayerCfg[0].AlphaInverted  = DMA2D_REGULAR_ALPHA;
-        HAL_DMA2D_DeInit(&hdma2d);
-        _init2d();
-
-        HAL_DMA2D_ConfigLayer(&hdma2d, 1);
-        HAL_DMA2D_ConfigLayer(&hdma2d, 0);
-
-        HAL_DMA2D_BlendingStart(&hdma2d,
-                                *color_mem,
-                                // clr,
-                                (uint32_t)(buffer + offset),
-                                (uint32_t)(buffer + offset),
-                                rect.GetWidth(),
-                                rect.GetHeight());
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
+        Dma2DCommand cmd{};
+        cmd.uses = Dma2DCommand::USES_FOREGROUND
+                   | Dma2DCommand::USES_BACKGROUND;
+        cmd.cr    = DMA2D_M2M_BLEND;
+        cmd.fgmar = reinterpret_cast<uintptr_t>(mask);
+        cmd.fgor  = pitch - rect.GetWidth();
+        cmd.fgpfccr
+            = color_mode | (DMA2D_COMBINE_ALPHA << DMA2D_POSITION_FGPFCCR_AM)
+              | (alpha << DMA2D_POSITION_FGPFCCR_ALPHA);
+        // In the frame buffer's byte order, as for WriteChar()
+        cmd.fgcolr  = RGB565toRGB888(FrameBufferPixel(color));
+        cmd.bgmar   = reinterpret_cast<uintptr_t>(buffer + offset);
+        cmd.bgor    = screen_width - rect.GetWidth();
+        cmd.bgpfccr = DMA2D_INPUT_RGB565;
+        cmd.opfccr  = DMA2D_OUTPUT_RGB565;
+        cmd.omar    = cmd.bgmar;
+        cmd.oor     = cmd.bgor;
+        cmd.nlr     = NumberOfLines(rect);
+        Submit(cmd);
     }
 
-    // It works, but the colors are messed up.
     void FillRectReg(const Rectangle& rect, uint16_t color)
     {
-        while(!IS_DMA2D_READY()) {}
+        auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
 
-        InitDma2D();
+        Dma2DCommand cmd{};
+        cmd.uses   = Dma2DCommand::USES_OUTPUT_COLOR;
+        cmd.cr     = DMA2D_R2M;
+        cmd.opfccr = DMA2D_OUTPUT_RGB565;
+        cmd.ocolr  = FrameBufferPixel(color);
+        cmd.omar   = reinterpret_cast<uintptr_t>(buffer + offset);
+        cmd.oor    = screen_width - rect.GetWidth();
+        cmd.nlr    = NumberOfLines(rect);
+        Submit(cmd);
+    }
 
-        while(!IS_DMA2D_READY()) {}
+    void CopyRect(const uint8_t* src, const Rectangle& rect)
+    {
+        auto offset = Offset(rect);
+        auto skip   = screen_width - rect.GetWidth();
+        Copy(src + offset, skip, buffer + offset, skip, rect);
+    }
 
-        MODIFY_REG(hdma2d.Instance->CR, DMA2D_CR_MODE, DMA2D_R2M);
-        WRITE_REG(hdma2d.Instance->OCOLR, __builtin_bswap16(color));
+    void SaveRect(uint8_t* dst, const Rectangle& rect)
+    {
+        auto skip = screen_width - rect.GetWidth();
+        Copy(buffer + Offset(rect), skip, dst, 0, rect);
+    }
 
-        auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
+    void RestoreRect(const uint8_t* src, const Rectangle& rect)
+    {
+        auto skip = screen_width - rect.GetWidth();
+        Copy(src, 0, buffer + Offset(rect), skip, rect);
+    }
 
-        MODIFY_REG(hdma2d.Instance->OOR, DMA2D_OOR_LO, 320 - rect.GetWidth());
-        MODIFY_REG(
-            hdma2d.Instance->NLR,
-            (DMA2D_NLR_NL | DMA2D_NLR_PL),
-            (rect.GetHeight() | (rect.GetWidth() << DMA2D_POSITION_NLR_PL)));
-        WRITE_REG(hdma2d.Instance->OMAR, (uint32_t)(buffer + offset));
-        START_DMA2D();
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
+    // Plain M2M, skipping src_skip and dst_skip pixels after each line
+    void Copy(const uint8_t*   src,
+              uint16_t         src_skip,
+              uint8_t*         dst,
+              uint16_t         dst_skip,
+              const Rectangle& rect)
+    {
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        // Plain M2M only uses the input format for the pixel size
+        auto color_mode = DMA2D_INPUT_L8;
+#else
+        auto color_mode = DMA2D_INPUT_RGB565;
+#endif
+
+        Dma2DCommand cmd{};
+        cmd.uses    = Dma2DCommand::USES_FOREGROUND;
+        cmd.cr      = DMA2D_M2M;
+        cmd.fgmar   = reinterpret_cast<uintptr_t>(src);
+        cmd.fgor    = src_skip;
+        cmd.fgpfccr = color_mode;
+        cmd.opfccr  = DMA2D_OUTPUT_RGB565;
+        cmd.omar    = reinterpret_cast<uintptr_t>(dst);
+        cmd.oor     = dst_skip;
+        cmd.nlr     = NumberOfLines(rect);
+        Submit(cmd);
     }
 
-    void FillRect(const Rectangle& rect, uint16_t color, uint8_t alpha)
+    // Byte offset of the top left corner of rect in the frame buffer
+    uint32_t Offset(const Rectangle& rect) const
     {
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        return rect.GetX() + rect.GetY() * screen_width;
+#else
+        return (rect.GetX() + rect.GetY() * screen_width) * 2;
+#endif
+    }
 
+    void FillRect(const Rectangle& rect, uint16_t color, uint8_t alpha)
+    {
         if(alpha == 255)
         {
-            // return FillRect(rect, color);
             return FillRectReg(rect, color);
         }
-        // return FillRectReg(rect, color);
-
-
         return FillTransparentRect(rect, color, alpha);
     }
 
     void
     FillTransparentRect(const Rectangle& rect, uint16_t color, uint8_t alpha)
     {
-        // ============================ 1 ============================
-        // Fill the buffer with color
-
-        while(!IS_DMA2D_READY()) {}
-
-        InitDma2D();
-
-        while(!IS_DMA2D_READY()) {}
-
-        // MODIFY_REG(hdma2d.Instance->CR, DMA2D_CR_MODE, DMA2D_R2M);
-        // WRITE_REG(hdma2d.Instance->OCOLR, __builtin_bswap16(color));
-
-        // MODIFY_REG(hdma2d.Instance->OOR, DMA2D_OOR_LO, 0);
-        // MODIFY_REG(
-        //     hdma2d.Instance->NLR,
-        //     (DMA2D_NLR_NL | DMA2D_NLR_PL),
-        //     (rect.GetHeight() | (rect.GetWidth() << DMA2D_POSITION_NLR_PL)));
-        // WRITE_REG(hdma2d.Instance->OMAR, (uint32_t)(color_mem));
-        // START_DMA2D();
-        // HAL_DMA2D_PollForTransfer(&hdma2d, 100);
-
-        hdma2d.Init.Mode      = DMA2D_R2M;
-        hdma2d.Init.ColorMode = DMA2D_OUTPUT_RGB565;
-        // hdma2d.Init.AlphaInverted = DMA2D_INVERTED_ALPHA;
-        hdma2d.Init.OutputOffset = screen_width - rect.GetWidth();
-
-        // hdma2d.Init.BytesSwap = DMA2D_BYTES_SWAP;
-        // hdma2d.Init.RedBlueSwap = DMA2D_RB_SWAP;
-
-        _init2d();
-        auto result2 = HAL_DMA2D_Start(&hdma2d,
-                                       color,
-                                       (uint32_t)(color_mem),
-                                       rect.GetWidth(),
-                                       rect.GetHeight());
-
-        if(result2 != HAL_OK)
-        {
-            __asm__("BKPT");
-        }
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
-
-
-        // ============================ 2 ============================
-        // Blend two buffers
-        // TODO: Try with additional intermidiate buffer: RM > M2M_Blend > M2M
-
-        // R2M with blending is directly not supported. However, you can do these steps:
-        // 1. Use R2M mode and fill your rectangle memory outside layers
-        // 2. Perform M2M with blending
-        //      1. For front layer set memory of your rectangle you just filled
-        //      2. For back layer set memory position where you want to put your rectangle
-        //      3. Set front layer alpha for transparency value of whole layer
-
+        // R2M with blending is directly not supported, but M2M blending with a
+        // fixed color foreground is: the foreground is never read from memory
+        // and only the rectangle of the frame buffer goes through the DMA2D.
+        // The frame buffer must hold native pixels (ILI9341_SPI_16BIT).
         auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
 
-        hdma2d.Instance           = DMA2D;
-        hdma2d.Init.Mode          = DMA2D_M2M_BLEND;
-        hdma2d.Init.ColorMode     = DMA2D_OUTPUT_RGB565;
-        hdma2d.Init.AlphaInverted = DMA2D_INVERTED_ALPHA;
-        hdma2d.Init.RedBlueSwap   = DMA2D_RB_REGULAR;
-        hdma2d.Init.OutputOffset  = screen_width - rect.GetWidth();
+        Dma2DCommand blend{};
+        blend.uses = Dma2DCommand::USES_FOREGROUND
+                     | Dma2DCommand::USES_BACKGROUND;
+        blend.cr = DMA2D_M2M_BLEND_FG;
         // Foreground
-        hdma2d.LayerCfg[1].AlphaMode      = DMA2D_REPLACE_ALPHA;
-        hdma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_RGB565;
-        hdma2d.LayerCfg[1].InputOffset    = 0;
-        hdma2d.LayerCfg[1].InputAlpha     = alpha;
-        hdma2d.LayerCfg[1].RedBlueSwap    = DMA2D_RB_REGULAR;
-        hdma2d.LayerCfg[1].AlphaInverted  = DMA2D_REGULAR_ALPHA;
-
+        blend.fgpfccr = DMA2D_INPUT_ARGB8888
+                        | (DMA2D_REPLACE_ALPHA << DMA2D_POSITION_FGPFCCR_AM)
+                        | (alpha << DMA2D_POSITION_FGPFCCR_ALPHA);
+        blend.fgcolr = RGB565toRGB888(color);
         // Background
-        hdma2d.LayerCfg[0].AlphaMode      = DMA2D_NO_MODIF_ALPHA;
-        hdma2d.LayerCfg[0].InputColorMode = DMA2D_INPUT_RGB565;
-        hdma2d.LayerCfg[0].InputOffset    = screen_width - rect.GetWidth();
-        hdma2d.LayerCfg[0].RedBlueSwap    = DMA2D_RB_REGULAR;
-        hdma2d.LayerCfg[0].AlphaInverted  = DMA2D_REGULAR_ALPHA;
-        _init2d();
+        blend.bgmar   = reinterpret_cast<uintptr_t>(buffer + offset);
+        blend.bgor    = screen_width - rect.GetWidth();
+        blend.bgpfccr = DMA2D_INPUT_RGB565
+                        | (DMA2D_NO_MODIF_ALPHA << DMA2D_POSITION_BGPFCCR_AM);
+
+        blend.opfccr = DMA2D_OUTPUT_RGB565;
+        blend.omar   = reinterpret_cast<uintptr_t>(buffer + offset);
+        blend.oor    = screen_width - rect.GetWidth();
+        blend.nlr    = NumberOfLines(rect);
+        Submit(blend);
+    }
 
-        auto result = HAL_DMA2D_BlendingStart(&hdma2d,
-                                              *color_mem,
-                                              (uint32_t)(buffer + offset),
-                                              (uint32_t)(buffer + offset),
-                                              rect.GetWidth(),
-                                              rect.GetHeight());
+    /**
+     * @brief Queues a command, starting it right away if the DMA2D is idle.
+     * Only blocks when the queue is full.
+     */
+    void Submit(const Dma2DCommand& cmd)
+    {
+        while(queue.IsFull()) {}
+        queue.Push(cmd);
 
-        if(result != HAL_OK)
+        // Either the interrupt is still to come and picks up the new command,
+        // or the DMA2D is idle and nothing can race us.
+        if(!busy)
         {
-            __asm__("BKPT");
+            busy = true;
+#ifdef ILI9341_PROFILER
+            busy_start_ = CycleCounter::Now();
+#endif
+            Execute(queue.Front());
         }
-
-        HAL_DMA2D_PollForTransfer(&hdma2d, 100);
     }
 
-    void WriteChar(uint16_t x,
-                   uint16_t y,
-                   char     ch,
-                   UIFont   font,
-                   uint16_t color) const
+    // Fence: waits until every queued command has been executed
+    void Flush()
     {
-        while(!IS_DMA2D_READY()) {}
-
-        MODIFY_REG(hdma2d.Instance->FGPFCCR,
-                   (DMA2D_FGPFCCR_CM | DMA2D_FGPFCCR_AI),
-                   (DMA2D_INPUT_A4
-                    | (1 << DMA2D_POSITION_FGPFCCR_AI))); // A4 + alpha inverted
-
-        WRITE_REG(hdma2d.Instance->FGCOLR,
-                  (((((color & 0xF800) >> 11) * 255 / 31) << 16)
-                   | ((((color & 0x07e0) >> 5) * 255 / 63) << 8)
-                   | (((color & 0x001f)) * 255 / 31)));
-
-        WRITE_REG(hdma2d.Instance->BGCOLR, 0x0000);
-        MODIFY_REG(hdma2d.Instance->CR, DMA2D_CR_MODE, DMA2D_M2M_BLEND);
-
-
-        uint32_t offset = y * 240 + x;
-        // auto offset = (x + y * screen_width) * 2;
-
-        auto mod = screen_width;
-        offset -= mod * font.FontHeight;
-
-        MODIFY_REG(hdma2d.Instance->OOR, DMA2D_OOR_LO, mod - font.FontWidth);
-        MODIFY_REG(hdma2d.Instance->BGOR, DMA2D_OOR_LO, mod - font.FontWidth);
-        MODIFY_REG(
-            hdma2d.Instance->NLR,
-            (DMA2D_NLR_NL | DMA2D_NLR_PL),
-            (font.FontHeight | (font.FontWidth << DMA2D_POSITION_NLR_PL)));
-        WRITE_REG(hdma2d.Instance->FGMAR,
-                  (uint32_t)(font.data[(ch - 32) * font.FontHeight]));
-
-        // WRITE_REG(hdma2d.Instance->BGMAR, (uint32_t)(buffer + offset));
-        WRITE_REG(hdma2d.Instance->OMAR, (uint32_t)(buffer + offset));
-        START_DMA2D();
-
-        // HAL_DMA2D_PollForTransfer(&hdma2d, 100);
+#ifdef ILI9341_PROFILER
+        if(busy)
+        {
+            auto start = CycleCounter::Now();
+            while(busy) {}
+            wait_ticks_ += CycleCounter::Now() - start;
+        }
+#else
+        while(busy) {}
+#endif
     }
 
-    uint32_t RGB565toARGB8888(uint16_t rgb565Color, uint8_t alpha)
+#ifdef ILI9341_PROFILER
+    // Only called while the DMA2D is idle, so the interrupt can't interfere
+    void TakeTimes(uint32_t& busy_ticks, uint32_t& wait_ticks)
     {
-        // Extract the RGB components from RGB565
-        uint8_t r5 = (rgb565Color >> 11) & 0x1F;
-        uint8_t g6 = (rgb565Color >> 5) & 0x3F;
-        uint8_t b5 = rgb565Color & 0x1F;
+        busy_ticks  = busy_ticks_;
+        wait_ticks  = wait_ticks_;
+        busy_ticks_ = 0;
+        wait_ticks_ = 0;
+    }
+#endif
 
-        // Scale and expand the RGB components to 8 bits
-        uint8_t r8 = (r5 << 3) | (r5 >> 2); // 5-bit to 8-bit
-        uint8_t g8 = (g6 << 2) | (g6 >> 4); // 6-bit to 8-bit
-        uint8_t b8 = (b5 << 3) | (b5 >> 2); // 5-bit to 8-bit
+    bool IsIdle() const { return !busy; }
 
-        // Compose the ARGB8888 color with the specified alpha value
-        uint32_t argb8888Color = (static_cast<uint32_t>(alpha) << 24)
-                                 | (r8 << 16) | (g8 << 8) | b8;
+    void OnInterrupt()
+    {
+        auto flags = READ_REG(hdma2d.Instance->ISR);
+        WRITE_REG(hdma2d.Instance->IFCR, flags);
+        if(flags & (DMA2D_ISR_TEIF | DMA2D_ISR_CEIF))
+        {
+            ILI9341_BREAKPOINT();
+        }
+        if(!(flags & DMA2D_ISR_TCIF))
+        {
+            return;
+        }
 
-        return argb8888Color;
+        queue.Pop();
+        if(queue.IsEmpty())
+        {
+#ifdef ILI9341_PROFILER
+            busy_ticks_ += CycleCounter::Now() - busy_start_;
+#endif
+            busy = false;
+            return;
+        }
+        Execute(queue.Front());
     }
 
-    uint32_t RGB888toARGB8888(uint8_t r, uint8_t g, uint8_t b, uint8_t alpha)
+    // Blends an A4 glyph from the glyph atlas in a solid color
+    void WriteChar(const uint8_t*   glyph,
+                   uint16_t         pitch,
+                   const Rectangle& rect,
+                   uint16_t         color)
     {
-        // Compose the ARGB8888 color with the specified alpha value
-        uint32_t argb8888Color = (static_cast<uint32_t>(alpha) << 24)
-                                 | (static_cast<uint32_t>(r) << 16)
-                                 | (static_cast<uint32_t>(g) << 8) | b;
+        auto offset = (rect.GetX() + rect.GetY() * screen_width) * 2;
 
-        return argb8888Color;
+        Dma2DCommand cmd{};
+        cmd.uses = Dma2DCommand::USES_FOREGROUND
+                   | Dma2DCommand::USES_BACKGROUND;
+        cmd.cr      = DMA2D_M2M_BLEND;
+        cmd.fgmar   = reinterpret_cast<uintptr_t>(glyph);
+        cmd.fgor    = pitch - rect.GetWidth();
+        cmd.fgpfccr = DMA2D_INPUT_A4;
+        // Glyph pixels are either fully set or untouched, so the color can be
+        // given in the frame buffer's byte order and the result matches the
+        // rest of the buffer.
+        cmd.fgcolr  = RGB565toRGB888(FrameBufferPixel(color));
+        cmd.bgmar   = reinterpret_cast<uintptr_t>(buffer + offset);
+        cmd.bgor    = screen_width - rect.GetWidth();
+        cmd.bgpfccr = DMA2D_INPUT_RGB565;
+        cmd.opfccr  = DMA2D_OUTPUT_RGB565;
+        cmd.omar    = cmd.bgmar;
+        cmd.oor     = cmd.bgor;
+        cmd.nlr     = NumberOfLines(rect);
+        Submit(cmd);
     }
 
-
-    uint32_t RGB565toRGB888(uint16_t rgb565Color)
+    static uint32_t RGB565toRGB888(uint16_t rgb565Color)
     {
         // Extract the RGB components from RGB565
         uint8_t r5 = (rgb565Color >> 11) & 0x1F;
@@ -387,6 +400,88 @@ class Dma2DHandle::Impl
     }
 
   private:
+#ifdef ILI9341_SPI_16BIT
+    static constexpr uint32_t output_swap = 0;
+#else
+    // Swaps the bytes of each output pixel, for the big endian frame buffer
+    static constexpr uint32_t output_swap = DMA2D_OPFCCR_SB;
+#endif
+
+    uint32_t NumberOfLines(const Rectangle& rect) const
+    {
+        return rect.GetHeight() | (rect.GetWidth() << DMA2D_POSITION_NLR_PL);
+    }
+
+    // The DMA2D keeps its registers between transfers, so only the ones that
+    // differ from the previous operation need writing.
+    void Execute(const Dma2DCommand& cmd)
+    {
+        auto regs = hdma2d.Instance;
+        if(cmd.uses & Dma2DCommand::USES_FOREGROUND)
+        {
+            Write(regs->FGMAR, shadow.fgmar, cmd.fgmar);
+            Write(regs->FGOR, shadow.fgor, cmd.fgor);
+            Write(regs->FGPFCCR, shadow.fgpfccr, cmd.fgpfccr);
+            Write(regs->FGCOLR, shadow.fgcolr, cmd.fgcolr);
+        }
+        if(cmd.uses & Dma2DCommand::USES_BACKGROUND)
+        {
+            Write(regs->BGMAR, shadow.bgmar, cmd.bgmar);
+            Write(regs->BGOR, shadow.bgor, cmd.bgor);
+            Write(regs->BGPFCCR, shadow.bgpfccr, cmd.bgpfccr);
+            Write(regs->BGCOLR, shadow.bgcolr, cmd.bgcolr);
+        }
+        if(cmd.uses & Dma2DCommand::USES_OUTPUT_COLOR)
+        {
+            Write(regs->OCOLR, shadow.ocolr, cmd.ocolr);
+        }
+        Write(regs->OPFCCR, shadow.opfccr, cmd.opfccr);
+        Write(regs->OMAR, shadow.omar, cmd.omar);
+        Write(regs->OOR, shadow.oor, cmd.oor);
+        Write(regs->NLR, shadow.nlr, cmd.nlr);
+        WRITE_REG(regs->CR,
+                  cmd.cr | DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE
+                      | DMA2D_CR_START);
+    }
+
+    template <typename Reg, typename Value>
+    static void Write(volatile Reg& reg, Value& cached, Value value)
+    {
+        if(cached != value)
+        {
+            WRITE_REG(reg, value);
+            cached = value;
+        }
+    }
+
+    // Picks up whatever HAL_DMA2D_Init() left in the registers
+    void LoadShadow()
+    {
+        auto regs      = hdma2d.Instance;
+        shadow.fgmar   = READ_REG(regs->FGMAR);
+        shadow.fgor    = READ_REG(regs->FGOR);
+        shadow.fgpfccr = READ_REG(regs->FGPFCCR);
+        shadow.fgcolr  = READ_REG(regs->FGCOLR);
+        shadow.bgmar   = READ_REG(regs->BGMAR);
+        shadow.bgor    = READ_REG(regs->BGOR);
+        shadow.bgpfccr = READ_REG(regs->BGPFCCR);
+        shadow.bgcolr  = READ_REG(regs->BGCOLR);
+        shadow.opfccr  = READ_REG(regs->OPFCCR);
+        shadow.ocolr   = READ_REG(regs->OCOLR);
+        shadow.omar    = READ_REG(regs->OMAR);
+        shadow.oor     = READ_REG(regs->OOR);
+        shadow.nlr     = READ_REG(regs->NLR);
+    }
+
+    Dma2DCommand  shadow{};
+    Dma2DQueue    queue;
+    volatile bool busy = false;
+#ifdef ILI9341_PROFILER
+    uint32_t busy_start_ = 0;
+    uint32_t busy_ticks_ = 0;
+    uint32_t wait_ticks_ = 0;
+#endif
+
     uint16_t            screen_width  = 320;
     uint16_t            screen_height = 240;
     DMA2D_HandleTypeDef hdma2d{};
@@ -402,6 +497,79 @@ void Dma2DHandle::Init(uint8_t* buffer_)
     impl->Init(buffer_);
 }
 
+void Dma2DHandle::SetBuffer(uint8_t* buffer_)
+{
+    impl->SetBuffer(buffer_);
+}
+
+void Dma2DHandle::CopyRect(const uint8_t* src, const Rectangle& rect)
+{
+    impl->CopyRect(src, rect);
+}
+
+void Dma2DHandle::SaveRect(uint8_t* dst, const Rectangle& rect)
+{
+    impl->SaveRect(dst, rect);
+}
+
+void Dma2DHandle::RestoreRect(const uint8_t* src, const Rectangle& rect)
+{
+    impl->RestoreRect(src, rect);
+}
+
+void Dma2DHandle::Flush()
+{
+    impl->Flush();
+}
+
+bool Dma2DHandle::IsIdle() const
+{
+    return impl->IsIdle();
+}
+
+#ifdef ILI9341_PROFILER
+void Dma2DHandle::TakeTimes(uint32_t& busy_ticks, uint32_t& wait_ticks)
+{
+    impl->Flush();
+    impl->TakeTimes(busy_ticks, wait_ticks);
+}
+#endif
+
+static uint32_t ColorMode(Dma2DHandle::PixelFormat format)
+{
+    switch(format)
+    {
+        case Dma2DHandle::PixelFormat::ARGB8888: return DMA2D_INPUT_ARGB8888;
+        case Dma2DHandle::PixelFormat::RGB888: return DMA2D_INPUT_RGB888;
+        case Dma2DHandle::PixelFormat::RGB565: return DMA2D_INPUT_RGB565;
+        case Dma2DHandle::PixelFormat::ARGB1555: return DMA2D_INPUT_ARGB1555;
+        case Dma2DHandle::PixelFormat::ARGB4444: return DMA2D_INPUT_ARGB4444;
+        case Dma2DHandle::PixelFormat::A8: return DMA2D_INPUT_A8;
+        case Dma2DHandle::PixelFormat::A4: return DMA2D_INPUT_A4;
+    }
+    return DMA2D_INPUT_RGB565;
+}
+
+void Dma2DHandle::DrawImage(const uint8_t*   src,
+                            PixelFormat      format,
+                            uint16_t         pitch,
+                            const Rectangle& rect,
+                            uint8_t          alpha)
+{
+    impl->DrawImage(src, ColorMode(format), pitch, rect, alpha);
+}
+
+void Dma2DHandle::DrawMask(const uint8_t*   mask,
+                           PixelFormat      format,
+                           uint16_t         pitch,
+                           const Rectangle& rect,
+                           uint8_t          color_id,
+                           uint8_t          alpha)
+{
+    auto color = tftPalette[color_id];
+    impl->DrawMask(mask, ColorMode(format), pitch, rect, color, alpha);
+}
+
 void Dma2DHandle::FillRect(const Rectangle& rect,
                            uint8_t          color_id,
                            uint8_t          alpha)
@@ -410,15 +578,18 @@ void Dma2DHandle::FillRect(const Rectangle& rect,
     impl->FillRect(rect, color, alpha);
 }
 
-void Dma2DHandle::WriteChar(uint16_t x,
-                            uint16_t y,
-                            char     ch,
-                            UiFont   font,
-                            uint8_t  color_id)
+void Dma2DHandle::WriteChar(const uint8_t*   glyph,
+                            uint16_t         pitch,
+                            const Rectangle& rect,
+                            uint8_t          color_id)
 {
     auto color = tftPalette[color_id];
+    impl->WriteChar(glyph, pitch, rect, color);
+}
 
-    impl->WriteChar(x, y, ch, font, color);
+extern "C" void DMA2D_IRQHandler(void)
+{
+    hdma2d_handle.OnInterrupt();
 }
 
 void HAL_DMA2D_MspInit(DMA2D_HandleTypeDef* hdma2d)
@@ -1,6 +1,12 @@
 #pragma once
 #include "ui/ui_driver.hpp"
 
+// NVIC priority of the interrupt chaining queued DMA2D commands. The lowest
+// by default, so it never preempts the audio callback's DMA interrupts.
+#ifndef ILI9341_DMA2D_IRQ_PRIORITY
+#define ILI9341_DMA2D_IRQ_PRIORITY 15
+#endif
+
 #define COLOR565(r, g, b)                                  \
     ((uint16_t(r & 0xF8) << 8) | (uint16_t(g & 0xFC) << 3) \
      | (uint16_t(b & 0xF8) >> 3))
@@ -9,9 +15,63 @@ class Dma2DHandle
 {
   public:
     void Init(uint8_t* buffer_);
+    void SetBuffer(uint8_t* buffer_);
     void FillRect(const Rectangle& rect, uint8_t color, uint8_t alpha = 255);
 
-    void WriteChar(uint16_t x, uint16_t y, char ch, UIFont font, uint8_t color);
+    // Copies rect from src, laid out like the frame buffer, to the same place
+    void CopyRect(const uint8_t* src, const Rectangle& rect);
+
+    // Copies rect of the frame buffer to dst, rect.GetWidth() pixels per
+    // line, and back
+    void SaveRect(uint8_t* dst, const Rectangle& rect);
+    void RestoreRect(const uint8_t* src, const Rectangle& rect);
+
+    enum class PixelFormat
+    {
+        ARGB8888,
+        RGB888,
+        RGB565,
+        ARGB1555,
+        ARGB4444,
+        A8,
+        A4,
+    };
+
+    // Converts an image of pitch pixels per line to the frame buffer format,
+    // blending it when it has alpha or alpha is below 255.
+    void DrawImage(const uint8_t*   src,
+                   PixelFormat      format,
+                   uint16_t         pitch,
+                   const Rectangle& rect,
+                   uint8_t          alpha = 255);
+
+    // Blends a solid color through an A8 or A4 mask, e.g. a glyph. Without
+    // ILI9341_SPI_16BIT the frame buffer is byte swapped, which the DMA2D
+    // can't blend, so only masks of fully set or clear pixels at alpha 255
+    // come out right, as for WriteChar().
+    void DrawMask(const uint8_t*   mask,
+                  PixelFormat      format,
+                  uint16_t         pitch,
+                  const Rectangle& rect,
+                  uint8_t          color,
+                  uint8_t          alpha = 255);
+
+    // Operations are queued and run in order by the DMA2D interrupt. Flush()
+    // waits for all of them, before touching the frame buffer from the CPU.
+    void Flush();
+    bool IsIdle() const;
+
+#ifdef ILI9341_PROFILER
+    // Time the DMA2D was busy and time spent waiting for it in Flush() since
+    // the last call, in CycleCounter ticks. Flushes first.
+    void TakeTimes(uint32_t& busy_ticks, uint32_t& wait_ticks);
+#endif
+
+    // Draws an A4 glyph of pitch pixels per row, see GlyphAtlas
+    void WriteChar(const uint8_t*   glyph,
+                   uint16_t         pitch,
+                   const Rectangle& rect,
+                   uint8_t          color);
 
     uint16_t tftPalette[NUMBER_OF_TFT_COLORS];
 
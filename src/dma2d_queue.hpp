@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Register image of a single DMA2D operation, written to the peripheral when
+ * the operation reaches the head of the queue. Only the register groups the
+ * operation uses are looked at, and of those only the ones that changed since
+ * the previous operation are written.
+ */
+struct Dma2DCommand
+{
+    enum Uses : uint8_t
+    {
+        USES_FOREGROUND   = 1 << 0, // fgmar, fgor, fgpfccr, fgcolr
+        USES_BACKGROUND   = 1 << 1, // bgmar, bgor, bgpfccr, bgcolr
+        USES_OUTPUT_COLOR = 1 << 2, // ocolr
+    };
+
+    uint8_t  uses; // output registers are always used
+    uint32_t cr;
+    // Addresses are 32 bits on the target, but kept whole so the same images
+    // work with the host DMA2D
+    uintptr_t fgmar, bgmar, omar;
+    uint32_t  fgor, fgpfccr, fgcolr;
+    uint32_t  bgor, bgpfccr, bgcolr;
+    uint32_t  opfccr, ocolr, oor;
+    uint32_t  nlr;
+};
+
+/**
+ * Fixed size ring of pending DMA2D commands.
+ *
+ * Drawing code pushes, the DMA2D transfer complete interrupt pops once the
+ * command at the front is done, so each side only ever writes its own index.
+ */
+class Dma2DQueue
+{
+  public:
+    static constexpr uint8_t size = 32;
+
+    bool IsEmpty() const { return head_ == tail_; }
+
+    bool IsFull() const { return Next(head_) == tail_; }
+
+    // The caller makes sure the queue isn't full
+    void Push(const Dma2DCommand& cmd)
+    {
+        commands_[head_] = cmd;
+        // The command must be in place before the interrupt can see it
+        std::atomic_signal_fence(std::memory_order_release);
+        head_ = Next(head_);
+    }
+
+    const Dma2DCommand& Front() const { return commands_[tail_]; }
+
+    void Pop() { tail_ = Next(tail_); }
+
+  private:
+    static uint8_t Next(uint8_t i) { return (i + 1) % size; }
+
+    Dma2DCommand     commands_[size];
+    volatile uint8_t head_ = 0;
+    volatile uint8_t tail_ = 0;
+};
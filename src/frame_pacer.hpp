@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Decides when the next frame may go out, so it doesn't cross the panel's
+ * refresh and doesn't keep the SPI bus busy faster than asked for.
+ *
+ * The panel refreshes its 320 scan lines, the screen columns in the driver's
+ * landscape orientation, from left to right. A transfer tears where the
+ * refresh passes the area being written, so frames are started right after
+ * the refresh begun a new pass, found one of three ways:
+ * - TearingPin: the panel's TE output, high during vertical blanking
+ * - Scanline: reading the line being refreshed (GET_SCANLINE), which needs
+ *   the panel's SDO wired to MISO and reads with the SPI slowed down
+ * - Timer: no feedback, frames just start a whole number of refresh periods
+ *   apart so a tear stays put instead of crawling over the screen
+ */
+class FramePacer
+{
+  public:
+    enum class Sync
+    {
+        None,
+        TearingPin,
+        Scanline,
+        Timer,
+    };
+
+    // 79 Hz, from the frame rate control (0xB1) sent in InitDriver()
+    static constexpr uint32_t refresh_us = 12658;
+    // Scan lines after the start of a pass that still count as in sync
+    static constexpr uint16_t scanline_window = 16;
+
+    void SetSync(Sync sync) { sync_ = sync; }
+
+    Sync GetSync() const { return sync_; }
+
+    /**
+     * @brief At most fps frames per second, 0 for as many as the bus takes.
+     */
+    void SetFpsCap(uint16_t fps) { min_period_us_ = fps ? 1000000 / fps : 0; }
+
+    /**
+     * @brief True if a frame may start at now_us. in_sync() tells whether
+     * the refresh is where a transfer should start, it is only asked for
+     * Sync::TearingPin and Sync::Scanline once the fps cap allows a frame.
+     */
+    template <typename InSync>
+    bool Ready(uint32_t now_us, InSync in_sync) const
+    {
+        auto elapsed = now_us - last_us_;
+        if(started_ && elapsed < min_period_us_)
+        {
+            return false;
+        }
+        switch(sync_)
+        {
+            case Sync::TearingPin:
+            case Sync::Scanline: return in_sync();
+            case Sync::Timer:
+                return !started_ || elapsed >= TimerPeriod();
+            default: return true;
+        }
+    }
+
+    // A frame went out at now_us
+    void FrameStarted(uint32_t now_us)
+    {
+        // Keeps the timer on the refresh grid rather than drifting with
+        // every late poll
+        if(sync_ == Sync::Timer && started_)
+        {
+            auto period = TimerPeriod();
+            last_us_ += (now_us - last_us_) / period * period;
+        }
+        else
+        {
+            last_us_ = now_us;
+        }
+        started_ = true;
+    }
+
+  private:
+    // Whole refresh periods covering the fps cap
+    uint32_t TimerPeriod() const
+    {
+        auto periods = (min_period_us_ + refresh_us - 1) / refresh_us;
+        return (periods ? periods : 1) * refresh_us;
+    }
+
+    Sync     sync_          = Sync::None;
+    uint32_t min_period_us_ = 0;
+    uint32_t last_us_       = 0;
+    bool     started_       = false;
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#ifdef ILI9341_PROFILER
+#if defined(__arm__)
+#include "stm32h7xx_hal.h"
+#else
+#include <chrono>
+#endif
+#endif
+
+// Frames kept for the profiler statistics, see FrameProfiler
+#ifndef ILI9341_PROFILER_FRAMES
+#define ILI9341_PROFILER_FRAMES 64
+#endif
+
+/**
+ * What FrameProfiler measures per frame. Times are kept in CycleCounter ticks
+ * and reported in microseconds, the rest are plain counts.
+ */
+enum class ProfileMetric : uint8_t
+{
+    // Time spent in each kind of drawing call
+    Line,
+    Rect,
+    FillRect,
+    Triangle,
+    FillTriangle,
+    Polygon,
+    Circle,
+    FillCircle,
+    Text,
+    Image,
+    Columns,
+    Draw,      // all of the above
+    Dma2DWait, // CPU waiting for queued DMA2D work, part of Draw
+    Dma2DBusy, // DMA2D transferring
+    Spi,       // SPI DMA sending the frame
+    SpiGap,    // SPI idle between the DMA transfers of a frame, part of Spi
+    Idle,      // IsRender() saying no
+    Chunks,    // DMA transfers the frame was sent in
+    Bytes,     // bytes sent
+    Period,    // from one Update() to the next
+    Count
+};
+
+#ifdef ILI9341_PROFILER
+/**
+ * Free running timer for the profiler: the core's DWT cycle counter on the
+ * target, the steady clock in nanoseconds on the host. Differences are right
+ * across a wrap, which takes about 9 s at 480 MHz.
+ */
+class CycleCounter
+{
+  public:
+#if defined(__arm__)
+    static void Init()
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->LAR = 0xC5ACCE55; // unlocks the DWT on the Cortex-M7
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    static uint32_t Now() { return DWT->CYCCNT; }
+
+    static uint32_t TicksPerUs() { return SystemCoreClock / 1000000; }
+#else
+    static void Init() {}
+
+    static uint32_t Now()
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now)
+            .count();
+    }
+
+    static uint32_t TicksPerUs() { return 1000; }
+#endif
+};
+
+/**
+ * Per frame timings and transfer counts in a ring of the last
+ * ILI9341_PROFILER_FRAMES frames, with min/avg/max/p99 over them.
+ *
+ * A frame runs from one Update() to the next, so the SPI figures in it are
+ * those of the transfer the previous Update() started.
+ */
+class FrameProfiler
+{
+  public:
+    static constexpr uint16_t max_frames = ILI9341_PROFILER_FRAMES;
+    static constexpr uint8_t  num_metrics
+        = static_cast<uint8_t>(ProfileMetric::Count);
+
+    struct Summary
+    {
+        uint32_t min, avg, max, p99;
+    };
+
+    // What a slow screen is waiting on
+    enum class Bound
+    {
+        Cpu,
+        Dma2D,
+        Spi,
+    };
+
+    /**
+     * Times the outermost drawing call it is created in, so shapes built from
+     * other shapes count once, as the shape asked for.
+     */
+    class Scope
+    {
+      public:
+        Scope(FrameProfiler& profiler, ProfileMetric metric)
+        : profiler_(profiler), metric_(metric)
+        {
+            if(profiler_.depth_++ == 0)
+            {
+                start_ = CycleCounter::Now();
+            }
+        }
+
+        ~Scope()
+        {
+            if(--profiler_.depth_ == 0)
+            {
+                profiler_.Add(metric_, CycleCounter::Now() - start_);
+            }
+        }
+
+      private:
+        FrameProfiler& profiler_;
+        ProfileMetric  metric_;
+        uint32_t       start_ = 0;
+    };
+
+    void Init()
+    {
+        CycleCounter::Init();
+        frame_start_ = CycleCounter::Now();
+        Reset();
+    }
+
+    // Forgets every frame recorded so far
+    void Reset()
+    {
+        std::fill(std::begin(current_), std::end(current_), 0);
+        count_ = 0;
+        next_  = 0;
+    }
+
+    Scope Measure(ProfileMetric metric) { return Scope(*this, metric); }
+
+    void Add(ProfileMetric metric, uint32_t value)
+    {
+        current_[static_cast<uint8_t>(metric)] += value;
+    }
+
+    /**
+     * @brief Called from IsRender(), counts the time until it says yes.
+     */
+    void Waiting(bool busy)
+    {
+        if(busy && !waiting_)
+        {
+            waiting_    = true;
+            wait_start_ = CycleCounter::Now();
+        }
+        else if(!busy && waiting_)
+        {
+            waiting_ = false;
+            Add(ProfileMetric::Idle, CycleCounter::Now() - wait_start_);
+        }
+    }
+
+    // Stores the frame measured so far and starts the next one
+    void EndFrame()
+    {
+        auto now = CycleCounter::Now();
+        Add(ProfileMetric::Period, now - frame_start_);
+        frame_start_ = now;
+
+        uint32_t draw = 0;
+        for(auto m = ProfileMetric::Line; m < ProfileMetric::Draw;
+            m      = static_cast<ProfileMetric>(static_cast<uint8_t>(m) + 1))
+        {
+            draw += Get(m);
+        }
+        Add(ProfileMetric::Draw, draw);
+
+        std::copy(std::begin(current_), std::end(current_), frames_[next_]);
+        std::fill(std::begin(current_), std::end(current_), 0);
+        next_  = (next_ + 1) % max_frames;
+        count_ = std::min<uint16_t>(count_ + 1, max_frames);
+    }
+
+    uint16_t Frames() const { return count_; }
+
+    /**
+     * @brief Statistics of a metric over the recorded frames, times in
+     * microseconds.
+     */
+    Summary Summarize(ProfileMetric metric) const
+    {
+        Summary summary = {};
+        if(count_ == 0)
+        {
+            return summary;
+        }
+
+        uint32_t values[max_frames];
+        uint64_t total = 0;
+        auto     id    = static_cast<uint8_t>(metric);
+        for(uint16_t i = 0; i < count_; i++)
+        {
+            values[i] = frames_[i][id];
+            total += values[i];
+        }
+
+        // Sample at or below which 99% of the frames are
+        auto p99 = values + (count_ * 99 + 99) / 100 - 1;
+        std::nth_element(values, p99, values + count_);
+        auto minmax = std::minmax_element(values, values + count_);
+
+        summary.min = *minmax.first;
+        summary.avg = total / count_;
+        summary.max = *minmax.second;
+        summary.p99 = *p99;
+        if(IsTime(metric))
+        {
+            auto per_us = CycleCounter::TicksPerUs();
+            summary.min /= per_us;
+            summary.avg /= per_us;
+            summary.max /= per_us;
+            summary.p99 /= per_us;
+        }
+        return summary;
+    }
+
+    /**
+     * @brief The stage taking the longest on average: drawing on the CPU,
+     * the DMA2D or sending.
+     */
+    Bound Bottleneck() const
+    {
+        auto draw  = Summarize(ProfileMetric::Draw).avg;
+        auto wait  = Summarize(ProfileMetric::Dma2DWait).avg;
+        auto cpu   = draw > wait ? draw - wait : 0;
+        auto dma2d = Summarize(ProfileMetric::Dma2DBusy).avg;
+        auto spi   = Summarize(ProfileMetric::Spi).avg;
+        if(spi >= cpu && spi >= dma2d)
+        {
+            return Bound::Spi;
+        }
+        return dma2d > cpu ? Bound::Dma2D : Bound::Cpu;
+    }
+
+    static const char* Name(ProfileMetric metric)
+    {
+        static const char* const names[num_metrics]
+            = {"line",
+               "rect",
+               "fill rect",
+               "triangle",
+               "fill triangle",
+               "polygon",
+               "circle",
+               "fill circle",
+               "text",
+               "image",
+               "columns",
+               "draw",
+               "dma2d wait",
+               "dma2d busy",
+               "spi",
+               "spi gap",
+               "idle",
+               "chunks",
+               "bytes",
+               "period"};
+        return metric < ProfileMetric::Count
+                   ? names[static_cast<uint8_t>(metric)]
+                   : "";
+    }
+
+    static bool IsTime(ProfileMetric metric)
+    {
+        return metric != ProfileMetric::Chunks
+               && metric != ProfileMetric::Bytes;
+    }
+
+  private:
+    uint32_t Get(ProfileMetric metric) const
+    {
+        return current_[static_cast<uint8_t>(metric)];
+    }
+
+    uint32_t current_[num_metrics]            = {};
+    uint32_t frames_[max_frames][num_metrics] = {};
+    uint16_t count_                           = 0;
+    uint16_t next_                            = 0;
+    uint8_t  depth_                           = 0;
+    bool     waiting_                         = false;
+    uint32_t wait_start_                      = 0;
+    uint32_t frame_start_                     = 0;
+};
+#else
+// Without ILI9341_PROFILER every hook compiles to nothing
+class FrameProfiler
+{
+  public:
+    struct Scope
+    {
+        ~Scope() {}
+    };
+
+    void  Init() {}
+    Scope Measure(ProfileMetric) { return {}; }
+    void  Add(ProfileMetric, uint32_t) {}
+    void  Waiting(bool) {}
+    void  EndFrame() {}
+};
+#endif
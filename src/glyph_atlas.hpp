@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "util/oled_fonts.h"
+
+/**
+ * Converts 1 bit fonts into A4 glyphs the DMA2D can blend directly.
+ *
+ * Each font is converted the first time it's used and kept in a fixed pool,
+ * fonts that don't fit anymore are simply not cached and get drawn by the
+ * CPU instead. The DMA2D reads the pool, so it must be in memory it sees
+ * what the CPU wrote to, DMA_BUFFER_MEM_SECTION on the Daisy Seed.
+ */
+class GlyphAtlas
+{
+  public:
+    static constexpr char    first_char = 32;
+    static constexpr char    last_char  = 126;
+    static constexpr uint8_t num_glyphs = last_char - first_char + 1;
+    static constexpr uint8_t max_fonts  = 4;
+
+    struct Font
+    {
+        const uint16_t* data; // identifies the FontDef
+        uint8_t         width, height;
+        uint16_t        pitch;       // pixels per glyph row, padding included
+        uint16_t        glyph_bytes; // size of one glyph
+        const uint8_t*  glyphs;
+
+        const uint8_t* Glyph(char ch) const
+        {
+            return glyphs + (ch - first_char) * glyph_bytes;
+        }
+    };
+
+    void Init(uint8_t* pool, size_t size)
+    {
+        pool_      = pool;
+        pool_size_ = size;
+        used_      = 0;
+        count_     = 0;
+    }
+
+    /**
+     * @brief Returns the converted font, or nullptr if it doesn't fit.
+     */
+    const Font* Get(const daisy::FontDef& font)
+    {
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            if(fonts_[i].data == font.data)
+            {
+                return &fonts_[i];
+            }
+        }
+        return Build(font);
+    }
+
+  private:
+    const Font* Build(const daisy::FontDef& font)
+    {
+        // Two pixels per byte, so rows are padded to an even width to keep
+        // every row byte aligned for the DMA2D.
+        uint16_t pitch       = (font.FontWidth + 1) & ~1;
+        uint16_t glyph_bytes = pitch / 2 * font.FontHeight;
+        size_t   size        = glyph_bytes * num_glyphs;
+        if(count_ == max_fonts || used_ + size > pool_size_)
+        {
+            return nullptr;
+        }
+
+        auto glyphs = pool_ + used_;
+        for(size_t i = 0; i < num_glyphs * font.FontHeight; i++)
+        {
+            auto row = font.data[i];
+            auto dst = glyphs + i * (pitch / 2);
+            for(uint16_t x = 0; x < pitch; x += 2)
+            {
+                // The first pixel of a pair goes in the low nibble
+                uint8_t a = (row << x) & 0x8000 ? 0x0F : 0;
+                uint8_t b = (row << (x + 1)) & 0x8000 ? 0xF0 : 0;
+                if(x + 1 >= font.FontWidth)
+                {
+                    b = 0;
+                }
+                *dst++ = a | b;
+            }
+        }
+
+        used_ += size;
+        fonts_[count_] = {font.data,
+                          font.FontWidth,
+                          font.FontHeight,
+                          pitch,
+                          glyph_bytes,
+                          glyphs};
+        return &fonts_[count_++];
+    }
+
+    Font     fonts_[max_fonts];
+    uint8_t  count_     = 0;
+    uint8_t* pool_      = nullptr;
+    size_t   pool_size_ = 0;
+    size_t   used_      = 0;
+};
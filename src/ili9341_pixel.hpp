@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Frame buffer pixels are RGB565 in the order the SPI sends them: big endian
+ * bytes with 8 bit SPI frames, native words with ILI9341_SPI_16BIT. Converts
+ * a color either way.
+ */
+constexpr uint16_t FrameBufferPixel(uint16_t color)
+{
+#ifdef ILI9341_SPI_16BIT
+    return color;
+#else
+    // A REV16 on the target, and unlike __builtin_bswap16() it vectorizes
+    // on SIMD without byte shuffles
+    return uint16_t(color << 8 | color >> 8);
+#endif
+}
+
+// FrameBufferPixel() for the two pixels in a 32 bit word
+constexpr uint32_t FrameBufferPixels(uint32_t pair)
+{
+#ifdef ILI9341_SPI_16BIT
+    return pair;
+#else
+    return (pair & 0x00FF00FF) << 8 | (pair >> 8 & 0x00FF00FF); // REV16
+#endif
+}
@@ -1,11 +1,24 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include "ui_driver.hpp"
+#include "blend565.hpp"
+#include "ili9341_pixel.hpp"
+#include "command_stream.hpp"
+#include "dirty_region.hpp"
+#include "frame_profiler.hpp"
 using namespace daisy;
 
 #include "sys/dma.h"
 
+#if defined(ILI9341_BAND_RENDERER) \
+    && (defined(ILI9341_DOUBLE_BUFFER) || defined(ILI9341_INDEXED_FRAMEBUFFER))
+#error "ILI9341_BAND_RENDERER has no frame buffer to double or index"
+#endif
+
 /**
  * SPI Transport for ILI9341 TFT display devices
  */
@@ -14,6 +27,13 @@ class ILI9341SpiTransport
   public:
     uint32_t update_time = 0;
     uint32_t start_time  = 0;
+#ifdef ILI9341_PROFILER
+    // Totals since the driver last handed them to its FrameProfiler
+    uint32_t send_ticks     = 0;
+    uint32_t send_chunks    = 0;
+    uint32_t send_bytes     = 0;
+    uint32_t send_gap_ticks = 0; // bus idle between the chunks of a frame
+#endif
 
     void Init()
     {
@@ -29,19 +49,19 @@ class ILI9341SpiTransport
 
         2 - addressed by using DMA2D and getting rid of transparent drawing.
         */
-        SpiHandle::Config spi_config;
+        auto& spi_config           = spi_config_;
         spi_config.periph          = SpiHandle::Config::Peripheral::SPI_1;
         spi_config.mode            = SpiHandle::Config::Mode::MASTER;
         spi_config.direction       = SpiHandle::Config::Direction::TWO_LINES;
         spi_config.clock_polarity  = SpiHandle::Config::ClockPolarity::LOW;
-        spi_config.baud_prescaler  = SpiHandle::Config::BaudPrescaler::PS_2;
+        spi_config.baud_prescaler  = write_prescaler;
         spi_config.clock_phase     = SpiHandle::Config::ClockPhase::ONE_EDGE;
         spi_config.nss             = SpiHandle::Config::NSS::SOFT;
         spi_config.datasize        = 8;
         spi_config.pin_config.nss  = {DSY_GPIOG, 10}; // D7
         spi_config.pin_config.sclk = {DSY_GPIOG, 11}; // D8
         spi_config.pin_config.mosi = {DSY_GPIOB, 5};  // D10
-        spi_config.pin_config.miso = {DSY_GPIOX, 0};  // not used
+        spi_config.pin_config.miso = {DSY_GPIOX, 0};  // see InitScanlineRead()
 
         auto dc_pin    = seed::D17;
         auto reset_pin = seed::D23;
@@ -68,8 +88,24 @@ class ILI9341SpiTransport
         InitPalette();
     };
 
+#ifdef ILI9341_SPI_16BIT
+    /**
+     * @brief Moves the SPI to 16 bit frames, so pixels go out as words
+     * without being swapped and DMA transfers hold twice as many. Called once
+     * the panel is set up, commands and parameters are packed into words
+     * from then on, see SendCommand() and SendData().
+     */
+    void UseWordFrames()
+    {
+        spi_config_.datasize = 16;
+        spi_.Init(spi_config_);
+        word_frames_ = true;
+    }
+#endif
+
     void Reset()
     {
+        window_known_ = false;
         pin_reset_.Write(false);
         System::Delay(10);
         pin_reset_.Write(true);
@@ -83,18 +119,35 @@ class ILI9341SpiTransport
         auto transport = static_cast<ILI9341SpiTransport*>(context);
         if(result == SpiHandle::Result::OK)
         {
+#ifdef ILI9341_PROFILER
+            transport->gap_start_   = CycleCounter::Now();
+            transport->gap_pending_ = true;
+#endif
             if(transport->remaining_buff > 0)
             {
                 auto transfer_size = transport->GetTransferSize();
-                transport->SendDataDMA(
-                    &frame_buffer[transport->buffer_size
-                                  - transport->remaining_buff],
-                    transfer_size);
+                transport->SendDataDMA(transport->chunk_ptr_, transfer_size);
+            }
+            else if(transport->window_step_ < transport->window_steps_)
+            {
+                transport->SendWindowStep();
+            }
+            else if(transport->remaining_lines_ > 0)
+            {
+                transport->SendNextLine();
+            }
+            else if(++transport->area_id_ < transport->area_count_)
+            {
+                transport->SendArea(transport->areas_[transport->area_id_]);
             }
             else
             {
+#ifdef ILI9341_PROFILER
+                transport->send_ticks
+                    += CycleCounter::Now() - transport->send_start_;
+                transport->gap_pending_ = false;
+#endif
                 transport->dma_busy = false;
-                // transport->spi_.SetMode(8);
                 transport->update_time
                     = System::GetNow() - transport->start_time;
                 // dsy_dma_clear_cache_for_buffer(transport->frame_buffer,
@@ -103,34 +156,55 @@ class ILI9341SpiTransport
         }
         else
         {
-            __asm("BKPT #0");
+            ILI9341_BREAKPOINT();
         }
     }
 
-    static void TxStartCallback(void* context)
-    {
-        // auto transport = static_cast<ILI9341SpiTransport*>(context);
-        // transport->spi_.SetMode(16);
-    }
+    static void TxStartCallback(void* context) {}
 
     SpiHandle::Result SendDataDMA()
     {
-        remaining_buff = buffer_size;
-        dma_busy       = true;
-        start_time     = System::GetNow();
+        DirtyRegion::Area area = {0, 0, width - 1, height - 1};
+        return SendAreasDMA(&area, 1);
+    };
 
-        // Manual cache invalidation, useful if you don't want to change MPU in system.cpp
-        // dsy_dma_clear_cache_for_buffer(frame_buffer, buffer_size);
-        return SendDataDMA(frame_buffer, buf_chunk_size);
+    /**
+     * @brief Sends only the given areas of the frame buffer.
+     * Each area gets its own address window, narrow areas are sent line by
+     * line since SPI DMA can't skip the rest of the frame buffer row.
+     *
+     * With scan_order the areas go out left to right, the way the panel
+     * refreshes, so each is written before the refresh gets to it.
+     */
+    SpiHandle::Result SendDataDMA(const DirtyRegion& region,
+                                  bool               scan_order = false)
+    {
+        // At most max_areas, inserted in place when sorted
+        DirtyRegion::Area areas[DirtyRegion::max_areas];
+        uint8_t count
+            = std::min<uint8_t>(region.Count(), DirtyRegion::max_areas);
+        for(uint8_t i = 0; i < count; i++)
+        {
+            uint8_t j = i;
+            for(; scan_order && j > 0 && areas[j - 1].x0 > region[i].x0; j--)
+            {
+                areas[j] = areas[j - 1];
+            }
+            areas[j] = region[i];
+        }
+        return SendAreasDMA(areas, count);
     };
 
     SpiHandle::Result SendDataDMA(uint8_t* buff, size_t size)
     {
         pin_dc_.Write(true);
-        auto result = spi_.DmaTransmit(
-            buff, size, &TxStartCallback, &TxCompleteCallback, this);
         remaining_buff -= size;
-        return result;
+        chunk_ptr_ = buff + size;
+#ifdef ILI9341_PROFILER
+        send_chunks++;
+        send_bytes += size;
+#endif
+        return StartDMA(buff, size / frame_bytes);
     };
 
     uint32_t GetTransferSize() const
@@ -142,105 +216,686 @@ class ILI9341SpiTransport
     SpiHandle::Result SendCommand(uint8_t cmd)
     {
         pin_dc_.Write(false);
+#ifdef ILI9341_SPI_16BIT
+        if(word_frames_)
+        {
+            // The high byte goes out first, a NOP (0x00) ahead of cmd
+            uint16_t frame = cmd;
+            return spi_.BlockingTransmit(reinterpret_cast<uint8_t*>(&frame),
+                                         1);
+        }
+#endif
         return spi_.BlockingTransmit(&cmd, 1);
     };
 
     SpiHandle::Result SendData(uint8_t* buff, size_t size)
     {
         pin_dc_.Write(true);
+#ifdef ILI9341_SPI_16BIT
+        // Parameters go in pairs, an odd one out is padded with a 0 the
+        // panel ignores as one parameter too many
+        uint16_t frames[8];
+        if(word_frames_)
+        {
+            if(size > 2 * std::size(frames))
+            {
+                ILI9341_BREAKPOINT();
+                size = 2 * std::size(frames);
+            }
+            for(size_t i = 0; i < size; i += 2)
+            {
+                uint8_t low   = i + 1 < size ? buff[i + 1] : 0;
+                frames[i / 2] = buff[i] << 8 | low;
+            }
+            buff = reinterpret_cast<uint8_t*>(frames);
+            size = (size + 1) / 2;
+        }
+#endif
         auto result = spi_.BlockingTransmit(buff, size);
         if(result != SpiHandle::Result::OK)
         {
-            __asm("BKPT #0");
+            ILI9341_BREAKPOINT();
         }
         return result;
     };
 
+    /**
+     * @brief Plays back commands encoded as described in CommandStream,
+     * e.g. a constant table in flash.
+     */
+    void SendCommands(const uint8_t* commands, size_t size)
+    {
+        for(size_t i = 0; i + 1 < size;)
+        {
+            uint8_t cmd   = commands[i++];
+            uint8_t count = commands[i++];
+            uint8_t n     = count & ~command_delay_flag;
+            SendCommand(cmd);
+            if(n > 0)
+            {
+                // Only read, SendData() just isn't declared const
+                SendData(const_cast<uint8_t*>(&commands[i]), n);
+                i += n;
+            }
+            if(count & command_delay_flag)
+            {
+                System::Delay(commands[i++]);
+            }
+        }
+    }
+
+    /**
+     * @brief Sets the window the next memory write fills. The panel keeps
+     * the column and row ranges until they are set again, so only those
+     * that changed are sent: bands and lines of the same width only need
+     * the rows, a repeated window only RAMWR.
+     *
+     * Blocks until the commands are sent. Areas sent from the SPI interrupt
+     * queue them by DMA instead, see SendArea().
+     */
     void SetAddressWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
     {
-        // column address set
-        SendCommand(0x2A); // CASET
+        QueueWindow(x0, y0, x1, y1);
+        for(; window_step_ < window_steps_; window_step_++)
+        {
+            auto& step = window_step_list_[window_step_];
+            pin_dc_.Write(step.data);
+            spi_.BlockingTransmit(&window_bytes_[step.offset], step.frames);
+        }
+    }
+
+    /**
+     * @brief Splits the panel's scan lines into a fixed top, a scrolling
+     * middle and a fixed bottom part, the three must add up to 320.
+     */
+    void SetScrollArea(uint16_t top, uint16_t scroll, uint16_t bottom)
+    {
+        SendCommand(0x33); // VSCRDEF
+        uint8_t data[6] = {static_cast<uint8_t>(top >> 8),
+                           static_cast<uint8_t>(top & 0xFF),
+                           static_cast<uint8_t>(scroll >> 8),
+                           static_cast<uint8_t>(scroll & 0xFF),
+                           static_cast<uint8_t>(bottom >> 8),
+                           static_cast<uint8_t>(bottom & 0xFF)};
+        SendData(data, 6);
+    }
+
+    /**
+     * @brief Turns on the panel's tearing effect output, high during
+     * vertical blanking, and reads it on pin.
+     */
+    void InitTearingPin(Pin pin)
+    {
+        pin_te_.Init(pin, GPIO::Mode::INPUT, GPIO::Pull::PULLDOWN);
+        SendCommand(0x35); // TEON
+        uint8_t data[1] = {0x00}; // vertical blanking only
+        SendData(data, 1);
+    }
+
+    bool TearingEffect() { return pin_te_.Read(); }
+
+    /**
+     * @brief Reads the panel's SDO on miso, which must be a MISO pin of
+     * SPI_1 (D9 on the Seed), for ReadScanline().
+     */
+    void InitScanlineRead(Pin miso)
+    {
+        spi_config_.pin_config.miso = miso;
+        spi_.Init(spi_config_);
+    }
+
+    /**
+     * @brief Scan line the panel is refreshing (GET_SCANLINE). Needs the bus
+     * idle, and 0 without InitScanlineRead().
+     *
+     * The panel reads out at 6.66 MHz at most, so the SPI is slowed down to
+     * read_prescaler for it and set back to the write clock after, which
+     * costs two SPI inits per read.
+     */
+    uint16_t ReadScanline()
+    {
+        if(spi_config_.pin_config.miso.port == DSY_GPIOX)
         {
-            uint8_t data[4] = {static_cast<uint8_t>((x0 >> 8) & 0xFF),
-                               static_cast<uint8_t>(x0 & 0xFF),
-                               static_cast<uint8_t>((x1 >> 8) & 0xFF),
-                               static_cast<uint8_t>(x1 & 0xFF)};
-            SendData(data, 4);
+            return 0;
         }
+        SendCommand(0x45);
+        spi_config_.baud_prescaler = read_prescaler;
+        spi_.Init(spi_config_);
 
-        // row address set
-        SendCommand(0x2B); // RASET
+        // A dummy byte, then the line in 10 bits
+        pin_dc_.Write(true);
+        uint16_t line = 0;
+#ifdef ILI9341_SPI_16BIT
+        uint16_t frames[2] = {};
+        if(spi_.BlockingReceive(reinterpret_cast<uint8_t*>(frames), 2, 10)
+           == SpiHandle::Result::OK)
         {
-            uint8_t data[4] = {static_cast<uint8_t>((y0 >> 8) & 0xFF),
-                               static_cast<uint8_t>(y0 & 0xFF),
-                               static_cast<uint8_t>((y1 >> 8) & 0xFF),
-                               static_cast<uint8_t>(y1 & 0xFF)};
-            SendData(data, 4);
+            line = (frames[0] & 0x03) << 8 | frames[1] >> 8;
         }
+#else
+        uint8_t data[3] = {};
+        if(spi_.BlockingReceive(data, 3, 10) == SpiHandle::Result::OK)
+        {
+            line = (data[1] & 0x03) << 8 | data[2];
+        }
+#endif
 
-        // write to RAM
-        SendCommand(0x2C); // RAMWR
+        spi_config_.baud_prescaler = write_prescaler;
+        spi_.Init(spi_config_);
+        return line;
     }
 
+    // Memory line shown first in the scrolling part
+    void SetScrollStart(uint16_t line)
+    {
+        SendCommand(0x37); // VSCRSADD
+        uint8_t data[2] = {static_cast<uint8_t>(line >> 8),
+                           static_cast<uint8_t>(line & 0xFF)};
+        SendData(data, 2);
+    }
+
+    // Index of a screen pixel in the draw buffer
+    uint32_t PixelId(uint16_t x, uint16_t y) const
+    {
+        return x + (y - origin_y) * width;
+    }
+
+    // id is the pixel index, see PixelId()
     void PaintPixel(uint32_t id, uint8_t color_id, uint8_t alpha = 255) const
     {
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        // Indices can't be blended, so mostly opaque pixels win
+        if(alpha >= 128)
+        {
+            draw_buffer[id] = color_id;
+        }
+#else
+        auto pixel = reinterpret_cast<uint16_t*>(draw_buffer) + id;
         auto color = tftPalette[color_id];
 
         // Update the color to match corresponding alpha value
         if(alpha != 255)
         {
-            // auto bg_color = tftPalette[color_mem[id]];
-            uint16_t bg_color = frame_buffer[id] << 8 | frame_buffer[id + 1];
-            color             = Blend565(color, bg_color, alpha);
+            color = Blend565(color, FrameBufferPixel(*pixel), alpha);
+        }
+        *pixel = FrameBufferPixel(color);
+#endif
+    }
+
+    /**
+     * @brief Calls walk(paint), where paint(id) paints pixel id (see
+     * PixelId()) in the color. The color and alpha are looked at once here
+     * rather than for every pixel, for paths such as lines.
+     */
+    template <typename Walk>
+    void PaintPixels(uint8_t color_id, uint8_t alpha, Walk walk) const
+    {
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        if(alpha >= 128)
+        {
+            auto pixels = draw_buffer;
+            walk([=](uint32_t id) { pixels[id] = color_id; });
+        }
+#else
+        auto pixels = reinterpret_cast<uint16_t*>(draw_buffer);
+        auto color  = tftPalette[color_id];
+        if(alpha != 255)
+        {
+            walk(
+                [=](uint32_t id)
+                {
+                    auto bg    = FrameBufferPixel(pixels[id]);
+                    pixels[id] = FrameBufferPixel(Blend565(color, bg, alpha));
+                });
+            return;
+        }
+        color = FrameBufferPixel(color);
+        walk([=](uint32_t id) { pixels[id] = color; });
+#endif
+    }
+
+    /**
+     * @brief Paints pixels x0..x1 of line y, coordinates must be on screen.
+     * Opaque runs are written two pixels per 32 bit store, translucent ones
+     * are blended by BlendSpan565().
+     */
+    void FillSpan(uint16_t x0,
+                  uint16_t x1,
+                  uint16_t y,
+                  uint8_t  color_id,
+                  uint8_t  alpha = 255) const
+    {
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        if(alpha >= 128)
+        {
+            memset(&draw_buffer[PixelId(x0, y)], color_id, x1 - x0 + 1);
+        }
+#else
+        FillSpan565(x0, x1, y, tftPalette[color_id], alpha);
+#endif
+    }
+
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+    // FillSpan() in any RGB565 color rather than a palette entry
+    void FillSpan565(uint16_t x0,
+                     uint16_t x1,
+                     uint16_t y,
+                     uint16_t color,
+                     uint8_t  alpha = 255) const
+    {
+        auto     pixel = PixelAt(x0, y);
+        uint32_t n     = x1 - x0 + 1;
+        if(alpha != 255)
+        {
+            BlendSpan565(pixel, n, color, alpha);
+            return;
+        }
+
+        color = FrameBufferPixel(color);
+        if(reinterpret_cast<uintptr_t>(pixel) & 0x2)
+        {
+            *pixel++ = color;
+            n--;
+        }
+
+        auto     pair   = reinterpret_cast<uint32_t*>(pixel);
+        uint32_t color2 = color | (color << 16);
+        for(; n >= 2; n -= 2)
+        {
+            *pair++ = color2;
+        }
+        if(n)
+        {
+            *reinterpret_cast<uint16_t*>(pair) = color;
+        }
+    }
+
+    // Pixel x, y of the draw buffer, which must be on screen
+    uint16_t* PixelAt(uint16_t x, uint16_t y) const
+    {
+        return reinterpret_cast<uint16_t*>(draw_buffer) + PixelId(x, y);
+    }
+#endif
+
+    /**
+     * @brief Paints pixels y0..y1 of column x, coordinates must be on screen.
+     */
+    void FillColumn(uint16_t x,
+                    uint16_t y0,
+                    uint16_t y1,
+                    uint8_t  color_id,
+                    uint8_t  alpha = 255) const
+    {
+        uint32_t id = PixelId(x, y0);
+        uint32_t n  = y1 - y0 + 1;
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        for(; n > 0 && alpha >= 128; n--, id += width)
+        {
+            draw_buffer[id] = color_id;
+        }
+#else
+        if(alpha != 255)
+        {
+            for(; n > 0; n--, id += width)
+            {
+                PaintPixel(id, color_id, alpha);
+            }
+            return;
         }
-        // store current color in the buffer
-        // color_mem[id] = color_id;
 
-        frame_buffer[id]     = color >> 8;
-        frame_buffer[id + 1] = color & 0xFF;
+        uint16_t color = FrameBufferPixel(tftPalette[color_id]);
+        auto     pixel = reinterpret_cast<uint16_t*>(&draw_buffer[id * 2]);
+        for(; n > 0; n--, pixel += width)
+        {
+            *pixel = color;
+        }
+#endif
     }
 
-    uint16_t GetPixel(uint32_t id) { return color_mem[id]; }
+    // For when the DMA2D can't be used, e.g. for 8 bit pixels, where a row
+    // of indices is a memset. rect must be on screen.
+    void FillRect(const Rectangle& rect, uint8_t color_id, uint8_t alpha = 255)
+    {
+        for(auto y = rect.GetY(); y < rect.GetBottom(); y++)
+        {
+            FillSpan(rect.GetX(), rect.GetRight() - 1, y, color_id, alpha);
+        }
+    }
 
-    bool     dma_busy       = false;
-    uint32_t remaining_buff = 0;
+    /**
+     * @brief Makes the freshly drawn buffer the one to be sent and returns
+     * false if there is only one buffer to draw to.
+     */
+    bool SwapBuffers()
+    {
+#ifdef ILI9341_DOUBLE_BUFFER
+        std::swap(draw_buffer, send_buffer);
+        return true;
+#else
+        return false;
+#endif
+    }
 
-    static uint32_t const buffer_size = 153600; // 320 * 240 * 2
-    // const uint16_t        buf_chunk_size = buffer_size / 3; // 8bit data
-    static constexpr uint16_t buf_chunk_size = UINT16_MAX;
-    // const uint16_t buf_chunk_size = buffer_size / 4; // 16bit data
-    static uint8_t DMA_BUFFER_MEM_SECTION frame_buffer[buffer_size];
-    static uint8_t DSY_SDRAM_BSS          color_mem[buffer_size / 2];
-    SpiHandle                             spi_;
+    /**
+     * @brief True if an area this wide is sent as full lines. Restarting DMA
+     * for every line costs about as much as sending this many bytes, so
+     * nearly full width areas are cheaper sent whole.
+     */
+    static bool SendsFullWidth(uint32_t area_width)
+    {
+        static constexpr uint32_t line_overhead = 32;
+        return (width - area_width) * 2 < line_overhead;
+    }
+
+#ifdef ILI9341_BAND_RENDERER
+    // Next drawing goes to the band starting at line y
+    void BeginBand(uint16_t y) { origin_y = y; }
+
+    /**
+     * @brief Sends columns x0..x1 of the band just drawn and moves drawing to
+     * the other band buffer. The previous band must be done sending.
+     */
+    SpiHandle::Result SendBandDMA(uint16_t x0, uint16_t x1)
+    {
+        DirtyRegion::Area area
+            = {x0,
+               origin_y,
+               x1,
+               static_cast<uint16_t>(origin_y + band_height - 1)};
+        send_buffer = draw_buffer;
+        send_y_     = origin_y;
+        draw_buffer = draw_buffer == band_buffer[0] ? band_buffer[1]
+                                                    : band_buffer[0];
+        return SendAreasDMA(&area, 1);
+    }
+#endif
+
+    // Cleared from the SPI interrupt, so loops waiting on it reread it
+    volatile bool dma_busy       = false;
+    uint32_t      remaining_buff = 0;
+
+    static constexpr uint16_t width  = 320;
+    static constexpr uint16_t height = 240;
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+    // One palette index per pixel, expanded to RGB565 while sending
+    static constexpr uint8_t pixel_size = 1;
+#else
+    static constexpr uint8_t pixel_size = 2;
+#endif
+    static constexpr uint32_t line_size   = width * pixel_size;
+    static uint32_t const     buffer_size = line_size * height;
+#ifdef ILI9341_SPI_16BIT
+    static constexpr uint8_t frame_bytes = 2;
+#else
+    static constexpr uint8_t frame_bytes = 1;
+#endif
+    // A DMA transfer counts up to 65535 frames, so the whole screen takes
+    // three with 8 bit frames and two with 16 bit ones
+    static constexpr uint32_t buf_chunk_size = UINT16_MAX * frame_bytes;
+#ifdef ILI9341_BAND_RENDERER
+#ifndef ILI9341_BAND_HEIGHT
+#define ILI9341_BAND_HEIGHT 16
+#endif
+    static constexpr uint16_t band_height = ILI9341_BAND_HEIGHT;
+    static_assert(height % band_height == 0, "Bands must tile the screen");
+    static constexpr uint32_t band_size = line_size * band_height;
+
+    // Two bands instead of the frame, one is drawn while the other is sent
+    // Pixels are accessed as words, see FillSpan()
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION band_buffer[2][band_size];
+    uint8_t* draw_buffer = band_buffer[0];
+    uint8_t* send_buffer = band_buffer[1];
+    // First screen line of the band in draw_buffer
+    uint16_t origin_y = 0;
+#else
+    // Pixels are accessed as words, see FillSpan()
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION frame_buffer[buffer_size];
+#ifdef ILI9341_DOUBLE_BUFFER
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION back_buffer[buffer_size];
+    // Drawing goes to one buffer while DMA streams the other
+    uint8_t* draw_buffer = frame_buffer;
+    uint8_t* send_buffer = back_buffer;
+#else
+    uint8_t* draw_buffer = frame_buffer;
+    uint8_t* send_buffer = frame_buffer;
+#endif
+    static constexpr uint16_t origin_y = 0;
+#endif
+    SpiHandle spi_;
 
     uint16_t tftPalette[NUMBER_OF_TFT_COLORS];
 
   private:
+    SpiHandle::Result SendAreasDMA(const DirtyRegion::Area* areas,
+                                   uint8_t                  count)
+    {
+        if(count == 0)
+        {
+            return SpiHandle::Result::OK;
+        }
+
+        for(uint8_t i = 0; i < count; i++)
+        {
+            areas_[i] = areas[i];
+        }
+        area_count_ = count;
+        area_id_    = 0;
+        dma_busy    = true;
+        start_time  = System::GetNow();
+#ifdef ILI9341_PROFILER
+        send_start_ = CycleCounter::Now();
+#endif
+
+        // Manual cache invalidation, useful if you don't want to change MPU in system.cpp
+        // dsy_dma_clear_cache_for_buffer(frame_buffer, buffer_size);
+        return SendArea(areas_[0]);
+    }
+
+    SpiHandle::Result SendArea(DirtyRegion::Area area)
+    {
+        if(SendsFullWidth(area.Width()))
+        {
+            area.x0 = 0;
+            area.x1 = width - 1;
+        }
+
+        // The window goes out by DMA too, the lines follow from the
+        // interrupt once it's set
+        QueueWindow(area.x0, area.y0, area.x1, area.y1);
+
+        auto offset = area.x0 + (area.y0 - send_y_) * width;
+        line_ptr_   = &send_buffer[offset * pixel_size];
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        line_pixels_     = area.Width();
+        line_bytes_      = area.Width() * 2;
+        remaining_lines_ = area.Height();
+        line_ready_      = false;
+#else
+        if(area.Width() == width)
+        {
+            // Full width lines are contiguous in the frame buffer
+            line_bytes_      = area.Height() * line_size;
+            remaining_lines_ = 1;
+        }
+        else
+        {
+            line_bytes_      = area.Width() * 2;
+            remaining_lines_ = area.Height();
+        }
+#endif
+
+        return SendWindowStep();
+    }
+
+    /**
+     * @brief Encodes the commands setting a window into window_bytes_, as
+     * steps of a command (DC low) or its parameters (DC high), in the SPI
+     * frames of the moment. Only ranges that changed are set.
+     */
+    void QueueWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+    {
+        window_steps_ = 0;
+        window_step_  = 0;
+        window_used_  = 0;
+        if(!window_known_ || x0 != window_.x0 || x1 != window_.x1)
+        {
+            QueueStep(false, {0x2A}); // CASET
+            QueueStep(true, {x0, x1});
+        }
+        if(!window_known_ || y0 != window_.y0 || y1 != window_.y1)
+        {
+            QueueStep(false, {0x2B}); // RASET
+            QueueStep(true, {y0, y1});
+        }
+        QueueStep(false, {0x2C}); // RAMWR
+        window_       = {x0, y0, x1, y1};
+        window_known_ = true;
+    }
+
+    // A command is one frame, each parameter two bytes, big endian
+    void QueueStep(bool data, std::initializer_list<uint16_t> values)
+    {
+        auto& step  = window_step_list_[window_steps_++];
+        step.data   = data;
+        step.offset = window_used_;
+        step.frames = 0;
+        for(uint16_t value : values)
+        {
+#ifdef ILI9341_SPI_16BIT
+            if(word_frames_)
+            {
+                // A command goes after a NOP (0x00) in the high byte
+                memcpy(&window_bytes_[window_used_], &value, 2);
+                window_used_ += 2;
+                step.frames++;
+                continue;
+            }
+#endif
+            if(data)
+            {
+                window_bytes_[window_used_++] = value >> 8;
+                step.frames++;
+            }
+            window_bytes_[window_used_++] = value & 0xFF;
+            step.frames++;
+        }
+    }
+
+    SpiHandle::Result SendWindowStep()
+    {
+        auto& step = window_step_list_[window_step_++];
+        pin_dc_.Write(step.data);
+        return StartDMA(&window_bytes_[step.offset], step.frames);
+    }
+
+    // Sizes count SPI frames
+    SpiHandle::Result StartDMA(uint8_t* buff, size_t frames)
+    {
+#ifdef ILI9341_PROFILER
+        if(gap_pending_)
+        {
+            send_gap_ticks += CycleCounter::Now() - gap_start_;
+            gap_pending_ = false;
+        }
+#endif
+        return spi_.DmaTransmit(
+            buff, frames, &TxStartCallback, &TxCompleteCallback, this);
+    }
+
+    SpiHandle::Result SendNextLine()
+    {
+        remaining_lines_--;
+        remaining_buff = line_bytes_;
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+        // The next line is expanded while this one is on the wire. Should
+        // the DMA finish first, e.g. when the CPU was held up right after
+        // starting it, the line is expanded here instead.
+        if(!line_ready_)
+        {
+            ExpandLine(line_ptr_, line_buffer_[line_id_]);
+        }
+        auto line = line_buffer_[line_id_];
+        line_id_ ^= 1;
+        line_ptr_ += line_size;
+        line_ready_ = false;
+        auto result = SendDataDMA(line, GetTransferSize());
+        if(remaining_lines_ > 0 && !line_ready_)
+        {
+            ExpandLine(line_ptr_, line_buffer_[line_id_]);
+            line_ready_ = true;
+        }
+        return result;
+#else
+        auto line = line_ptr_;
+        line_ptr_ += line_size;
+        return SendDataDMA(line, GetTransferSize());
+#endif
+    }
+
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+    void ExpandLine(const uint8_t* src, uint8_t* dst) const
+    {
+        auto line = reinterpret_cast<uint16_t*>(dst);
+        for(uint16_t i = 0; i < line_pixels_; i++)
+        {
+            line[i] = FrameBufferPixel(tftPalette[src[i]]);
+        }
+    }
+#endif
+
     GPIO pin_dc_;
     GPIO pin_reset_;
     GPIO pin_cs_;
+    GPIO pin_te_;
 
+    DirtyRegion::Area window_       = {};
+    bool              window_known_ = false; // window_ is the panel's
+    // CASET, RASET and RAMWR with their parameters, see QueueWindow()
+    struct WindowStep
+    {
+        bool    data; // parameters, sent with DC high
+        uint8_t offset, frames;
+    };
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION window_bytes_[16];
+    WindowStep window_step_list_[5];
+    uint8_t    window_steps_ = 0;
+    uint8_t    window_step_  = 0; // next to send
+    uint8_t    window_used_  = 0;
+    DirtyRegion::Area areas_[DirtyRegion::max_areas];
+    uint8_t           area_count_      = 0;
+    uint8_t           area_id_         = 0;
+    uint8_t*          line_ptr_        = nullptr;
+    uint8_t*          chunk_ptr_       = nullptr;
+    uint32_t          line_bytes_      = 0;
+    uint16_t          remaining_lines_ = 0;
+#ifdef ILI9341_PROFILER
+    uint32_t send_start_  = 0;
+    uint32_t gap_start_   = 0; // end of the chunk before the next one
+    bool     gap_pending_ = false;
+#endif
+    SpiHandle::Config spi_config_;
+    // Writes run far faster than the datasheet's 10 MHz, which the panels
+    // take, but reads must stay under 6.66 MHz. PS_32 does from SPI kernel
+    // clocks up to 213 MHz.
+    static constexpr auto write_prescaler
+        = SpiHandle::Config::BaudPrescaler::PS_2;
+    static constexpr auto read_prescaler
+        = SpiHandle::Config::BaudPrescaler::PS_32;
+#ifdef ILI9341_SPI_16BIT
+    bool word_frames_ = false;
+#endif
+#ifdef ILI9341_BAND_RENDERER
+    uint16_t send_y_ = 0; // first screen line of send_buffer
+#else
+    static constexpr uint16_t send_y_ = 0;
+#endif
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION line_buffer_[2][width * 2];
+    uint8_t                               line_id_     = 0;
+    uint16_t                              line_pixels_ = 0;
+    volatile bool                         line_ready_  = false;
+#endif
 
-    uint16_t Blend565(uint16_t fg, uint16_t bg, uint8_t alpha) const
-    {
-        int max_alpha   = 64;
-        int mask_mul_rb = 4065216; // 0b1111100000011111
-        int mask_mul_g  = 129024;  // 0b0000011111100000
-        int mask_rb     = 63519;   // 0b1111100000011111000000
-        int mask_g      = 2016;    // 0b0000011111100000000000
-
-        // alpha for foreground multiplication  convert from 8bit to (6bit+1) with rounding will be in [0..64] inclusive
-        alpha = (alpha + 2) >> 2;
-        // "beta" for background multiplication; (6bit+1); will be in [0..64] inclusive
-        uint8_t beta = max_alpha - alpha;
-        // so (0..64)*alpha + (0..64)*beta always in 0..64
-        return (uint16_t)((((alpha * (uint32_t)(fg & mask_rb)
-                             + beta * (uint32_t)(bg & mask_rb))
-                            & mask_mul_rb)
-                           | ((alpha * (fg & mask_g) + beta * (bg & mask_g))
-                              & mask_mul_g))
-                          >> 6);
-    }
 
     void InitPalette()
     {
@@ -1,7 +1,24 @@
 #include "ili9341_ui_driver.hpp"
 
+#ifdef ILI9341_BAND_RENDERER
+uint8_t ILI9341SpiTransport::band_buffer[2][ILI9341SpiTransport::band_size]
+    = {};
+#else
 uint8_t ILI9341SpiTransport::frame_buffer[ILI9341SpiTransport::buffer_size]
     = {}; // DMA max (?) 65536 // full screen - 153600
+#endif
 
-uint8_t ILI9341SpiTransport::color_mem[ILI9341SpiTransport::buffer_size / 2]
-    = {};
\ No newline at end of file
+#ifdef ILI9341_DOUBLE_BUFFER
+uint8_t ILI9341SpiTransport::back_buffer[ILI9341SpiTransport::buffer_size]
+    = {};
+#endif
+
+uint8_t ILI9341SpiTransport::window_bytes_[16] = {};
+
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+uint8_t ILI9341SpiTransport::line_buffer_[2][ILI9341SpiTransport::width * 2]
+    = {};
+#endif
+#if !defined(ILI9341_INDEXED_FRAMEBUFFER) && !defined(ILI9341_BAND_RENDERER)
+uint8_t ILI9341UiDriver::glyph_pool_[ILI9341_GLYPH_CACHE_SIZE] = {};
+#endif
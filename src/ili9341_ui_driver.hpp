@@ -1,11 +1,26 @@
 #pragma once
 
+#include <iterator>
 #include "ui_driver.hpp"
 
 using namespace daisy;
 
 #include "ili9341_transport.hpp"
 #include "dma2d.hpp"
+#include "glyph_atlas.hpp"
+#include "display_list.hpp"
+#include "coverage_raster.hpp"
+#include "polygon_raster.hpp"
+#include "rle_image.hpp"
+#include "sprite.hpp"
+#include "frame_profiler.hpp"
+#include "frame_pacer.hpp"
+#include "render_slicer.hpp"
+
+// Bytes kept for fonts converted to DMA2D glyphs, see GlyphAtlas
+#ifndef ILI9341_GLYPH_CACHE_SIZE
+#define ILI9341_GLYPH_CACHE_SIZE 16384
+#endif
 
 /**
  * A driver implementation for the ILI9341
@@ -20,12 +35,21 @@ class ILI9341UiDriver : public _UiDriver
 
     void Init() override
     {
-        screen_update_period_ = 17; // 17 is roughly 60Hz
-        screen_update_last_   = System::GetNow();
-
         InitDriver();
         Start();
-        dma2d_.Init(transport_.frame_buffer);
+        dma2d_.Init(transport_.draw_buffer);
+        // Both paint the same shapes, depending on their size, so they must
+        // agree on the colors.
+        std::copy(std::begin(transport_.tftPalette),
+                  std::end(transport_.tftPalette),
+                  dma2d_.tftPalette);
+#if !defined(ILI9341_INDEXED_FRAMEBUFFER) && !defined(ILI9341_BAND_RENDERER)
+        glyphs_.Init(glyph_pool_, sizeof(glyph_pool_));
+#endif
+
+        dirty_.Init(width, height);
+        dirty_.MarkAll();
+        profiler_.Init();
     }
 
     uint32_t Time() override { return transport_.update_time; }
@@ -37,39 +61,79 @@ class ILI9341UiDriver : public _UiDriver
                   uint8_t  color,
                   uint8_t  alpha = 255) override
     {
+        auto scope = profiler_.Measure(ProfileMetric::Line);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Line(x1, y1, x2, y2, color, alpha)))
+        {
+            return;
+        }
+#endif
+        dirty_.Add(std::min(x1, x2),
+                   std::min(y1, y2),
+                   std::max(x1, x2),
+                   std::max(y1, y2));
+
         if(x1 == x2)
         {
-            return DrawVLine(x1, y1, y2 - y1 + 1, color, alpha);
+            return DrawColumn(x1, y1, y2, color, alpha);
         }
         else if(y1 == y2)
         {
-            return DrawHLine(x1, y1, x2 - x1 + 1, color, alpha);
+            return DrawSpan(x1, x2, y1, color, alpha);
         }
 
-        auto deltaX = abs((int_fast16_t)x2 - (int_fast16_t)x1);
-        auto deltaY = abs((int_fast16_t)y2 - (int_fast16_t)y1);
-        auto signX  = ((x1 < x2) ? 1 : -1);
-        auto signY  = ((y1 < y2) ? 1 : -1);
-        auto error  = deltaX - deltaY;
-
-        DrawPixel(x2, y2, color, alpha);
-
-        while((x1 != x2) || (y1 != y2))
+        int_fast16_t x      = x1;
+        int_fast16_t y      = y1;
+        auto         deltaX = abs((int_fast16_t)x2 - x);
+        auto         deltaY = abs((int_fast16_t)y2 - y);
+        auto         signX  = ((x1 < x2) ? 1 : -1);
+        auto         signY  = ((y1 < y2) ? 1 : -1);
+        auto         error  = deltaX - deltaY;
+
+        // Runs shorter than 4 pixels are cheaper stepped a pixel at a time
+        // than clipped and written as runs
+        if(std::min(deltaX, deltaY) * 4 > std::max(deltaX, deltaY))
         {
-            DrawPixel(x1, y1, color, alpha);
-            auto error2 = error * 2;
-            if(error2 > -deltaY)
-            {
-                error -= deltaY;
-                x1 += signX;
-            }
+            return DrawSteps(x1, y1, x2, y2, color, alpha);
+        }
 
-            if(error2 < deltaX)
+        // Bresenham a run at a time. The major axis steps every time, and
+        // the error term tells how many steps pass before the minor one does:
+        // after the first run, the whole steps of the slope less one, or one
+        // more when its remainder carries.
+        if(deltaX > deltaY)
+        {
+            int32_t over  = 2 * error - deltaX; // y steps once it's negative
+            int32_t n     = over / (2 * deltaY) + 1;
+            int32_t carry = over % (2 * deltaY);
+            int32_t whole = deltaX / deltaY - 1;
+            int32_t rest  = 2 * (deltaX % deltaY);
+            while(n < abs(x2 - x))
             {
-                error += deltaX;
-                y1 += signY;
+                DrawSpan(x, x + n * signX, y, color, alpha);
+                x += (n + 1) * signX;
+                y += signY;
+                carry += rest;
+                n = whole + (carry >= 2 * deltaY);
+                carry -= carry >= 2 * deltaY ? 2 * deltaY : 0;
             }
+            return DrawSpan(x, x2, y, color, alpha);
+        }
+        int32_t under = -deltaY - 2 * error; // x steps once it's negative
+        int32_t n     = under / (2 * deltaX) + 1;
+        int32_t carry = under % (2 * deltaX);
+        int32_t whole = deltaY / deltaX - 1;
+        int32_t rest  = 2 * (deltaY % deltaX);
+        while(n < abs(y2 - y))
+        {
+            DrawColumn(x, y, y + n * signY, color, alpha);
+            y += (n + 1) * signY;
+            x += signX;
+            carry += rest;
+            n = whole + (carry >= 2 * deltaX);
+            carry -= carry >= 2 * deltaX ? 2 * deltaX : 0;
         }
+        DrawColumn(x, y, y2, color, alpha);
     }
 
     void DrawRect(uint16_t x,
@@ -79,18 +143,40 @@ class ILI9341UiDriver : public _UiDriver
                   uint8_t  color,
                   uint8_t  alpha = 255) override
     {
+        auto scope = profiler_.Measure(ProfileMetric::Rect);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Rect(x, y, w, h, color, alpha)))
+        {
+            return;
+        }
+#endif
         auto x2 = x + w;
         auto y2 = y + h;
-        DrawLine(x, y, x, y2, color, alpha);
-        DrawLine(x, y, x2, y, color, alpha);
-        DrawLine(x, y2, x2, y2, color, alpha);
-        DrawLine(x2, y, x2, y2, color, alpha);
+        dirty_.Add(x, y, x2, y2);
+
+        // Corners belong to the rows only, so translucent ones aren't
+        // blended twice
+        DrawSpan(x, x2, y, color, alpha);
+        DrawSpan(x, x2, y2, color, alpha);
+        if(h > 1)
+        {
+            DrawColumn(x, y + 1, y2 - 1, color, alpha);
+            DrawColumn(x2, y + 1, y2 - 1, color, alpha);
+        }
     }
 
     void
     FillRect(const Rectangle& rect, uint8_t color, uint8_t alpha = 255) override
     {
-        return dma2d_.FillRect(rect, color, alpha);
+        auto scope = profiler_.Measure(ProfileMetric::FillRect);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::FillRect(rect, color, alpha)))
+        {
+            return;
+        }
+#endif
+        Invalidate(rect);
+        return FillArea(rect, color, alpha);
 
         // for(int16_t i = rect.GetX(); i < rect.GetRight(); i++)
         // {
@@ -107,6 +193,7 @@ class ILI9341UiDriver : public _UiDriver
                       uint8_t color,
                       uint8_t alpha = 255) override
     {
+        auto scope = profiler_.Measure(ProfileMetric::Triangle);
         DrawLine(x0, y0, x1, y1, color, alpha);
         DrawLine(x1, y1, x2, y2, color, alpha);
         DrawLine(x2, y2, x0, y0, color, alpha);
@@ -121,96 +208,56 @@ class ILI9341UiDriver : public _UiDriver
                       uint8_t color,
                       uint8_t alpha = 255) override
     {
-        int16_t a, b, y, last;
-
-        // Sort coordinates by Y order (y2 >= y1 >= y0)
-        if(y0 > y1)
-        {
-            std::swap(y0, y1);
-            std::swap(x0, x1);
-        }
-        if(y1 > y2)
-        {
-            std::swap(y2, y1);
-            std::swap(x2, x1);
-        }
-        if(y0 > y1)
+        auto scope = profiler_.Measure(ProfileMetric::FillTriangle);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::FillTriangle(
+               x0, y0, x1, y1, x2, y2, color, alpha)))
         {
-            std::swap(y0, y1);
-            std::swap(x0, x1);
-        }
-
-        if(y0 == y2)
-        { // Handle awkward all-on-same-line case as its own thing
-            a = b = x0;
-            if(x1 < a)
-                a = x1;
-            else if(x1 > b)
-                b = x1;
-            if(x2 < a)
-                a = x2;
-            else if(x2 > b)
-                b = x2;
-            DrawHLine(a, y0, b - a + 1, color, alpha);
             return;
         }
+#endif
+        dirty_.Add(std::min({x0, x1, x2}),
+                   std::min({y0, y1, y2}),
+                   std::max({x0, x1, x2}),
+                   std::max({y0, y1, y2}));
+        PolygonRaster::Triangle(
+            x0, y0, x1, y1, x2, y2, Scissor(), SolidSpans{*this, color, alpha});
+    }
 
-        int16_t dx01 = x1 - x0, dy01 = y1 - y0, dx02 = x2 - x0, dy02 = y2 - y0,
-                dx12 = x2 - x1, dy12 = y2 - y1;
-        int32_t sa = 0, sb = 0;
-
-        // For upper part of triangle, find scanline crossings for segments
-        // 0-1 and 0-2.  If y1=y2 (flat-bottomed triangle), the scanline y1
-        // is included here (and second loop will be skipped, avoiding a /0
-        // error there), otherwise scanline y1 is skipped here and handled
-        // in the second loop...which also avoids a /0 error here if y0=y1
-        // (flat-topped triangle).
-        if(y1 == y2)
-        {
-            last = y1; // Include y1 scanline
-        }
-        else
+    /**
+     * @brief Fills a convex polygon, filling pixels the way FillTriangle()
+     * does, so one drawn as a fan of triangles comes out the same. The
+     * points are read in place and, with ILI9341_BAND_RENDERER, must stay as
+     * they are until the frame is sent.
+     */
+    void FillPolygon(const PolygonRaster::Vertex* points,
+                     uint8_t                      count,
+                     uint8_t                      color,
+                     uint8_t                      alpha = 255)
+    {
+        auto scope = profiler_.Measure(ProfileMetric::Polygon);
+        if(count < 3)
         {
-            last = y1 - 1; // Skip it
+            return;
         }
-
-        for(y = y0; y <= last; y++)
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Polygon(points, count, color, alpha)))
         {
-            a = x0 + sa / dy01;
-            b = x0 + sb / dy02;
-            sa += dx01;
-            sb += dx02;
-            /* longhand:
-            a = x0 + (x1 - x0) * (y - y0) / (y1 - y0);
-            b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-            */
-            if(a > b)
-            {
-                std::swap(a, b);
-            }
-            DrawHLine(a, y, b - a + 1, color, alpha);
+            return;
         }
-
-        // For lower part of triangle, find scanline crossings for segments
-        // 0-2 and 1-2.  This loop is skipped if y1=y2.
-        sa = (int32_t)dx12 * (y - y1);
-        sb = (int32_t)dx02 * (y - y0);
-        for(; y <= y2; y++)
+#endif
+        int16_t left = points[0].x, top = points[0].y;
+        int16_t right = left, bottom = top;
+        for(uint8_t i = 1; i < count; i++)
         {
-            a = x1 + sa / dy12;
-            b = x0 + sb / dy02;
-            sa += dx12;
-            sb += dx02;
-            /* longhand:
-                a = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
-                b = x0 + (x2 - x0) * (y - y0) / (y2 - y0);
-            */
-            if(a > b)
-            {
-                std::swap(a, b);
-            }
-            DrawHLine(a, y, b - a + 1, color, alpha);
+            left   = std::min(left, points[i].x);
+            top    = std::min(top, points[i].y);
+            right  = std::max(right, points[i].x);
+            bottom = std::max(bottom, points[i].y);
         }
+        dirty_.Add(left, top, right, bottom);
+        PolygonRaster::Convex(
+            points, count, Scissor(), SolidSpans{*this, color, alpha});
     }
 
     void WriteString(const char* str,
@@ -219,6 +266,20 @@ class ILI9341UiDriver : public _UiDriver
                      UIFont      font,
                      uint8_t     color) override
     {
+        auto scope = profiler_.Measure(ProfileMetric::Text);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::String(
+                      x, y, font, GetStringWidth(str, font), color),
+                  str))
+        {
+            return;
+        }
+#endif
+        dirty_.Add(x,
+                   y,
+                   x + GetStringWidth(str, font) - 1,
+                   y + font.FontHeight - 1);
+
         SetCursor(x, y);
         while(*str) // Write until null-byte
         {
@@ -245,21 +306,31 @@ class ILI9341UiDriver : public _UiDriver
 
     void DrawCircle(int16_t x0, int16_t y0, int16_t r, uint8_t color)
     {
+        auto scope = profiler_.Measure(ProfileMetric::Circle);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Circle(x0, y0, r, color)))
+        {
+            return;
+        }
+#endif
         int16_t f     = 1 - r;
         int16_t ddF_x = 1;
         int16_t ddF_y = -2 * r;
         int16_t x     = 0;
         int16_t y     = r;
 
-        DrawPixel(x0, y0 + r, color);
-        DrawPixel(x0, y0 - r, color);
-        DrawPixel(x0 + r, y0, color);
-        DrawPixel(x0 - r, y0, color);
+        dirty_.Add(x0 - r, y0 - r, x0 + r, y0 + r);
+
+        // Points sharing a y in the loop below are a horizontal run in the
+        // top and bottom octants and a vertical one in the side octants.
+        int16_t run = 0;
 
         while(x < y)
         {
             if(f >= 0)
             {
+                DrawCircleRuns(x0, y0, run, x, y, color);
+                run = x + 1;
                 y--;
                 ddF_y += 2;
                 f += ddF_y;
@@ -267,21 +338,21 @@ class ILI9341UiDriver : public _UiDriver
             x++;
             ddF_x += 2;
             f += ddF_x;
-
-            DrawPixel(x0 + x, y0 + y, color);
-            DrawPixel(x0 - x, y0 + y, color);
-            DrawPixel(x0 + x, y0 - y, color);
-            DrawPixel(x0 - x, y0 - y, color);
-            DrawPixel(x0 + y, y0 + x, color);
-            DrawPixel(x0 - y, y0 + x, color);
-            DrawPixel(x0 + y, y0 - x, color);
-            DrawPixel(x0 - y, y0 - x, color);
         }
+        DrawCircleRuns(x0, y0, run, x, y, color);
     }
 
     void FillCircle(int16_t x0, int16_t y0, int16_t r, uint8_t color)
     {
-        DrawLine(x0, y0, x0, y0 + 2 * r + 1, color);
+        auto scope = profiler_.Measure(ProfileMetric::FillCircle);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::FillCircle(x0, y0, r, color)))
+        {
+            return;
+        }
+#endif
+        dirty_.Add(x0 - r, y0 - r, x0 + r, y0 + 2 * r + 1);
+        DrawColumn(x0, y0, y0 + 2 * r + 1, color);
         FillCircleHelper(x0, y0, r, 3, 0, color);
     }
 
@@ -312,340 +383,1297 @@ class ILI9341UiDriver : public _UiDriver
             ddF_x += 2;
             f += ddF_x;
 
+            // Columns are signed, unlike DrawLine(), so circles partly above
+            // the screen don't wrap around to its bottom
             if(cornername & 0x1)
             {
-                DrawLine(
-                    x0 + x, y0 - y, x0 + x, y0 - y + 2 * y + delta - 1, color);
-                DrawLine(
-                    x0 + y, y0 - x, x0 + y, y0 - x + 2 * x + delta - 1, color);
+                DrawColumn(x0 + x, y0 - y, y0 + y + delta - 1, color);
+                DrawColumn(x0 + y, y0 - x, y0 + x + delta - 1, color);
             }
             if(cornername & 0x2)
             {
-                DrawLine(
-                    x0 - x, y0 - y, x0 - x, y0 - y + 2 * y + delta - 1, color);
-                DrawLine(
-                    x0 - y, y0 - x, x0 - y, y0 - x + 2 * x + delta - 1, color);
+                DrawColumn(x0 - x, y0 - y, y0 + y + delta - 1, color);
+                DrawColumn(x0 - y, y0 - x, y0 + x + delta - 1, color);
             }
         }
     }
 
-    void Update() override
-    {
-        transport_.SendDataDMA();
-        UpdateFrameRate();
-    }
-
-    bool IsRender() override
+    /**
+     * @brief Anti-aliased line, pixels along it are blended by how close it
+     * passes. Costs about twice the pixels of DrawLine(), all blended.
+     */
+    void DrawLineAA(int16_t x1,
+                    int16_t y1,
+                    int16_t x2,
+                    int16_t y2,
+                    uint8_t color,
+                    uint8_t alpha = 255)
     {
-        if(transport_.dma_busy == false)
+        auto scope = profiler_.Measure(ProfileMetric::Line);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::LineAA(x1, y1, x2, y2, color, alpha)))
         {
-            // diff = System::GetNow() - screen_update_last_;
-            // if(diff > screen_update_period_) {}
-            // screen_update_last_ = System::GetNow();
-            return true;
+            return;
         }
-
-        return false;
+#endif
+        dirty_.Add(std::min(x1, x2) - 1,
+                   std::min(y1, y2) - 1,
+                   std::max(x1, x2) + 1,
+                   std::max(y1, y2) + 1);
+        CoverageRaster::Line(x1, y1, x2, y2, CoverageSpans{*this, color, alpha});
     }
 
-    void UpdateFrameRate()
+    /**
+     * @brief Anti-aliased circle of radius r, thickness pixels wide
+     * centered on it.
+     */
+    void DrawCircleAA(int16_t x0,
+                      int16_t y0,
+                      int16_t r,
+                      uint8_t color,
+                      uint8_t thickness = 1,
+                      uint8_t alpha     = 255)
     {
-        ++frames;
-        if(System::GetNow() - fps_update_last_ > 1000)
-        {
-            fps              = frames;
-            frames           = 0;
-            fps_update_last_ = System::GetNow();
-        }
+        auto scope = profiler_.Measure(ProfileMetric::Circle);
+        DrawArcAA(x0, y0, r, thickness, 0, 360, color, alpha);
     }
 
-    uint16_t Fps() const override { return fps; }
-
-  private:
-    void Start() { transport_.SetAddressWindow(0, 0, width - 1, height - 1); }
-
-    void DrawPixel(uint_fast16_t x,
-                   uint_fast16_t y,
-                   uint8_t       color,
-                   uint8_t       alpha = 255)
+    // Anti-aliased disc, covering the pixels FillCircle() does
+    void FillCircleAA(int16_t x0,
+                      int16_t y0,
+                      int16_t r,
+                      uint8_t color,
+                      uint8_t alpha = 255)
     {
-        if(x >= width || y >= height)
-            return;
-
-        auto id = 2 * (x + y * width);
-
-        // NOTE: Probably we should check the color id before accessing the array
-        transport_.PaintPixel(id, color, alpha);
-
-        // Lets divide the whole screen in 10 sectors, 32 pixel high each
-        // uint8_t screen_sector     = y / 32;
-        // dirty_buff[screen_sector] = 1;
+        auto scope = profiler_.Measure(ProfileMetric::FillCircle);
+        DrawRing(x0, y0, r * 16 + 8, 0, 0, 360, color, alpha);
     }
 
-    enum class Orientation
+    /**
+     * @brief Anti-aliased arc of radius r and thickness pixels, from angle
+     * start to end in degrees, clockwise from 3 o'clock. A knob's value arc
+     * from 7 to 5 o'clock is e.g. start 135, end 135 + 270 * value.
+     */
+    void DrawArcAA(int16_t x0,
+                   int16_t y0,
+                   int16_t r,
+                   uint8_t thickness,
+                   int16_t start,
+                   int16_t end,
+                   uint8_t color,
+                   uint8_t alpha = 255)
     {
-        Default = 0,
-        RRight,
-        RLeft,
-        UpsideDown,
-    };
+        auto scope = profiler_.Measure(ProfileMetric::Circle);
+        DrawRing(x0,
+                 y0,
+                 r * 16 + thickness * 8,
+                 r * 16 - thickness * 8,
+                 start,
+                 end,
+                 color,
+                 alpha);
+    }
 
-    // FIXME: Maybe use approach from https://github.com/MarlinFirmware/Marlin/blob/273cbc6871491a3c1c5eff017c3ccc5ce56bb123/Marlin/src/lcd/tft_io/ili9341.h#L140
-    void InitDriver()
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+    /**
+     * @brief Draws an RleImage with its top left corner at x, y, decoding it
+     * a row at a time from where it is stored, which it must stay in until
+     * it is sent. Long opaque literals of RGB565 images are converted by the
+     * DMA2D straight from there, and so are translucent ones with the native
+     * frame buffer of ILI9341_SPI_16BIT. Not available with
+     * ILI9341_INDEXED_FRAMEBUFFER.
+     */
+    void DrawImage(const uint8_t* image,
+                   int16_t        x,
+                   int16_t        y,
+                   uint8_t        alpha = 255)
     {
-        transport_.Init();
-
-        SetOrientation(Orientation::RLeft);
-
-        transport_.Reset();
-
-        //Software Reset
-        transport_.SendCommand(0x01);
-        // System::Delay(100); // TODO: maybe less?
-
-        // command list is based on https://github.com/martnak/STM32-ILI9341
-
-        // POWER CONTROL A
-        transport_.SendCommand(0xCB);
+        auto     scope = profiler_.Measure(ProfileMetric::Image);
+        RleImage rle(image);
+        if(!rle.IsValid() || alpha == 0)
         {
-            uint8_t data[5] = {0x39, 0x2C, 0x00, 0x34, 0x02};
-            transport_.SendData(data, 5);
+            return;
         }
-
-        // POWER CONTROL B
-        transport_.SendCommand(0xCF);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Image(
+               x, y, rle.Width(), rle.Height(), image, alpha)))
         {
-            uint8_t data[3] = {0x00, 0xC1, 0x30};
-            transport_.SendData(data, 3);
+            return;
         }
+#endif
+        dirty_.Add(x, y, x + rle.Width() - 1, y + rle.Height() - 1);
+        BlitImage(rle, x, y, alpha);
+    }
+#endif
 
-        // DRIVER TIMING CONTROL A
-        transport_.SendCommand(0xE8);
-        {
-            uint8_t data[3] = {0x85, 0x00, 0x78};
-            transport_.SendData(data, 3);
-        }
+    /**
+     * @brief Fills count columns from x on, column x + i over spans[i], in
+     * one call, e.g. the min/max envelope of a waveform. The spans are read
+     * in place and, with ILI9341_BAND_RENDERER, must stay as they are until
+     * the frame is sent.
+     */
+    void DrawColumns(int16_t           x,
+                     const ColumnSpan* spans,
+                     uint16_t          count,
+                     uint8_t           color,
+                     uint8_t           alpha = 255)
+    {
+        auto scope = profiler_.Measure(ProfileMetric::Columns);
 
-        // DRIVER TIMING CONTROL B
-        transport_.SendCommand(0xEA);
+        // Bounds of the spans there are
+        int16_t left = width, top = height, right = -1, bottom = -1;
+        for(uint16_t i = 0; i < count; i++)
         {
-            uint8_t data[2] = {0x00, 0x00};
-            transport_.SendData(data, 2);
+            if(spans[i].top <= spans[i].bottom)
+            {
+                left   = std::min<int16_t>(left, x + i);
+                right  = x + i;
+                top    = std::min(top, spans[i].top);
+                bottom = std::max(bottom, spans[i].bottom);
+            }
         }
-
-        // POWER ON SEQUENCE CONTROL
-        transport_.SendCommand(0xED);
+        if(left > right)
         {
-            uint8_t data[4] = {0x64, 0x03, 0x12, 0x81};
-            transport_.SendData(data, 4);
+            return;
         }
-
-        // PUMP RATIO CONTROL
-        transport_.SendCommand(0xF7);
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Columns(
+               x, spans, count, left, top, right, bottom, color, alpha)))
         {
-            uint8_t data[1] = {0x20};
-            transport_.SendData(data, 1);
+            return;
         }
-
-        // POWER CONTROL,VRH[5:0]
-        transport_.SendCommand(0xC0);
+#endif
+        dirty_.Add(left, top, right, bottom);
+
+        // Columns are too narrow for the DMA2D to pay off, so the CPU fills
+        // them all without waiting for it in between
+        dma2d_.Flush();
+        int16_t first = std::max<int16_t>(left, 0) - x;
+        int16_t last  = std::min<int16_t>(right, width - 1) - x;
+        for(int16_t i = first; i <= last; i++)
         {
-            uint8_t data[1] = {0x23};
-            transport_.SendData(data, 1);
+            auto y0 = std::max<int16_t>(spans[i].top, clip_top_);
+            auto y1 = std::min<int16_t>(spans[i].bottom, clip_bottom_ - 1);
+            if(y0 <= y1)
+            {
+                transport_.FillColumn(x + i, y0, y1, color, alpha);
+            }
         }
+    }
 
-        // POWER CONTROL,SAP[2:0];BT[3:0]
-        transport_.SendCommand(0xC1);
-        {
-            uint8_t data[1] = {0x10};
-            transport_.SendData(data, 1);
-        }
+    /**
+     * How the next draw buffer catches up with the frame just sent, when
+     * built with ILI9341_DOUBLE_BUFFER.
+     */
+    enum class BufferSync
+    {
+        CopyForward,  // DMA2D copy of the whole frame
+        DamageReplay, // DMA2D copy of the areas drawn in the last frame only
+    };
 
-        // VCM CONTROL
-        transport_.SendCommand(0xC5);
+    /**
+     * @brief Sends what was drawn since the last call. With a render budget
+     * (SetRenderBudget()) it only queues the frame, and IsRender() renders
+     * it a slice per call.
+     */
+    void Update() override
+    {
+        if(!frame_pending_)
         {
-            uint8_t data[2] = {0x3E, 0x28};
-            transport_.SendData(data, 2);
+            frame_pending_ = true;
+            frame_started_ = false;
         }
-
-        // VCM CONTROL 2
-        transport_.SendCommand(0xC7);
+        if(!slicer_.IsLimited())
         {
-            uint8_t data[1] = {0x86};
-            transport_.SendData(data, 1);
+            RenderSlice();
         }
+    }
 
-        // MEMORY ACCESS CONTROL
-        transport_.SendCommand(0x36);
-        {
-            uint8_t data[1] = {0x48};
-            transport_.SendData(data, 1);
-        }
+    /**
+     * @brief Microseconds IsRender() may spend rendering per call, see
+     * RenderSlicer. 0 (default) renders each frame in one go in Update().
+     */
+    void SetRenderBudget(uint32_t us) { slicer_.SetBudget(us); }
 
-        // PIXEL FORMAT
-        transport_.SendCommand(0x3A);
-        {
-            uint8_t data[1] = {0x55};
-            transport_.SendData(data, 1);
-        }
+    const RenderSlicer& Slicer() const { return slicer_; }
+
+    RenderSlicer& Slicer() { return slicer_; }
 
-        // FRAME RATIO CONTROL, STANDARD RGB COLOR
-        transport_.SendCommand(0xB1);
+    // Works on the pending frame until it is out or the budget is used up
+    void RenderSlice()
+    {
+        slicer_.Begin(System::GetUs());
+        if(!frame_started_)
         {
-            uint8_t data[2] = {0x00, 0x18};
-            transport_.SendData(data, 2);
+            // Queued DMA2D work must land before the frame goes out
+            if(slicer_.IsLimited() && !dma2d_.IsIdle())
+            {
+                slicer_.End(System::GetUs());
+                return;
+            }
+#ifndef ILI9341_BAND_RENDERER
+            CompositeSprites();
+#endif
+            dma2d_.Flush();
+            EndProfilerFrame();
+            pacer_.FrameStarted(System::GetUs());
+            swapped_ = transport_.SwapBuffers();
+
+            ApplyScroll();
+
+#ifdef ILI9341_BAND_RENDERER
+            StartBands();
+#else
+            if(partial_update_)
+            {
+                bool synced = pacer_.GetSync() != FramePacer::Sync::None;
+                transport_.SendDataDMA(dirty_, synced);
+            }
+            else
+            {
+                transport_.SendDataDMA();
+            }
+#endif
+            frame_started_ = true;
         }
 
-        // DISPLAY FUNCTION CONTROL
-        transport_.SendCommand(0xB6);
+#ifdef ILI9341_BAND_RENDERER
+        if(!RenderBands())
         {
-            uint8_t data[3] = {0x08, 0x82, 0x27};
-            transport_.SendData(data, 3);
+            slicer_.End(System::GetUs());
+            return;
         }
+#endif
 
-        // 3GAMMA FUNCTION DISABLE
-        transport_.SendCommand(0xF2);
+        if(swapped_)
         {
-            uint8_t data[1] = {0x00};
-            transport_.SendData(data, 1);
+            dma2d_.SetBuffer(transport_.draw_buffer);
+            SyncDrawBuffer();
+#ifndef ILI9341_BAND_RENDERER
+            RestoreSprites();
+#endif
         }
 
-        // GAMMA CURVE SELECTED
-        transport_.SendCommand(0x26);
+        dirty_.Clear();
+        UpdateFrameRate();
+        frame_pending_ = false;
+        slicer_.End(System::GetUs());
+    }
+
+    // Nothing is on the bus now, so scrolling can be applied
+    void ApplyScroll()
+    {
+        if(scroll_area_changed_)
         {
-            uint8_t data[1] = {0x01};
-            transport_.SendData(data, 1);
+            transport_.SetScrollArea(
+                scroll_x_, scroll_width_, width - scroll_x_ - scroll_width_);
+            scroll_area_changed_ = false;
         }
-
-        // POSITIVE GAMMA CORRECTION
-        transport_.SendCommand(0xE0);
-        {
-            uint8_t data[15] = {0x0F,
-                                0x31,
-                                0x2B,
-                                0x0C,
-                                0x0E,
-                                0x08,
-                                0x4E,
-                                0xF1,
-                                0x37,
-                                0x07,
-                                0x10,
-                                0x03,
-                                0x0E,
-                                0x09,
-                                0x00};
-            transport_.SendData(data, 15);
+        if(scroll_changed_)
+        {
+            transport_.SetScrollStart(scroll_x_ + scroll_offset_);
+            scroll_changed_ = false;
         }
+    }
 
-        // NEGATIVE GAMMA CORRECTION
-        transport_.SendCommand(0xE1);
-        {
-            uint8_t data[15] = {0x00,
-                                0x0E,
-                                0x14,
-                                0x03,
-                                0x11,
-                                0x07,
-                                0x31,
-                                0xC1,
-                                0x48,
-                                0x08,
-                                0x0F,
-                                0x0C,
-                                0x31,
-                                0x36,
-                                0x0F};
-            transport_.SendData(data, 15);
-        }
-
-        // EXIT SLEEP
-        transport_.SendCommand(0x11);
-        System::Delay(10);
-
-        // TURN ON DISPLAY
-        transport_.SendCommand(0x29);
-
-        // MADCTL
-        transport_.SendCommand(0x36);
-        System::Delay(10);
+#ifdef ILI9341_BAND_RENDERER
+    static constexpr uint16_t band_height = ILI9341SpiTransport::band_height;
+    static constexpr uint8_t  num_bands   = height / band_height;
 
+    // Works out the columns each band of the frame sends
+    void StartBands()
+    {
+        for(uint8_t b = 0; b < num_bands; b++)
         {
-            uint8_t data[1] = {rotation};
-            transport_.SendData(data, 1);
+            band_x0_[b] = partial_update_ ? width : 0;
+            band_x1_[b] = partial_update_ ? -1 : width - 1;
         }
-    };
+        for(uint8_t i = 0; i < dirty_.Count(); i++)
+        {
+            auto& area = dirty_[i];
+            for(int b = area.y0 / band_height; b <= area.y1 / band_height; b++)
+            {
+                band_x0_[b] = std::min<int16_t>(band_x0_[b], area.x0);
+                band_x1_[b] = std::max<int16_t>(band_x1_[b], area.x1);
+            }
+        }
+        band_    = 0;
+        command_ = 0;
+    }
 
-    void SetOrientation(Orientation ori)
+    /**
+     * @brief Replays the display list into each damaged band and sends it,
+     * drawing the next band while the previous one is on the wire. Returns
+     * true once the last band is queued, false if the slice budget ran out
+     * or, with a budget, the previous band is still being sent; the next
+     * call picks up from there.
+     */
+    bool RenderBands()
     {
-        uint8_t ili_bgr = 0x08;
-        uint8_t ili_mx  = 0x40;
-        uint8_t ili_my  = 0x80;
-        uint8_t ili_mv  = 0x20;
-        switch(ori)
+        replaying_ = true;
+        for(; band_ < num_bands; band_++)
         {
-            case Orientation::RRight:
+            uint8_t b = band_;
+            if(band_x0_[b] > band_x1_[b])
             {
-                width    = 320;
-                height   = 240;
-                rotation = ili_mx | ili_my | ili_mv | ili_bgr;
-                return;
+                continue;
             }
-            case Orientation::RLeft:
+            if(command_ == 0)
             {
-                width    = 320;
-                height   = 240;
-                rotation = ili_mv | ili_bgr;
-                return;
+                // The transport would send the columns nobody drew otherwise
+                if(ILI9341SpiTransport::SendsFullWidth(band_x1_[b] - band_x0_[b]
+                                                       + 1))
+                {
+                    band_x0_[b] = 0;
+                    band_x1_[b] = width - 1;
+                }
+
+                transport_.BeginBand(b * band_height);
+                memset(transport_.draw_buffer,
+                       0,
+                       ILI9341SpiTransport::band_size);
             }
-            case Orientation::UpsideDown:
+            clip_top_    = b * band_height;
+            clip_bottom_ = clip_top_ + band_height;
+            for(; command_ < list_.Count(); command_++)
             {
-                width    = 240;
-                height   = 320;
-                rotation = ili_my | ili_bgr;
-                return;
+                if(slicer_.Expired(System::GetUs()))
+                {
+                    replaying_ = false;
+                    return false;
+                }
+                if(list_[command_].Overlaps(
+                       band_x0_[b], clip_top_, band_x1_[b], clip_bottom_ - 1))
+                {
+                    Replay(list_[command_]);
+                }
             }
-            default:
+
+            if(transport_.dma_busy && slicer_.IsLimited())
             {
-                width    = 240;
-                height   = 320;
-                rotation = ili_mx | ili_bgr;
-            };
+                replaying_ = false;
+                return false;
+            }
+            while(transport_.dma_busy) {}
+            transport_.SendBandDMA(band_x0_[b], band_x1_[b]);
+            command_ = 0;
         }
+        replaying_ = false;
+        return true;
     }
 
-
-    void DrawVLine(int16_t x,
-                   int16_t y,
-                   int16_t h,
-                   uint8_t color,
-                   uint8_t alpha = 255)
+    // Outside of Update() drawing calls are only recorded, see DisplayList
+    bool Record(DisplayList::Command cmd, const char* text = nullptr)
     {
-        if(alpha == 255)
+        if(replaying_)
         {
-            return dma2d_.FillRect(Rectangle(x, y, 1, h), color, alpha);
+            return false;
         }
-
-        for(int16_t i = y; i < y + h; i++)
+        if(cmd.Clip(width, height))
         {
-            DrawPixel(x, i, color, alpha);
+            dirty_.Add(cmd.left, cmd.top, cmd.right, cmd.bottom);
+            list_.Add(cmd, text);
         }
+        return true;
     }
 
-    void DrawHLine(int16_t x,
-                   int16_t y,
-                   int16_t w,
-                   uint8_t color,
-                   uint8_t alpha = 255)
+    void Replay(const DisplayList::Command& cmd)
     {
-        if(alpha == 255)
+        switch(cmd.op)
         {
-            return dma2d_.FillRect(Rectangle(x, y, w, 1), color, alpha);
+            case DisplayList::Op::Line:
+                DrawLine(cmd.x0, cmd.y0, cmd.x1, cmd.y1, cmd.color, cmd.alpha);
+                break;
+            case DisplayList::Op::Rect:
+                DrawRect(cmd.x0, cmd.y0, cmd.x1, cmd.y1, cmd.color, cmd.alpha);
+                break;
+            case DisplayList::Op::FillRect:
+                FillRect(Rectangle(cmd.x0, cmd.y0, cmd.x1, cmd.y1),
+                         cmd.color,
+                         cmd.alpha);
+                break;
+            case DisplayList::Op::FillTriangle:
+                FillTriangle(cmd.x0,
+                             cmd.y0,
+                             cmd.x1,
+                             cmd.y1,
+                             cmd.x2,
+                             cmd.y2,
+                             cmd.color,
+                             cmd.alpha);
+                break;
+            case DisplayList::Op::Polygon:
+                FillPolygon(cmd.points, cmd.x0, cmd.color, cmd.alpha);
+                break;
+            case DisplayList::Op::Circle:
+                DrawCircle(cmd.x0, cmd.y0, cmd.x1, cmd.color);
+                break;
+            case DisplayList::Op::FillCircle:
+                FillCircle(cmd.x0, cmd.y0, cmd.x1, cmd.color);
+                break;
+            case DisplayList::Op::String:
+                WriteString(
+                    list_.Text(cmd), cmd.x0, cmd.y0, cmd.Font(), cmd.color);
+                break;
+            case DisplayList::Op::LineAA:
+                DrawLineAA(
+                    cmd.x0, cmd.y0, cmd.x1, cmd.y1, cmd.color, cmd.alpha);
+                break;
+            case DisplayList::Op::Ring:
+                DrawRing(cmd.x0,
+                         cmd.y0,
+                         cmd.x1,
+                         cmd.y1,
+                         cmd.x2,
+                         cmd.y2,
+                         cmd.color,
+                         cmd.alpha);
+                break;
+            case DisplayList::Op::Image:
+                DrawImage(cmd.image, cmd.x0, cmd.y0, cmd.alpha);
+                break;
+            case DisplayList::Op::Columns:
+                DrawColumns(cmd.x0, cmd.spans, cmd.x1, cmd.color, cmd.alpha);
+                break;
         }
-        for(int16_t i = x; i < x + w; i++)
+    }
+#endif
+
+    /**
+     * @brief Marks an area to be sent on the next Update(), for content
+     * written to the frame buffer behind the driver's back.
+     */
+    void Invalidate(const Rectangle& rect)
+    {
+        if(rect.GetWidth() <= 0 || rect.GetHeight() <= 0)
         {
-            DrawPixel(i, y, color, alpha);
+            return;
         }
+        dirty_.Add(rect.GetX(),
+                   rect.GetY(),
+                   rect.GetRight() - 1,
+                   rect.GetBottom() - 1);
+    }
+
+#ifndef ILI9341_BAND_RENDERER
+    /**
+     * @brief Lays sprite over the frame from the next Update() on, above the
+     * sprites added before it. Returns false if there are
+     * ILI9341_MAX_SPRITES already. Not available with ILI9341_BAND_RENDERER,
+     * which has no frame buffer to save from.
+     */
+    bool AddSprite(Sprite& sprite)
+    {
+        if(num_sprites_ == ILI9341_MAX_SPRITES)
+        {
+            return false;
+        }
+        sprite.changed_          = true;
+        sprites_[num_sprites_++] = &sprite;
+        return true;
+    }
+
+    void RemoveSprite(Sprite& sprite)
+    {
+        auto end = sprites_ + num_sprites_;
+        auto it  = std::find(sprites_, end, &sprite);
+        if(it != end)
+        {
+            std::copy(it + 1, end, it);
+            num_sprites_--;
+            Invalidate(sprite.drawn_);
+            sprite.drawn_ = Rectangle();
+        }
+    }
+#endif
+
+    /**
+     * @brief When enabled (default) Update() only sends the areas touched
+     * since the last Update(), otherwise the whole frame buffer.
+     */
+    void SetPartialUpdate(bool enable) { partial_update_ = enable; }
+
+    void SetBufferSync(BufferSync sync) { buffer_sync_ = sync; }
+
+#ifdef ILI9341_BAND_RENDERER
+    /**
+     * @brief Drawing calls lost because the display list was full.
+     */
+    uint32_t Dropped() const { return list_.Dropped(); }
+#endif
+
+    /**
+     * @brief Changes a palette entry to an RGB565 color. With
+     * ILI9341_INDEXED_FRAMEBUFFER or ILI9341_BAND_RENDERER everything already
+     * drawn with it changes too, on the next Update().
+     */
+    void SetPaletteColor(uint8_t color_id, uint16_t color)
+    {
+        transport_.tftPalette[color_id] = color;
+        dma2d_.tftPalette[color_id]     = color;
+        if(indexed_ || banded_)
+        {
+            dirty_.MarkAll();
+        }
+    }
+
+    /**
+     * @brief Makes all but fixed_left and fixed_right columns scroll in
+     * hardware. The panel scrolls along its scan lines, which are the screen
+     * columns in this landscape orientation.
+     */
+    void SetScrollArea(uint16_t fixed_left, uint16_t fixed_right)
+    {
+        if(fixed_left + fixed_right >= width)
+        {
+            return;
+        }
+        scroll_x_            = fixed_left;
+        scroll_width_        = width - fixed_left - fixed_right;
+        scroll_offset_       = 0;
+        scroll_area_changed_ = true;
+        scroll_changed_      = true;
+    }
+
+    /**
+     * @brief Moves the scroll area content left by columns, or right when
+     * negative, on the next Update(). Nothing is transferred for it, the
+     * columns coming into view show what just went out on the other side
+     * until they are drawn over.
+     *
+     * The scrolled columns are a ring in the frame buffer, so drawing in the
+     * scroll area goes through ScrollColumn().
+     */
+    void Scroll(int16_t columns)
+    {
+        if(scroll_width_ == 0)
+        {
+            return;
+        }
+        int32_t offset  = (scroll_offset_ + columns) % scroll_width_;
+        scroll_offset_  = offset < 0 ? offset + scroll_width_ : offset;
+        scroll_changed_ = true;
+    }
+
+    /**
+     * @brief Frame buffer column shown at screen column x.
+     */
+    uint16_t ScrollColumn(uint16_t x) const
+    {
+        if(x < scroll_x_ || x >= scroll_x_ + scroll_width_)
+        {
+            return x;
+        }
+        return scroll_x_ + (x - scroll_x_ + scroll_offset_) % scroll_width_;
+    }
+
+    /**
+     * @brief True once the last frame is sent and, depending on the frame
+     * sync and fps cap, the next one may start. With a render budget it
+     * renders the next slice of the frame Update() queued first, so keep
+     * calling it and don't draw until it says true.
+     */
+    bool IsRender() override
+    {
+        if(frame_pending_)
+        {
+            RenderSlice();
+        }
+#ifndef ILI9341_BAND_RENDERER
+        // With one buffer the sprites come out of it once it is sent
+        if(sprites_drawn_ && !frame_pending_ && !transport_.dma_busy)
+        {
+            RestoreSprites();
+        }
+#endif
+        bool ready = !frame_pending_ && transport_.dma_busy == false
+                     && pacer_.Ready(System::GetUs(),
+                                     [this] { return InSync(); });
+        profiler_.Waiting(!ready);
+        return ready;
+    }
+
+    /**
+     * @brief Starts frames in step with the panel's refresh, see FramePacer.
+     * Sync::TearingPin needs SetTearingPin() first, and Sync::Scanline
+     * SetScanlinePin().
+     */
+    void SetFrameSync(FramePacer::Sync sync) { pacer_.SetSync(sync); }
+
+    /**
+     * @brief Turns on the panel's TE output, wired to pin, and syncs frames
+     * to it.
+     */
+    void SetTearingPin(Pin pin)
+    {
+        transport_.InitTearingPin(pin);
+        pacer_.SetSync(FramePacer::Sync::TearingPin);
+    }
+
+    /**
+     * @brief Reads the refresh position from the panel, its SDO wired to
+     * miso (a MISO pin of SPI_1, D9 on the Seed), and syncs frames to it.
+     */
+    void SetScanlinePin(Pin miso)
+    {
+        transport_.InitScanlineRead(miso);
+        pacer_.SetSync(FramePacer::Sync::Scanline);
+    }
+
+    /**
+     * @brief Limits IsRender() to fps frames per second, 0 for no limit.
+     */
+    void SetFpsCap(uint16_t fps) { pacer_.SetFpsCap(fps); }
+
+    void UpdateFrameRate()
+    {
+        ++frames;
+        if(System::GetNow() - fps_update_last_ > 1000)
+        {
+            fps              = frames;
+            frames           = 0;
+            fps_update_last_ = System::GetNow();
+        }
+    }
+
+    uint16_t Fps() const override { return fps; }
+
+#ifdef ILI9341_PROFILER
+    /**
+     * @brief Timings of the last frames, built with ILI9341_PROFILER.
+     */
+    const FrameProfiler& Profiler() const { return profiler_; }
+
+    FrameProfiler& Profiler() { return profiler_; }
+#endif
+
+  private:
+    // Whether the refresh just started a new pass, for FramePacer
+    bool InSync()
+    {
+        if(pacer_.GetSync() == FramePacer::Sync::TearingPin)
+        {
+            return transport_.TearingEffect();
+        }
+        return transport_.ReadScanline() < FramePacer::scanline_window;
+    }
+
+    void Start() { transport_.SetAddressWindow(0, 0, width - 1, height - 1); }
+
+    // Nothing is drawing or sending at the start of Update(), so the DMA2D
+    // and transport totals can be collected for the frame that just ended
+    void EndProfilerFrame()
+    {
+#ifdef ILI9341_PROFILER
+        uint32_t busy, wait;
+        dma2d_.TakeTimes(busy, wait);
+        profiler_.Add(ProfileMetric::Dma2DBusy, busy);
+        profiler_.Add(ProfileMetric::Dma2DWait, wait);
+        profiler_.Add(ProfileMetric::Spi, transport_.send_ticks);
+        profiler_.Add(ProfileMetric::SpiGap, transport_.send_gap_ticks);
+        profiler_.Add(ProfileMetric::Chunks, transport_.send_chunks);
+        profiler_.Add(ProfileMetric::Bytes, transport_.send_bytes);
+        transport_.send_ticks     = 0;
+        transport_.send_gap_ticks = 0;
+        transport_.send_chunks    = 0;
+        transport_.send_bytes     = 0;
+#endif
+        profiler_.EndFrame();
+    }
+
+    // The draw buffer still holds the frame before last, so bring over
+    // everything drawn since then from the buffer that is being sent.
+    void SyncDrawBuffer()
+    {
+        if(buffer_sync_ == BufferSync::CopyForward)
+        {
+            dma2d_.CopyRect(transport_.send_buffer, GetBounds());
+            return;
+        }
+
+        for(uint8_t i = 0; i < dirty_.Count(); i++)
+        {
+            auto& area = dirty_[i];
+            dma2d_.CopyRect(
+                transport_.send_buffer,
+                Rectangle(area.x0, area.y0, area.Width(), area.Height()));
+        }
+    }
+
+#ifndef ILI9341_BAND_RENDERER
+    // Saves what each sprite covers and draws it, damaging where a sprite was
+    // and is if it changed
+    void CompositeSprites()
+    {
+        if(sprites_drawn_)
+        {
+            // IsRender() wasn't called since the last frame
+            while(transport_.dma_busy) {}
+            RestoreSprites();
+        }
+        for(uint8_t i = 0; i < num_sprites_; i++)
+        {
+            auto& sprite = *sprites_[i];
+            auto  area   = sprite.visible_ ? OnScreen(sprite) : Rectangle();
+            if(sprite.changed_)
+            {
+                Invalidate(sprite.drawn_);
+                Invalidate(area);
+                sprite.changed_ = false;
+            }
+            sprite.drawn_ = area;
+            if(area.IsEmpty())
+            {
+                continue;
+            }
+
+            dma2d_.SaveRect(sprite.save_, area);
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+            if(sprite.image_)
+            {
+                RleImage image(sprite.image_);
+                BlitImage(image, sprite.x_, sprite.y_, sprite.alpha_);
+                continue;
+            }
+#endif
+            FillArea(area, sprite.color_, sprite.alpha_);
+        }
+        sprites_drawn_ = num_sprites_ > 0;
+    }
+
+    // Puts back what the sprites covered, last one first
+    void RestoreSprites()
+    {
+        for(uint8_t i = num_sprites_; i-- > 0;)
+        {
+            auto& sprite = *sprites_[i];
+            if(!sprite.drawn_.IsEmpty())
+            {
+                dma2d_.RestoreRect(sprite.save_, sprite.drawn_);
+            }
+        }
+        sprites_drawn_ = false;
+    }
+
+    static Rectangle OnScreen(const Sprite& sprite)
+    {
+        int16_t x0 = std::max<int16_t>(sprite.x_, 0);
+        int16_t y0 = std::max<int16_t>(sprite.y_, 0);
+        int16_t x1 = std::min<int32_t>(sprite.x_ + sprite.width_, width);
+        int16_t y1 = std::min<int32_t>(sprite.y_ + sprite.height_, height);
+        if(x0 >= x1 || y0 >= y1)
+        {
+            return Rectangle();
+        }
+        return Rectangle(x0, y0, x1 - x0, y1 - y0);
+    }
+#endif
+
+    void DrawPixel(uint_fast16_t x,
+                   uint_fast16_t y,
+                   uint8_t       color,
+                   uint8_t       alpha = 255)
+    {
+        if(x >= width || y < clip_top_ || y >= clip_bottom_)
+            return;
+
+        auto id = transport_.PixelId(x, y);
+
+        // NOTE: Probably we should check the color id before accessing the array
+        transport_.PaintPixel(id, color, alpha);
+
+        // Lets divide the whole screen in 10 sectors, 32 pixel high each
+        // uint8_t screen_sector     = y / 32;
+        // dirty_buff[screen_sector] = 1;
+    }
+
+    enum class Orientation
+    {
+        Default = 0,
+        RRight,
+        RLeft,
+        UpsideDown,
+    };
+
+    // FIXME: Maybe use approach from https://github.com/MarlinFirmware/Marlin/blob/273cbc6871491a3c1c5eff017c3ccc5ce56bb123/Marlin/src/lcd/tft_io/ili9341.h#L140
+    void InitDriver()
+    {
+        transport_.Init();
+
+        SetOrientation(Orientation::RLeft);
+
+        transport_.Reset();
+        transport_.SendCommands(init_commands, sizeof(init_commands));
+
+        // MADCTL
+        {
+            uint8_t data[1] = {rotation};
+            transport_.SendCommand(0x36);
+            transport_.SendData(data, 1);
+        }
+#ifdef ILI9341_SPI_16BIT
+        transport_.UseWordFrames();
+#endif
+    };
+
+    // Command list is based on https://github.com/martnak/STM32-ILI9341,
+    // encoded as described in CommandStream. Constant, so it stays in flash.
+    static constexpr uint8_t delay = command_delay_flag;
+    // clang-format off
+    static constexpr uint8_t init_commands[] = {
+        0x01, 0,                               // SOFTWARE RESET
+        0xCB, 5, 0x39, 0x2C, 0x00, 0x34, 0x02, // POWER CONTROL A
+        0xCF, 3, 0x00, 0xC1, 0x30,             // POWER CONTROL B
+        0xE8, 3, 0x85, 0x00, 0x78,             // DRIVER TIMING CONTROL A
+        0xEA, 2, 0x00, 0x00,                   // DRIVER TIMING CONTROL B
+        0xED, 4, 0x64, 0x03, 0x12, 0x81,       // POWER ON SEQUENCE CONTROL
+        0xF7, 1, 0x20,                         // PUMP RATIO CONTROL
+        0xC0, 1, 0x23,                         // POWER CONTROL,VRH[5:0]
+        0xC1, 1, 0x10,                         // POWER CONTROL,SAP[2:0];BT[3:0]
+        0xC5, 2, 0x3E, 0x28,                   // VCM CONTROL
+        0xC7, 1, 0x86,                         // VCM CONTROL 2
+        0x36, 1, 0x48,                         // MEMORY ACCESS CONTROL
+        0x3A, 1, 0x55,                         // PIXEL FORMAT
+        0xB1, 2, 0x00, 0x18,                   // FRAME RATIO CONTROL
+        0xB6, 3, 0x08, 0x82, 0x27,             // DISPLAY FUNCTION CONTROL
+        0xF2, 1, 0x00,                         // 3GAMMA FUNCTION DISABLE
+        0x26, 1, 0x01,                         // GAMMA CURVE SELECTED
+        // POSITIVE GAMMA CORRECTION
+        0xE0, 15, 0x0F, 0x31, 0x2B, 0x0C, 0x0E, 0x08, 0x4E, 0xF1,
+                  0x37, 0x07, 0x10, 0x03, 0x0E, 0x09, 0x00,
+        // NEGATIVE GAMMA CORRECTION
+        0xE1, 15, 0x00, 0x0E, 0x14, 0x03, 0x11, 0x07, 0x31, 0xC1,
+                  0x48, 0x08, 0x0F, 0x0C, 0x31, 0x36, 0x0F,
+        0x11, delay, 10,                       // EXIT SLEEP
+        0x29, delay, 10,                       // TURN ON DISPLAY
+    };
+    // clang-format on
+
+    // The frame buffer is laid out for 320x240, so only the landscape
+    // orientations show right side up
+    void SetOrientation(Orientation ori)
+    {
+        uint8_t ili_bgr = 0x08;
+        uint8_t ili_mx  = 0x40;
+        uint8_t ili_my  = 0x80;
+        uint8_t ili_mv  = 0x20;
+        switch(ori)
+        {
+            case Orientation::RRight:
+            {
+                rotation = ili_mx | ili_my | ili_mv | ili_bgr;
+                return;
+            }
+            case Orientation::RLeft:
+            {
+                rotation = ili_mv | ili_bgr;
+                return;
+            }
+            case Orientation::UpsideDown:
+            {
+                rotation = ili_my | ili_bgr;
+                return;
+            }
+            default:
+            {
+                rotation = ili_mx | ili_bgr;
+            };
+        }
+    }
+
+
+    // Neither DMA2D nor the transport check bounds, so clip here
+    void FillArea(const Rectangle& rect, uint8_t color, uint8_t alpha)
+    {
+        int16_t x0 = std::max<int16_t>(rect.GetX(), 0);
+        int16_t y0 = std::max<int16_t>(rect.GetY(), clip_top_);
+        int16_t x1 = std::min<int16_t>(rect.GetRight(), width);
+        int16_t y1 = std::min<int16_t>(rect.GetBottom(), clip_bottom_);
+        if(x0 >= x1 || y0 >= y1)
+        {
+            return;
+        }
+        Rectangle clipped(x0, y0, x1 - x0, y1 - y0);
+
+#if defined(ILI9341_INDEXED_FRAMEBUFFER) || defined(ILI9341_BAND_RENDERER)
+        dma2d_.Flush();
+        transport_.FillRect(clipped, color, alpha);
+#else
+#ifndef ILI9341_SPI_16BIT
+        // The DMA2D can't read the big endian frame buffer to blend
+        if(alpha != 255)
+        {
+            dma2d_.Flush();
+            transport_.FillRect(clipped, color, alpha);
+            return;
+        }
+#endif
+        dma2d_.FillRect(clipped, color, alpha);
+#endif
+    }
+
+    void DrawVLine(int16_t x,
+                   int16_t y,
+                   int16_t h,
+                   uint8_t color,
+                   uint8_t alpha = 255)
+    {
+        DrawColumn(x, y, y + h - 1, color, alpha);
+    }
+
+    void DrawHLine(int16_t x,
+                   int16_t y,
+                   int16_t w,
+                   uint8_t color,
+                   uint8_t alpha = 255)
+    {
+        DrawSpan(x, x + w - 1, y, color, alpha);
+    }
+
+    /**
+     * @brief Bresenham line from x1, y1 to x2, y2 a pixel at a time, clipped
+     * once: the steps before it comes on screen paint nothing, and it stops
+     * where it leaves, which it does only once. An edge is only checked
+     * when the coordinate facing it moves.
+     */
+    void DrawSteps(int_fast16_t x,
+                   int_fast16_t y,
+                   int_fast16_t x2,
+                   int_fast16_t y2,
+                   uint8_t      color,
+                   uint8_t      alpha)
+    {
+        auto deltaX = abs(x2 - x);
+        auto deltaY = abs(y2 - y);
+        auto signX  = x < x2 ? 1 : -1;
+        auto signY  = y < y2 ? 1 : -1;
+        auto error  = deltaX - deltaY;
+        auto steps  = std::max(deltaX, deltaY); // the major axis moves each
+
+        // Coordinates are unsigned, so only the right edge and the clip rows
+        while(x >= width || y < clip_top_ || y >= clip_bottom_)
+        {
+            if(steps-- == 0)
+            {
+                return;
+            }
+            auto error2 = error * 2;
+            if(error2 > -deltaY)
+            {
+                error -= deltaY;
+                x += signX;
+            }
+            if(error2 < deltaX)
+            {
+                error += deltaX;
+                y += signY;
+            }
+        }
+
+        dma2d_.Flush();
+        int_fast32_t top = clip_top_, bottom = clip_bottom_;
+        transport_.PaintPixels(
+            color,
+            alpha,
+            [=](auto paint) mutable
+            {
+                int_fast32_t id = transport_.PixelId(x, y);
+                paint(id);
+                for(; steps > 0; steps--)
+                {
+                    auto error2 = error * 2;
+                    if(error2 > -deltaY)
+                    {
+                        error -= deltaY;
+                        x += signX;
+                        id += signX;
+                        if(x >= width)
+                        {
+                            return;
+                        }
+                    }
+                    if(error2 < deltaX)
+                    {
+                        error += deltaX;
+                        y += signY;
+                        id += signY * width;
+                        if(y < top || y >= bottom)
+                        {
+                            return;
+                        }
+                    }
+                    paint(id);
+                }
+            });
+    }
+
+    // Runs at least this long are cheaper to hand to the DMA2D queue
+    static constexpr int_fast16_t dma2d_run = 64;
+    // Same for glyphs of at least this many pixels
+    static constexpr uint16_t dma2d_glyph = 128;
+
+    /**
+     * @brief Pixels x0..x1 of line y, clipped once for the whole run.
+     */
+    void DrawSpan(int_fast16_t x0,
+                  int_fast16_t x1,
+                  int_fast16_t y,
+                  uint8_t      color,
+                  uint8_t      alpha = 255)
+    {
+        if(x0 > x1)
+        {
+            std::swap(x0, x1);
+        }
+        if(y < clip_top_ || y >= clip_bottom_ || x1 < 0 || x0 >= width)
+        {
+            return;
+        }
+        x0 = std::max<int_fast16_t>(x0, 0);
+        x1 = std::min<int_fast16_t>(x1, width - 1);
+
+        if(alpha == 255 && dma2d_fills_ && x1 - x0 + 1 >= dma2d_run)
+        {
+            return FillArea(Rectangle(x0, y, x1 - x0 + 1, 1), color, alpha);
+        }
+        dma2d_.Flush();
+        transport_.FillSpan(x0, x1, y, color, alpha);
+    }
+
+    /**
+     * @brief Pixels y0..y1 of column x, clipped once for the whole run.
+     */
+    void DrawColumn(int_fast16_t x,
+                    int_fast16_t y0,
+                    int_fast16_t y1,
+                    uint8_t      color,
+                    uint8_t      alpha = 255)
+    {
+        if(y0 > y1)
+        {
+            std::swap(y0, y1);
+        }
+        if(x < 0 || x >= width || y1 < clip_top_ || y0 >= clip_bottom_)
+        {
+            return;
+        }
+        y0 = std::max<int_fast16_t>(y0, clip_top_);
+        y1 = std::min<int_fast16_t>(y1, clip_bottom_ - 1);
+
+        if(alpha == 255 && dma2d_fills_ && y1 - y0 + 1 >= dma2d_run)
+        {
+            return FillArea(Rectangle(x, y0, 1, y1 - y0 + 1), color, alpha);
+        }
+        dma2d_.Flush();
+        transport_.FillColumn(x, y0, y1, color, alpha);
+    }
+
+    // Radii in 1/16 pixel, see CoverageRaster::Ring()
+    void DrawRing(int16_t x0,
+                  int16_t y0,
+                  int16_t outer,
+                  int16_t inner,
+                  int16_t start,
+                  int16_t end,
+                  uint8_t color,
+                  uint8_t alpha)
+    {
+#ifdef ILI9341_BAND_RENDERER
+        if(Record(DisplayList::Ring(
+               x0, y0, outer, inner, start, end, color, alpha)))
+        {
+            return;
+        }
+#endif
+        int16_t reach = outer / 16 + 2;
+        dirty_.Add(x0 - reach, y0 - reach, x0 + reach, y0 + reach);
+        CoverageRaster::Ring(x0,
+                             y0,
+                             outer,
+                             inner,
+                             start,
+                             end,
+                             clip_top_,
+                             clip_bottom_,
+                             CoverageSpans{*this, color, alpha});
+    }
+
+    // Sink for CoverageRaster, blending its runs by coverage and alpha
+    struct CoverageSpans
+    {
+        ILI9341UiDriver& driver;
+        uint8_t          color, alpha;
+
+        void operator()(int32_t x0, int32_t x1, int32_t y, int32_t coverage)
+        {
+            uint8_t a = coverage * (alpha + 1) >> 8;
+            if(a > 0)
+            {
+                driver.DrawSpan(x0, x1, y, color, a);
+            }
+        }
+    };
+
+    // Sink for PolygonRaster, its spans come clipped already
+    struct SolidSpans
+    {
+        ILI9341UiDriver& driver;
+        uint8_t          color, alpha;
+
+        void operator()(int32_t x0, int32_t x1, int32_t y)
+        {
+            driver.DrawSpan(x0, x1, y, color, alpha);
+        }
+    };
+
+    // The screen, or the band being rendered
+    PolygonRaster::Clip Scissor() const
+    {
+        return {0,
+                static_cast<int16_t>(clip_top_),
+                width - 1,
+                static_cast<int16_t>(clip_bottom_ - 1)};
+    }
+
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+    void BlitImage(const RleImage& rle, int16_t x, int16_t y, uint8_t alpha)
+    {
+        // Rows on screen, and in the band being rendered
+        int32_t first = std::max<int32_t>(clip_top_ - y, 0);
+        int32_t last  = std::min<int32_t>(clip_bottom_ - y, rle.Height());
+
+        // The CPU writes the pixels the DMA2D doesn't
+        dma2d_.Flush();
+        for(int32_t row = first; row < last; row++)
+        {
+            int16_t line = y + row;
+            rle.DecodeRow(row, ImageSpans{*this, rle, x, line, alpha});
+        }
+    }
+
+    // Sink for RleImage::DecodeRow(), painting the packets of a row at x, y
+    struct ImageSpans
+    {
+        ILI9341UiDriver& driver;
+        const RleImage&  image;
+        int16_t          x, y;
+        uint8_t          alpha;
+
+        void operator()(RleImage::Op   op,
+                        uint16_t       at,
+                        uint16_t       count,
+                        const uint8_t* pixels)
+        {
+            int16_t x0 = x + at;
+            int16_t x1 = x0 + count - 1;
+            if(x1 < 0 || x0 >= width)
+            {
+                return;
+            }
+            uint16_t clipped = x0 < 0 ? -x0 : 0;
+            x0 += clipped;
+            x1 = std::min<int16_t>(x1, width - 1);
+
+            uint8_t a;
+            if(op == RleImage::Op::Run)
+            {
+                uint16_t color = Color(pixels, a);
+                if(a > 0)
+                {
+                    driver.transport_.FillSpan565(x0, x1, y, color, a);
+                }
+                return;
+            }
+
+            pixels += clipped * image.PixelSize();
+            uint16_t n = x1 - x0 + 1;
+            if(n >= dma2d_run
+               && driver.DrawLiteral(image, pixels, x0, y, n, alpha))
+            {
+                return;
+            }
+            auto dst = driver.transport_.PixelAt(x0, y);
+            for(uint16_t i = 0; i < n; i++, pixels += image.PixelSize())
+            {
+                uint16_t color = Color(pixels, a);
+                if(a == 255)
+                {
+                    dst[i] = FrameBufferPixel(color);
+                }
+                else if(a > 0)
+                {
+                    auto bg = FrameBufferPixel(dst[i]);
+                    dst[i]  = FrameBufferPixel(Blend565(color, bg, a));
+                }
+            }
+        }
+
+        // A pixel as stored in RGB565, a gets its alpha
+        uint16_t Color(const uint8_t* pixel, uint8_t& a) const
+        {
+            switch(image.GetFormat())
+            {
+                case RleImage::Format::ARGB4444:
+                {
+                    uint16_t argb = RleImage::Read16(pixel);
+                    a = RleImage::Argb4444Alpha(argb) * (alpha + 1) >> 8;
+                    return RleImage::Argb4444ToRgb565(argb);
+                }
+                case RleImage::Format::L8:
+                    a = alpha;
+                    return image.PaletteColor(*pixel);
+                default: a = alpha; return RleImage::Read16(pixel);
+            }
+        }
+    };
+
+    // Hands a literal to the DMA2D if it converts or blends it in place
+    bool DrawLiteral(const RleImage& image,
+                     const uint8_t*  pixels,
+                     int16_t         x,
+                     int16_t         y,
+                     uint16_t        n,
+                     uint8_t         alpha)
+    {
+        using Format = Dma2DHandle::PixelFormat;
+        auto format  = image.GetFormat();
+        if(!dma2d_fills_ || format == RleImage::Format::L8)
+        {
+            return false;
+        }
+        bool rgb565 = format == RleImage::Format::RGB565;
+#ifndef ILI9341_SPI_16BIT
+        // The DMA2D can't read the big endian frame buffer to blend
+        if(!rgb565 || alpha != 255)
+        {
+            return false;
+        }
+#endif
+        dma2d_.DrawImage(pixels,
+                         rgb565 ? Format::RGB565 : Format::ARGB4444,
+                         n,
+                         Rectangle(x, y, n, 1),
+                         alpha);
+        return true;
+    }
+#endif
+
+    // Runs xa..xb at distance y from the center, mirrored into all octants
+    void DrawCircleRuns(int16_t x0,
+                        int16_t y0,
+                        int16_t xa,
+                        int16_t xb,
+                        int16_t y,
+                        uint8_t color)
+    {
+        DrawSpan(x0 + xa, x0 + xb, y0 + y, color);
+        DrawSpan(x0 - xb, x0 - xa, y0 + y, color);
+        DrawSpan(x0 + xa, x0 + xb, y0 - y, color);
+        DrawSpan(x0 - xb, x0 - xa, y0 - y, color);
+        DrawColumn(x0 + y, y0 + xa, y0 + xb, color);
+        DrawColumn(x0 - y, y0 + xa, y0 + xb, color);
+        DrawColumn(x0 + y, y0 - xb, y0 - xa, color);
+        DrawColumn(x0 - y, y0 - xb, y0 - xa, color);
     }
 
     char WriteChar(char ch, UIFont font, uint8_t color)
@@ -661,20 +1689,26 @@ class ILI9341UiDriver : public _UiDriver
             return 0;
         }
 
-        // Use the font to write
-        for(auto i = 0; i < font.FontHeight; i++)
+#if !defined(ILI9341_INDEXED_FRAMEBUFFER) && !defined(ILI9341_BAND_RENDERER)
+        // Small glyphs are quicker to draw than to queue
+        auto glyphs = font.FontWidth * font.FontHeight >= dma2d_glyph
+                          ? glyphs_.Get(font)
+                          : nullptr;
+        if(glyphs)
         {
-            auto b = font.data[(ch - 32) * font.FontHeight + i];
-            for(auto j = 0; j < font.FontWidth; j++)
-            {
-                if((b << j) & 0x8000)
-                {
-                    DrawPixel(currentX_ + j, (currentY_ + i), color);
-                }
-            }
+            dma2d_.WriteChar(glyphs->Glyph(ch),
+                             glyphs->pitch,
+                             Rectangle(currentX_,
+                                       currentY_,
+                                       font.FontWidth,
+                                       font.FontHeight),
+                             color);
+        }
+        else
+#endif
+        {
+            BlitGlyph(ch, font, color);
         }
-
-        // dma2d_.WriteChar(ch, currentX_, currentY_, font, color);
 
         // The current space is now taken
         SetCursor(currentX_ + font.FontWidth, currentY_);
@@ -682,6 +1716,32 @@ class ILI9341UiDriver : public _UiDriver
         return ch;
     }
 
+    // Each font row is a 16 bit word, its set bits are written as runs
+    void BlitGlyph(char ch, const UIFont& font, uint8_t color)
+    {
+        dma2d_.Flush();
+
+        auto     rows = &font.data[(ch - 32) * font.FontHeight];
+        uint32_t mask = ~(UINT32_MAX >> font.FontWidth);
+        // Only the rows inside the clip
+        int16_t first = std::max(clip_top_ - currentY_, 0);
+        int16_t last  = std::min(clip_bottom_ - currentY_, +font.FontHeight);
+        for(int16_t i = first; i < last; i++)
+        {
+            uint32_t bits = (uint32_t(rows[i]) << 16) & mask;
+            while(bits)
+            {
+                uint8_t start = __builtin_clz(bits);
+                uint8_t end   = start + __builtin_clz(~(bits << start));
+                transport_.FillSpan(currentX_ + start,
+                                    currentX_ + end - 1,
+                                    currentY_ + i,
+                                    color);
+                bits &= UINT32_MAX >> end;
+            }
+        }
+    }
+
     /**
      * @brief Moves the 'Cursor' position used for WriteChar, and WriteStr to the specified coordinate.
      * 
@@ -711,12 +1771,11 @@ class ILI9341UiDriver : public _UiDriver
         return ((red & 0xF8) << 8) | ((green & 0xFC) << 3) | (blue >> 3);
     }
 
-    uint32_t screen_update_last_, screen_update_period_, fps_update_last_;
+    uint32_t fps_update_last_ = 0;
 
     ILI9341SpiTransport transport_;
 
     uint8_t  rotation;
-    uint32_t diff;
     uint16_t frames = 0;
 
     uint16_t currentX_;
@@ -729,5 +1788,62 @@ class ILI9341UiDriver : public _UiDriver
 
     uint16_t fps = 0;
 
-    Dma2DHandle dma2d_;
+    Dma2DHandle   dma2d_;
+    DirtyRegion   dirty_;
+    FrameProfiler profiler_;
+    FramePacer    pacer_;
+    RenderSlicer  slicer_;
+    bool          frame_pending_ = false; // Update() not done with a frame
+    bool          frame_started_ = false;
+    bool          swapped_       = false;
+#if !defined(ILI9341_INDEXED_FRAMEBUFFER) && !defined(ILI9341_BAND_RENDERER)
+    GlyphAtlas glyphs_;
+    // The DMA2D reads the glyphs, so they are kept out of the D-cache
+    alignas(4) static uint8_t DMA_BUFFER_MEM_SECTION
+        glyph_pool_[ILI9341_GLYPH_CACHE_SIZE];
+#endif
+    bool        partial_update_ = true;
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+    static constexpr bool indexed_ = true;
+#else
+    static constexpr bool indexed_ = false;
+#endif
+#ifdef ILI9341_BAND_RENDERER
+    static constexpr bool banded_ = true;
+#else
+    static constexpr bool banded_ = false;
+#endif
+#if defined(ILI9341_INDEXED_FRAMEBUFFER) || defined(ILI9341_BAND_RENDERER)
+    static constexpr bool dma2d_fills_ = false;
+#else
+    static constexpr bool dma2d_fills_ = true;
+#endif
+
+#ifdef ILI9341_BAND_RENDERER
+    DisplayList list_;
+    bool        replaying_ = false;
+    // Where RenderBands() is in the frame, and the columns of each band
+    uint8_t  band_    = 0;
+    uint16_t command_ = 0;
+    int16_t  band_x0_[num_bands];
+    int16_t  band_x1_[num_bands];
+    // Drawing is limited to these lines, the band being rendered
+    uint16_t clip_top_    = 0;
+    uint16_t clip_bottom_ = height;
+#else
+    static constexpr uint16_t clip_top_    = 0;
+    static constexpr uint16_t clip_bottom_ = height;
+#endif
+    BufferSync  buffer_sync_    = BufferSync::DamageReplay;
+#ifndef ILI9341_BAND_RENDERER
+    Sprite* sprites_[ILI9341_MAX_SPRITES];
+    uint8_t num_sprites_   = 0;
+    bool    sprites_drawn_ = false; // in the draw buffer, see RestoreSprites()
+#endif
+
+    uint16_t scroll_x_            = 0;
+    uint16_t scroll_width_        = 0;
+    uint16_t scroll_offset_       = 0;
+    bool     scroll_area_changed_ = false;
+    bool     scroll_changed_      = false;
 };
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Solid triangles and convex polygons as horizontal spans, in integer math
+ * only.
+ *
+ * Pixel centers are at whole coordinates and a pixel is filled if its center
+ * is inside the shape. A center on an edge goes by the top-left rule: it is
+ * in on a left or a top edge, out on a right or a bottom one. Shapes sharing
+ * an edge therefore never fill a pixel twice or leave one out, whatever the
+ * order they are drawn in, so a mesh of triangles can be blended.
+ *
+ * Edges are walked a row at a time, each keeping the first pixel right of
+ * it and how far the edge is past that, in 1/dy of a pixel. Stepping a row
+ * is a couple of additions, and it is exact, so the same edge comes out the
+ * same in every shape that has it. The first row is computed directly, which
+ * also clips the shape to the scissor rows before anything is walked. Spans
+ * are passed to sink(x0, x1, y) with x0 <= x1, already clipped to the
+ * scissor columns.
+ */
+class PolygonRaster
+{
+  public:
+    struct Vertex
+    {
+        int16_t x, y;
+    };
+
+    // Inclusive scissor rectangle
+    struct Clip
+    {
+        int16_t x0, y0, x1, y1;
+    };
+
+    /**
+     * @brief Fills a convex polygon of count vertices, in either winding.
+     * Anything else fills the rows between its leftmost and rightmost
+     * crossings of the two chains from its top vertex.
+     */
+    template <typename Sink>
+    static void
+    Convex(const Vertex* v, uint8_t count, const Clip& clip, Sink&& sink)
+    {
+        if(count < 3)
+        {
+            return;
+        }
+        uint8_t top = 0, bottom = 0;
+        for(uint8_t i = 1; i < count; i++)
+        {
+            top    = v[i].y < v[top].y ? i : top;
+            bottom = v[i].y > v[bottom].y ? i : bottom;
+        }
+        int32_t y    = std::max<int32_t>(v[top].y, clip.y0);
+        int32_t last = std::min<int32_t>(v[bottom].y - 1, clip.y1);
+        if(y > last)
+        {
+            return;
+        }
+
+        // One chain runs from the top vertex forwards, the other backwards
+        Chain a(v, count, top, +1), b(v, count, top, -1);
+        a.Start(y);
+        b.Start(y);
+        while(true)
+        {
+            // Rows until either chain moves on to its next edge
+            int32_t end = std::min({a.End(), b.End(), last + 1});
+            for(; y < end; y++)
+            {
+                int32_t x0 = std::min(a.edge.x, b.edge.x);
+                int32_t x1 = std::max(a.edge.x, b.edge.x) - 1;
+                x0         = std::max<int32_t>(x0, clip.x0);
+                x1         = std::min<int32_t>(x1, clip.x1);
+                if(x0 <= x1)
+                {
+                    sink(x0, x1, y);
+                }
+                a.edge.Step();
+                b.edge.Step();
+            }
+            if(y > last)
+            {
+                return;
+            }
+            a.Advance(y);
+            b.Advance(y);
+        }
+    }
+
+    template <typename Sink>
+    static void Triangle(int16_t     x0,
+                         int16_t     y0,
+                         int16_t     x1,
+                         int16_t     y1,
+                         int16_t     x2,
+                         int16_t     y2,
+                         const Clip& clip,
+                         Sink&&      sink)
+    {
+        // Sorted top to bottom, a triangle has a long edge down one side and
+        // two short ones down the other, so it needs none of Convex()'s
+        // chain walking. That setup is most of the cost of a small one.
+        Vertex a{x0, y0}, b{x1, y1}, c{x2, y2};
+        if(b.y < a.y)
+        {
+            std::swap(a, b);
+        }
+        if(c.y < b.y)
+        {
+            std::swap(b, c);
+            if(b.y < a.y)
+            {
+                std::swap(a, b);
+            }
+        }
+        int32_t y    = std::max<int32_t>(a.y, clip.y0);
+        int32_t last = std::min<int32_t>(c.y - 1, clip.y1);
+        if(y > last)
+        {
+            return;
+        }
+
+        Edge long_edge, short_edge;
+        long_edge.Start(a, c, y);
+        if(y < b.y)
+        {
+            short_edge.Start(a, b, y);
+        }
+        else
+        {
+            short_edge.Start(b, c, y);
+        }
+        while(true)
+        {
+            int32_t end = std::min<int32_t>(y < b.y ? b.y : c.y, last + 1);
+            for(; y < end; y++)
+            {
+                int32_t x0 = std::min(long_edge.x, short_edge.x);
+                int32_t x1 = std::max(long_edge.x, short_edge.x) - 1;
+                x0         = std::max<int32_t>(x0, clip.x0);
+                x1         = std::min<int32_t>(x1, clip.x1);
+                if(x0 <= x1)
+                {
+                    sink(x0, x1, y);
+                }
+                long_edge.Step();
+                short_edge.Step();
+            }
+            if(y > last)
+            {
+                return;
+            }
+            short_edge.Start(b, c, y);
+        }
+    }
+
+  private:
+    // An edge from a to b, a above b, on some row between them
+    struct Edge
+    {
+        int32_t x;     // first pixel center at or right of the edge
+        int32_t error; // x - edge, in 1/dy of a pixel, 0 <= error < dy
+        int32_t step;  // whole pixels per row, rounded down
+        int32_t rest;  // and the remainder, 0 <= rest < dy
+        int32_t dy;
+
+        void Start(const Vertex& a, const Vertex& b, int32_t y)
+        {
+            int32_t dx = b.x - a.x;
+            dy         = b.y - a.y;
+            step       = FloorDiv(dx, dy);
+            rest       = dx - step * dy;
+
+            // Edges mostly start on their top row, which is a.x exactly
+            uint32_t t = y - a.y;
+            if(t == 0)
+            {
+                x     = a.x;
+                error = 0;
+                return;
+            }
+
+            // The edge crosses row y, t rows below a, at a.x + t * dx / dy,
+            // which is t * step pixels and t * rest / dy more. That fits 32
+            // bits unsigned, so the Cortex-M7 divides it in one instruction.
+            uint32_t part  = t * uint32_t(rest);
+            uint32_t whole = part / dy, fraction = part % dy;
+            x     = a.x + int32_t(t) * step + int32_t(whole) + (fraction != 0);
+            error = fraction != 0 ? dy - int32_t(fraction) : 0;
+        }
+
+        // Without a branch, the carry is as good as random
+        void Step()
+        {
+            error -= rest;
+            int32_t carry = error >> 31; // -1 or 0
+            x += step - carry;
+            error += dy & carry;
+        }
+    };
+
+    // The edges from the top vertex down one side
+    struct Chain
+    {
+        Chain(const Vertex* v, uint8_t count, uint8_t top, int8_t direction)
+        : v(v), count(count), direction(direction), from(top), to(Next(top))
+        {
+        }
+
+        const Vertex* v;
+        uint8_t       count;
+        int8_t        direction;
+        uint8_t       from, to; // vertices of the current edge
+        Edge          edge{};
+
+        uint8_t Next(uint8_t i) const
+        {
+            if(direction > 0)
+            {
+                return i + 1 == count ? 0 : i + 1;
+            }
+            return i == 0 ? count - 1 : i - 1;
+        }
+
+        // Finds and starts the edge covering row y
+        void Start(int32_t y)
+        {
+            while(v[to].y <= y)
+            {
+                from = to;
+                to   = Next(to);
+            }
+            edge.Start(v[from], v[to], y);
+        }
+
+        // First row below the current edge
+        int32_t End() const { return v[to].y; }
+
+        // Moves on to the next edge once the current one ends above y
+        void Advance(int32_t y)
+        {
+            if(v[to].y <= y)
+            {
+                Start(y);
+            }
+        }
+    };
+
+    // n / d rounded down, d > 0
+    static int32_t FloorDiv(int32_t n, int32_t d)
+    {
+        return n / d - (n % d < 0);
+    }
+};
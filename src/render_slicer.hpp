@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Keeps the rendering done in one call within a time budget, so the main
+ * loop gets the CPU back for its control rate work.
+ *
+ * The driver renders in slices: it calls Begin() when it starts working,
+ * asks Expired() between units of work (a display list command, a band) and
+ * stops when it says so, resuming from there on its next call. Waiting for
+ * the DMA2D or SPI ends a slice too. A slice stops when the next unit, taken
+ * to last as long as the one before, wouldn't fit anymore. A unit can't be
+ * cut short, so a slice still runs over when one takes much longer than the
+ * last, which is counted as an overrun along with the longest slice seen.
+ */
+class RenderSlicer
+{
+  public:
+    /**
+     * @brief Microseconds of rendering per call, 0 for no limit, which
+     * renders each frame in one go as before.
+     */
+    void SetBudget(uint32_t us) { budget_us_ = us; }
+
+    uint32_t GetBudget() const { return budget_us_; }
+
+    bool IsLimited() const { return budget_us_ != 0; }
+
+    void Begin(uint32_t now_us)
+    {
+        start_us_ = last_us_ = now_us;
+        open_                = true;
+    }
+
+    /**
+     * @brief Whether another unit of work would overrun the budget at
+     * now_us, which ends the slice there.
+     */
+    bool Expired(uint32_t now_us)
+    {
+        uint32_t unit = now_us - last_us_;
+        last_us_      = now_us;
+        if(IsLimited() && now_us - start_us_ + unit > budget_us_)
+        {
+            End(now_us);
+            return true;
+        }
+        return false;
+    }
+
+    // Ends the slice at now_us, unless Expired() ended it already
+    void End(uint32_t now_us)
+    {
+        if(!open_)
+        {
+            return;
+        }
+        open_            = false;
+        uint32_t elapsed = now_us - start_us_;
+        slices_++;
+        if(elapsed > longest_us_)
+        {
+            longest_us_ = elapsed;
+        }
+        if(IsLimited() && elapsed > budget_us_)
+        {
+            overruns_++;
+        }
+    }
+
+    // Slices, slices over the budget and the longest one since ResetStats()
+    uint32_t Slices() const { return slices_; }
+    uint32_t Overruns() const { return overruns_; }
+    uint32_t LongestUs() const { return longest_us_; }
+
+    void ResetStats() { slices_ = overruns_ = longest_us_ = 0; }
+
+  private:
+    uint32_t budget_us_  = 0;
+    uint32_t start_us_   = 0;
+    uint32_t last_us_    = 0; // Last Expired() or Begin()
+    uint32_t slices_     = 0;
+    uint32_t overruns_   = 0;
+    uint32_t longest_us_ = 0;
+    bool     open_       = false;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Run length compressed image, read in place (e.g. from memory mapped QSPI
+ * flash) a row at a time, so nothing is decoded into a buffer.
+ *
+ * Layout, little endian:
+ * - 8 byte header: "RI", format, palette size - 1, width, height
+ * - the palette for L8, RGB565 entries
+ * - height + 1 row offsets (uint32), from the start of the image, the last
+ *   one being the size of the image
+ * - the rows, each a list of packets
+ *
+ * A packet is a byte holding the op in its top two bits and one less than
+ * the pixel count (up to 64) in the rest, followed by:
+ * - Skip: nothing, the pixels are transparent
+ * - Run: one pixel, repeated
+ * - Literal: count pixels, in 16 bit formats from an even offset with a
+ *   padding byte before them if needed, so the DMA2D can read them in place
+ * - EndOfRow: nothing, the rest of the row is transparent
+ *
+ * RGB565 images are opaque except for skipped pixels, ARGB4444 ones carry
+ * 4 bits of alpha and L8 ones index the palette. host/image_convert.cpp
+ * makes them out of PAM/PPM files. Images must start at an even address.
+ */
+class RleImage
+{
+  public:
+    enum class Format : uint8_t
+    {
+        RGB565,
+        ARGB4444,
+        L8,
+    };
+
+    enum class Op : uint8_t
+    {
+        Skip,
+        Run,
+        Literal,
+        EndOfRow,
+    };
+
+    static constexpr uint8_t max_count   = 64;
+    static constexpr uint8_t header_size = 8;
+
+    explicit RleImage(const uint8_t* data) : data_(data) {}
+
+    bool IsValid() const
+    {
+        return data_[0] == 'R' && data_[1] == 'I'
+               && data_[2] <= static_cast<uint8_t>(Format::L8);
+    }
+
+    const uint8_t* Data() const { return data_; }
+
+    Format   GetFormat() const { return static_cast<Format>(data_[2]); }
+    uint16_t Width() const { return Read16(data_ + 4); }
+    uint16_t Height() const { return Read16(data_ + 6); }
+    uint8_t  PixelSize() const { return GetFormat() == Format::L8 ? 1 : 2; }
+
+    uint16_t PaletteSize() const
+    {
+        return GetFormat() == Format::L8 ? data_[3] + 1 : 0;
+    }
+
+    uint16_t PaletteColor(uint8_t index) const
+    {
+        return Read16(data_ + header_size + index * 2);
+    }
+
+    // Offset of row, Height() gives the size of the whole image
+    uint32_t RowOffset(uint16_t row) const
+    {
+        auto entry = data_ + header_size + PaletteSize() * 2 + row * 4;
+        return Read16(entry) | uint32_t(Read16(entry + 2)) << 16;
+    }
+
+    uint32_t Size() const { return RowOffset(Height()); }
+
+    /**
+     * @brief Walks the packets of row, calling sink(op, x, count, pixels)
+     * for runs and literals with the first of their pixels, as stored.
+     */
+    template <typename Sink>
+    void DecodeRow(uint16_t row, Sink&& sink) const
+    {
+        uint32_t offset = RowOffset(row);
+        uint32_t end    = RowOffset(row + 1);
+        uint16_t width  = Width();
+        uint8_t  size   = PixelSize();
+        for(uint16_t x = 0; offset < end && x < width;)
+        {
+            uint8_t  packet = data_[offset++];
+            auto     op     = static_cast<Op>(packet >> 6);
+            uint16_t count  = (packet & 0x3F) + 1;
+            switch(op)
+            {
+                case Op::Skip: break;
+                case Op::Run:
+                    sink(op, x, count, data_ + offset);
+                    offset += size;
+                    break;
+                case Op::Literal:
+                    offset = LiteralOffset(offset, size);
+                    sink(op, x, count, data_ + offset);
+                    offset += count * size;
+                    break;
+                case Op::EndOfRow: return;
+            }
+            x += count;
+        }
+    }
+
+    // Where the pixels of a literal whose packet ends at offset start
+    static uint32_t LiteralOffset(uint32_t offset, uint8_t pixel_size)
+    {
+        return pixel_size == 2 ? (offset + 1) & ~1u : offset;
+    }
+
+    static uint16_t Read16(const uint8_t* p) { return p[0] | p[1] << 8; }
+
+    // Widens the channels the way the DMA2D does
+    static uint16_t Argb4444ToRgb565(uint16_t pixel)
+    {
+        uint16_t r = pixel >> 8 & 0xF, g = pixel >> 4 & 0xF, b = pixel & 0xF;
+        return (r << 1 | r >> 3) << 11 | (g << 2 | g >> 2) << 5
+               | (b << 1 | b >> 3);
+    }
+
+    static uint8_t Argb4444Alpha(uint16_t pixel) { return (pixel >> 12) * 17; }
+
+  private:
+    const uint8_t* data_;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include "ui_driver.hpp"
+
+// Sprites an ILI9341UiDriver composites at most
+#ifndef ILI9341_MAX_SPRITES
+#define ILI9341_MAX_SPRITES 8
+#endif
+
+/**
+ * A small object laid over the frame buffer while it is sent, e.g. a cursor,
+ * a playhead or a drag handle, see ILI9341UiDriver::AddSprite().
+ *
+ * Before the sprite is drawn, the pixels it covers are copied to its
+ * save-under buffer, and once the frame is sent they are copied back, so what
+ * the application draws never has the sprite in it. Moving one costs two
+ * damaged areas, where it was and where it is, and nothing under it needs to
+ * be redrawn.
+ *
+ * It is a solid, optionally translucent, rectangle or an RleImage no larger
+ * than the sprite. The buffer takes BufferSize() bytes and, like the sprite,
+ * belongs to the application.
+ */
+class Sprite
+{
+  public:
+#ifdef ILI9341_INDEXED_FRAMEBUFFER
+    static constexpr uint8_t pixel_size = 1;
+#else
+    static constexpr uint8_t pixel_size = 2;
+#endif
+
+    static constexpr uint32_t BufferSize(uint16_t width, uint16_t height)
+    {
+        return uint32_t(width) * height * pixel_size;
+    }
+
+    // save_under must hold BufferSize(width, height) bytes, 4 byte aligned,
+    // in DMA_BUFFER_MEM_SECTION
+    Sprite(uint16_t width, uint16_t height, uint8_t* save_under)
+    : width_(width), height_(height), save_(save_under)
+    {
+    }
+
+    int16_t  X() const { return x_; }
+    int16_t  Y() const { return y_; }
+    uint16_t Width() const { return width_; }
+    uint16_t Height() const { return height_; }
+    bool     IsVisible() const { return visible_; }
+
+    void MoveTo(int16_t x, int16_t y)
+    {
+        Set(x_, x);
+        Set(y_, y);
+    }
+
+    void SetVisible(bool visible) { Set(visible_, visible); }
+
+    void SetColor(uint8_t color, uint8_t alpha = 255)
+    {
+        Set(image_, static_cast<const uint8_t*>(nullptr));
+        Set(color_, color);
+        Set(alpha_, alpha);
+    }
+
+#ifndef ILI9341_INDEXED_FRAMEBUFFER
+    // Draws an RleImage, left where it is, instead of a solid color
+    void SetImage(const uint8_t* image, uint8_t alpha = 255)
+    {
+        Set(image_, image);
+        Set(alpha_, alpha);
+    }
+#endif
+
+  private:
+    friend class ILI9341UiDriver;
+
+    template <typename T>
+    void Set(T& state, T value)
+    {
+        changed_ |= state != value;
+        state = value;
+    }
+
+    int16_t        x_ = 0, y_ = 0;
+    uint16_t       width_, height_;
+    uint8_t*       save_;
+    const uint8_t* image_   = nullptr;
+    uint8_t        color_   = 0;
+    uint8_t        alpha_   = 255;
+    bool           visible_ = true;
+    bool           changed_ = true; // since it was last drawn
+    Rectangle      drawn_;          // on screen part drawn in the last frame
+};
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "ili9341_ui_driver.hpp"
+
+// Commands a UiCommandQueue holds, a power of two
+#ifndef ILI9341_UI_QUEUE_SIZE
+#define ILI9341_UI_QUEUE_SIZE 64
+#endif
+
+/**
+ * A UI update posted from interrupt context: a value for the application to
+ * show (a meter level, a parameter) or a small drawing call, see
+ * UiCommandQueue.
+ */
+struct UiCommand
+{
+    enum class Op : uint8_t
+    {
+        Value,
+        FillRect, // x0, y0, width x1, height y1
+        Line,
+        Rect,     // x0, y0, width x1, height y1
+    };
+
+    // Target of commands that are never coalesced
+    static constexpr uint8_t no_target = 0xFF;
+
+    Op      op;
+    uint8_t target; // id the application gives what the command updates
+    uint8_t color, alpha;
+    int16_t x0, y0, x1, y1;
+    float   value;
+
+    // Runs a drawing command, values are the application's to show
+    void Draw(ILI9341UiDriver& driver) const
+    {
+        switch(op)
+        {
+            case Op::Value: break;
+            case Op::FillRect:
+                driver.FillRect(Rectangle(x0, y0, x1, y1), color, alpha);
+                break;
+            case Op::Line: driver.DrawLine(x0, y0, x1, y1, color, alpha); break;
+            case Op::Rect:
+                driver.DrawRect(Rectangle(x0, y0, x1, y1), color, alpha);
+                break;
+        }
+    }
+};
+
+/**
+ * Bounded queue of UiCommands from one producer, e.g. the audio callback, to
+ * the main loop, without locks or allocation. The driver isn't safe to call
+ * from interrupts, as it waits for the DMA2D and keeps state such as the text
+ * cursor, so the interrupt posts here and the main loop calls Drain() before
+ * it draws the next frame.
+ *
+ * Updates to the same target are coalesced, Drain() only hands on the latest
+ * one. Values don't take a place in the queue: each target has a slot that
+ * PostValue() overwrites, so they can't overflow and the last one posted is
+ * always seen. Drawing commands go through a ring. Those without a target run
+ * in the order they were posted, then the latest with each target. Posting a
+ * drawing command to a full ring drops it and counts it in Overflows().
+ */
+class UiCommandQueue
+{
+  public:
+    static constexpr uint32_t size        = ILI9341_UI_QUEUE_SIZE;
+    static constexpr uint8_t  max_targets = 32;
+    static_assert((size & (size - 1)) == 0, "Size must be a power of two");
+
+    // Producer side, false if the queue was full
+    bool Post(const UiCommand& cmd)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if(head - tail_.load(std::memory_order_acquire) == size)
+        {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        commands_[head & (size - 1)] = cmd;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side, target must be below max_targets
+    void PostValue(uint8_t target, float value)
+    {
+        uint32_t bit = uint32_t(1) << target;
+        values_[target].store(value, std::memory_order_relaxed);
+        if(posted_values_.fetch_or(bit, std::memory_order_release) & bit)
+        {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool PostFillRect(uint8_t          target,
+                      const Rectangle& rect,
+                      uint8_t          color,
+                      uint8_t          alpha = 255)
+    {
+        return Post(Make(UiCommand::Op::FillRect,
+                         target,
+                         rect.GetX(),
+                         rect.GetY(),
+                         rect.GetWidth(),
+                         rect.GetHeight(),
+                         color,
+                         alpha));
+    }
+
+    bool PostLine(uint8_t target,
+                  int16_t x1,
+                  int16_t y1,
+                  int16_t x2,
+                  int16_t y2,
+                  uint8_t color,
+                  uint8_t alpha = 255)
+    {
+        return Post(
+            Make(UiCommand::Op::Line, target, x1, y1, x2, y2, color, alpha));
+    }
+
+    bool PostRect(uint8_t          target,
+                  const Rectangle& rect,
+                  uint8_t          color,
+                  uint8_t          alpha = 255)
+    {
+        return Post(Make(UiCommand::Op::Rect,
+                         target,
+                         rect.GetX(),
+                         rect.GetY(),
+                         rect.GetWidth(),
+                         rect.GetHeight(),
+                         color,
+                         alpha));
+    }
+
+    /**
+     * @brief Consumer side: calls handler(const UiCommand&) for what was
+     * posted up to now, coalesced. Returns the commands handed on.
+     */
+    template <typename Handler>
+    uint32_t Drain(Handler&& handler)
+    {
+        uint32_t tail    = tail_.load(std::memory_order_relaxed);
+        uint32_t head    = head_.load(std::memory_order_acquire);
+        uint32_t handled = 0;
+        uint32_t pending = 0; // targets with a drawing command in latest_
+        for(; tail != head; tail++)
+        {
+            const UiCommand& cmd = commands_[tail & (size - 1)];
+            if(cmd.target >= max_targets)
+            {
+                handler(cmd);
+                handled++;
+                continue;
+            }
+            uint32_t bit = uint32_t(1) << cmd.target;
+            if(pending & bit)
+            {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+            }
+            latest_[cmd.target] = cmd;
+            pending |= bit;
+        }
+        // The slots are the producer's again
+        tail_.store(tail, std::memory_order_release);
+
+        auto latest = [this](uint8_t target) { return latest_[target]; };
+        handled += HandleEach(pending, handler, latest);
+
+        auto value = [this](uint8_t target)
+        {
+            UiCommand cmd{};
+            cmd.op     = UiCommand::Op::Value;
+            cmd.target = target;
+            cmd.value  = values_[target].load(std::memory_order_relaxed);
+            return cmd;
+        };
+        uint32_t values = posted_values_.exchange(0, std::memory_order_acquire);
+        handled += HandleEach(values, handler, value);
+        return handled;
+    }
+
+    // Drawing commands dropped because the ring was full, and updates left
+    // out for a later one to the same target
+    uint32_t Overflows() const
+    {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+    uint32_t Coalesced() const
+    {
+        return coalesced_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Hands on command(target) for each target set in mask
+    template <typename Handler, typename Command>
+    static uint32_t HandleEach(uint32_t mask, Handler& handler, Command command)
+    {
+        uint32_t handled = 0;
+        for(uint8_t target = 0; mask != 0; target++, mask >>= 1)
+        {
+            if(mask & 1)
+            {
+                handler(command(target));
+                handled++;
+            }
+        }
+        return handled;
+    }
+
+    static UiCommand Make(UiCommand::Op op,
+                          uint8_t       target,
+                          int16_t       x0,
+                          int16_t       y0,
+                          int16_t       x1,
+                          int16_t       y1,
+                          uint8_t       color,
+                          uint8_t       alpha)
+    {
+        UiCommand cmd{};
+        cmd.op     = op;
+        cmd.target = target;
+        cmd.color  = color;
+        cmd.alpha  = alpha;
+        cmd.x0     = x0;
+        cmd.y0     = y0;
+        cmd.x1     = x1;
+        cmd.y1     = y1;
+        return cmd;
+    }
+
+    UiCommand commands_[size];
+    // Free running, masked on access. The Cortex-M7 loads and stores these
+    // without locks, and the atomics keep host threads honest too.
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> overflows_{0};
+    std::atomic<uint32_t> coalesced_{0};
+
+    // Latest value per target, and the targets posted to since Drain()
+    std::atomic<float>    values_[max_targets];
+    std::atomic<uint32_t> posted_values_{0};
+
+    UiCommand latest_[max_targets]; // consumer only
+};
@@ -7,6 +7,11 @@
 
 using daisy::Rectangle;
 
+// Stops in the debugger on errors there is no recovering from
+#ifndef ILI9341_BREAKPOINT
+#define ILI9341_BREAKPOINT() __asm("BKPT #0")
+#endif
+
 using UiFont = daisy::FontDef;
 
 enum TFT_COLOR
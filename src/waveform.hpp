@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include "ili9341_ui_driver.hpp"
+
+/**
+ * Ring of samples from the audio callback to the UI loop, without locks.
+ *
+ * The callback calls Write() and the main loop Read(), so each side only ever
+ * writes its own index, like UiCommandQueue. Size must be a power of two.
+ * Samples that don't fit because the reader fell behind are dropped and
+ * counted.
+ */
+template <typename T, uint32_t Size>
+class SampleRing
+{
+  public:
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+    // Audio side, returns the samples taken
+    uint32_t Write(const T* samples, uint32_t count)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        uint32_t n    = std::min(count, Size - (head - tail));
+        for(uint32_t i = 0; i < n; i++)
+        {
+            buffer_[(head + i) & (Size - 1)] = samples[i];
+        }
+        // The samples must be in place before the reader can see them
+        head_.store(head + n, std::memory_order_release);
+        dropped_.fetch_add(count - n, std::memory_order_relaxed);
+        return n;
+    }
+
+    // UI side, returns the samples copied to samples
+    uint32_t Read(T* samples, uint32_t count)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t n    = std::min(count, head - tail);
+        for(uint32_t i = 0; i < n; i++)
+        {
+            samples[i] = buffer_[(tail + i) & (Size - 1)];
+        }
+        // The slots are free again once they are copied out
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    uint32_t Available() const
+    {
+        return head_.load(std::memory_order_acquire)
+               - tail_.load(std::memory_order_relaxed);
+    }
+
+    uint32_t Dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    T                     buffer_[Size];
+    std::atomic<uint32_t> head_{0}; // free running, masked on access
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> dropped_{0};
+};
+
+/**
+ * Oscilloscope trace drawn as one vertical span per column, covering the
+ * minimum to maximum of the samples that fall in it, so any number of samples
+ * costs one ILI9341UiDriver::DrawColumns() rather than a line per sample.
+ * Each column also reaches the last sample of the column before it, which
+ * keeps the trace joined up where it is steep.
+ *
+ * Set() spreads a block of samples over the viewport, e.g. a triggered scope
+ * or a spectrum. Push() sweeps across it instead, closing a column every
+ * SetSamplesPerColumn() samples and wrapping around at the right edge, and
+ * takes samples from a SampleRing filled by the audio callback too.
+ *
+ * Draw() only redraws the columns whose span changed, erasing just the parts
+ * of the old span the new one doesn't cover. With ILI9341_BAND_RENDERER,
+ * which keeps no frame to change, or SetIncremental(false) it fills the
+ * viewport and draws every column.
+ *
+ * Samples are floats from -1 to 1 or int16_t, full scale filling the
+ * viewport, which must be on screen and at most max_columns wide.
+ */
+class Waveform
+{
+  public:
+    static constexpr uint16_t max_columns = 320;
+
+    Waveform(const Rectangle& viewport,
+             uint8_t          color,
+             uint8_t          background = COLOR_BLACK)
+    : viewport_(viewport),
+      columns_(std::min<int16_t>(viewport.GetWidth(), max_columns)),
+      half_((viewport.GetHeight() - 1) / 2),
+      middle_(viewport.GetY() + half_),
+      color_(color),
+      background_(background)
+    {
+        std::fill(std::begin(next_), std::end(next_), ColumnSpan{1, 0});
+        std::fill(std::begin(drawn_), std::end(drawn_), ColumnSpan{1, 0});
+    }
+
+    void SetIncremental(bool incremental) { incremental_ = incremental; }
+
+    // Redraws every column on the next Draw()
+    void Invalidate() { valid_ = false; }
+
+    // Replaces the trace with count samples spread over the columns
+    template <typename T>
+    void Set(const T* samples, uint32_t count)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        for(uint16_t c = 0; c < columns_; c++)
+        {
+            uint32_t start = uint64_t(c) * count / columns_;
+            uint32_t end   = uint64_t(c + 1) * count / columns_;
+            end            = std::max(end, start + 1);
+            int32_t low = Q15(samples[start]), high = low;
+            for(uint32_t i = start > 0 ? start - 1 : start + 1; i < end; i++)
+            {
+                int32_t q = Q15(samples[i]);
+                low       = std::min(low, q);
+                high      = std::max(high, q);
+            }
+            next_[c] = Span(low, high);
+        }
+    }
+
+    void SetSamplesPerColumn(uint16_t samples)
+    {
+        samples_per_column_ = std::max<uint16_t>(samples, 1);
+    }
+
+    // Sweeps samples into the trace from where the last call left off
+    template <typename T>
+    void Push(const T* samples, uint32_t count)
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            int32_t q = Q15(samples[i]);
+            if(pending_ == 0)
+            {
+                // Start from the last sample of the column before
+                low_ = high_ = last_;
+            }
+            low_  = std::min(low_, q);
+            high_ = std::max(high_, q);
+            last_ = q;
+            if(++pending_ == samples_per_column_)
+            {
+                next_[sweep_] = Span(low_, high_);
+                sweep_        = sweep_ + 1 == columns_ ? 0 : sweep_ + 1;
+                pending_      = 0;
+            }
+        }
+    }
+
+    // Pushes everything the ring holds
+    template <typename T, uint32_t Size>
+    void Push(SampleRing<T, Size>& ring)
+    {
+        T        block[64];
+        uint32_t n;
+        while((n = ring.Read(block, 64)) > 0)
+        {
+            Push(block, n);
+        }
+    }
+
+    void Draw(ILI9341UiDriver& driver)
+    {
+        int16_t x = viewport_.GetX();
+#ifdef ILI9341_BAND_RENDERER
+        bool incremental = false;
+#else
+        bool incremental = incremental_ && valid_;
+#endif
+        if(!incremental)
+        {
+            std::copy(next_, next_ + columns_, drawn_);
+            driver.FillRect(viewport_, background_);
+            driver.DrawColumns(x, drawn_, columns_, color_);
+            changed_ = columns_;
+            valid_   = true;
+            return;
+        }
+
+        // What the old spans stick out above and below the new ones, then
+        // the new spans, of the columns that changed
+        static constexpr ColumnSpan none = {1, 0};
+        changed_                         = 0;
+        for(uint16_t c = 0; c < columns_; c++)
+        {
+            auto& old   = drawn_[c];
+            auto& span  = next_[c];
+            auto& erase = scratch_[c];
+            erase       = none;
+            if(Same(old, span))
+            {
+                continue;
+            }
+            erase = old;
+            if(span.top <= span.bottom)
+            {
+                erase.bottom = std::min<int16_t>(old.bottom, span.top - 1);
+            }
+            changed_++;
+        }
+        if(changed_ == 0)
+        {
+            return;
+        }
+        driver.DrawColumns(x, scratch_, columns_, background_);
+
+        for(uint16_t c = 0; c < columns_; c++)
+        {
+            auto& old   = drawn_[c];
+            auto& span  = next_[c];
+            auto& erase = scratch_[c];
+            erase       = none;
+            if(!Same(old, span) && span.top <= span.bottom)
+            {
+                erase.top    = std::max<int16_t>(old.top, span.bottom + 1);
+                erase.bottom = old.bottom;
+            }
+        }
+        driver.DrawColumns(x, scratch_, columns_, background_);
+
+        for(uint16_t c = 0; c < columns_; c++)
+        {
+            scratch_[c] = Same(drawn_[c], next_[c]) ? none : next_[c];
+            drawn_[c]   = next_[c];
+        }
+        driver.DrawColumns(x, scratch_, columns_, color_);
+    }
+
+    // Columns the last Draw() drew
+    uint16_t Changed() const { return changed_; }
+
+  private:
+    static bool Same(const ColumnSpan& a, const ColumnSpan& b)
+    {
+        return a.top == b.top && a.bottom == b.bottom;
+    }
+
+    static int32_t Q15(int16_t sample) { return sample; }
+
+    static int32_t Q15(float sample)
+    {
+        return static_cast<int32_t>(std::clamp(sample, -1.f, 1.f) * 32767.f);
+    }
+
+    // Rows from the highest to the lowest sample, positive being up
+    ColumnSpan Span(int32_t low, int32_t high) const
+    {
+        return ColumnSpan{static_cast<int16_t>(middle_ - (high * half_ >> 15)),
+                          static_cast<int16_t>(middle_ - (low * half_ >> 15))};
+    }
+
+    Rectangle  viewport_;
+    uint16_t   columns_;
+    int16_t    half_, middle_;
+    uint8_t    color_, background_;
+    bool       incremental_ = true;
+    bool       valid_       = false; // drawn_ is on screen
+    uint16_t   changed_     = 0;
+    ColumnSpan next_[max_columns];    // the trace as it is now
+    ColumnSpan drawn_[max_columns];   // as last drawn
+    ColumnSpan scratch_[max_columns]; // spans of one DrawColumns() call
+
+    // Push() state: the column being filled and its samples so far
+    uint16_t samples_per_column_ = 1;
+    uint16_t sweep_              = 0;
+    uint16_t pending_            = 0;
+    int32_t  low_ = 0, high_ = 0, last_ = 0;
+};
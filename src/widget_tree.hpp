@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include "ili9341_ui_driver.hpp"
+
+// Widgets a WidgetTree holds at most
+#ifndef ILI9341_MAX_WIDGETS
+#define ILI9341_MAX_WIDGETS 32
+#endif
+
+/**
+ * A retained UI element. It keeps what it shows, and the setters mark it
+ * dirty only when that changes on screen, e.g. a bar whose value moves by
+ * less than a pixel stays clean.
+ *
+ * Draw() paints the widget inside Bounds() on top of the background the
+ * WidgetTree cleared it to, and must not draw outside of them.
+ */
+class Widget
+{
+  public:
+    explicit Widget(const Rectangle& bounds) : bounds_(bounds) {}
+    virtual ~Widget() = default;
+
+    const Rectangle& Bounds() const { return bounds_; }
+    bool             IsDirty() const { return dirty_; }
+    bool             IsVisible() const { return visible_; }
+
+    // Moves the widget, where it was is cleared on the next Render()
+    void SetBounds(const Rectangle& bounds)
+    {
+        if(bounds.GetX() != bounds_.GetX() || bounds.GetY() != bounds_.GetY()
+           || bounds.GetWidth() != bounds_.GetWidth()
+           || bounds.GetHeight() != bounds_.GetHeight())
+        {
+            bounds_ = bounds;
+            dirty_  = true;
+        }
+    }
+
+    void SetVisible(bool visible)
+    {
+        dirty_ |= visible != visible_;
+        visible_ = visible;
+    }
+
+    // Redraws the widget on the next Render() whether it changed or not
+    void Invalidate() { dirty_ = true; }
+
+  protected:
+    virtual void Draw(ILI9341UiDriver& driver) = 0;
+
+    // Sets a piece of state, marking the widget dirty if it changes
+    template <typename T>
+    void Set(T& state, T value)
+    {
+        dirty_ |= state != value;
+        state = value;
+    }
+
+  private:
+    friend class WidgetTree;
+
+    // The area a redraw clears: where the widget is now and where it was
+    Rectangle Damage() const
+    {
+        Rectangle now = visible_ ? bounds_ : Rectangle();
+        if(drawn_.IsEmpty())
+        {
+            return now;
+        }
+        if(now.IsEmpty())
+        {
+            return drawn_;
+        }
+        int16_t x0 = std::min(now.GetX(), drawn_.GetX());
+        int16_t y0 = std::min(now.GetY(), drawn_.GetY());
+        int16_t x1 = std::max(now.GetRight(), drawn_.GetRight());
+        int16_t y1 = std::max(now.GetBottom(), drawn_.GetBottom());
+        return Rectangle(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    Rectangle bounds_;
+    Rectangle drawn_; // Bounds at the last Render(), empty if not on screen
+    int8_t    z_       = 0;
+    bool      dirty_   = true;
+    bool      visible_ = true;
+};
+
+/**
+ * Line of text, cut to what fits the bounds and centered vertically.
+ */
+class Label : public Widget
+{
+  public:
+    Label(const Rectangle& bounds,
+          const char*      text,
+          const UIFont&    font,
+          uint8_t          color = COLOR_WHITE)
+    : Widget(bounds), font_(&font), color_(color)
+    {
+        SetText(text);
+    }
+
+    void SetText(const char* text)
+    {
+        if(strncmp(text, text_, sizeof(text_) - 1) != 0)
+        {
+            strncpy(text_, text, sizeof(text_) - 1);
+            Invalidate();
+        }
+    }
+
+    void SetColor(uint8_t color) { Set(color_, color); }
+
+    const char* Text() const { return text_; }
+
+  protected:
+    void Draw(ILI9341UiDriver& driver) override
+    {
+        auto&  b = Bounds();
+        char   line[sizeof(text_)];
+        size_t fit = std::min<size_t>(sizeof(line) - 1,
+                                      b.GetWidth() / font_->FontWidth);
+        strncpy(line, text_, fit);
+        line[fit] = '\0';
+        driver.WriteString(line,
+                           b.GetX(),
+                           b.GetY() + (b.GetHeight() - font_->FontHeight) / 2,
+                           *font_,
+                           color_);
+    }
+
+  private:
+    const UIFont* font_;
+    uint8_t       color_;
+    char          text_[32] = "";
+};
+
+/**
+ * Horizontal bar showing a value from 0 to 1 inside an outline.
+ */
+class ValueBar : public Widget
+{
+  public:
+    ValueBar(const Rectangle& bounds,
+             uint8_t          color   = COLOR_ORANGE,
+             uint8_t          outline = COLOR_ABL_L_GRAY)
+    : Widget(bounds), color_(color), outline_(outline)
+    {
+    }
+
+    void SetValue(float value)
+    {
+        value = std::clamp(value, 0.f, 1.f);
+        if(Fill(value) != Fill(value_))
+        {
+            Invalidate();
+        }
+        value_ = value;
+    }
+
+  protected:
+    void Draw(ILI9341UiDriver& driver) override
+    {
+        auto& b = Bounds();
+        // DrawRect() takes the inclusive width and height
+        driver.DrawRect(b.GetX(),
+                        b.GetY(),
+                        b.GetWidth() - 1,
+                        b.GetHeight() - 1,
+                        outline_);
+        driver.FillRect(Rectangle(b.GetX() + 2,
+                                  b.GetY() + 2,
+                                  Fill(value_),
+                                  b.GetHeight() - 4),
+                        color_);
+    }
+
+  private:
+    // Pixels filled inside the outline
+    int16_t Fill(float value) const
+    {
+        return value * std::max(Bounds().GetWidth() - 4, 0);
+    }
+
+    uint8_t color_, outline_;
+    float   value_ = 0;
+};
+
+/**
+ * Anti-aliased knob: a track from 7 to 5 o'clock, the value arc along it and
+ * a pointer, all inside the largest circle the bounds hold.
+ */
+class Knob : public Widget
+{
+  public:
+    Knob(const Rectangle& bounds,
+         uint8_t          color = COLOR_ORANGE,
+         uint8_t          track = COLOR_ABL_L_GRAY)
+    : Widget(bounds), color_(color), track_(track)
+    {
+    }
+
+    void SetValue(float value)
+    {
+        value = std::clamp(value, 0.f, 1.f);
+        Set(angle_, static_cast<int16_t>(value * 270));
+    }
+
+  protected:
+    void Draw(ILI9341UiDriver& driver) override
+    {
+        constexpr uint8_t thickness = 4;
+        constexpr int16_t start     = 135;
+
+        auto&   b  = Bounds();
+        int16_t cx = b.GetX() + (b.GetWidth() - 1) / 2;
+        int16_t cy = b.GetY() + (b.GetHeight() - 1) / 2;
+        // The arcs reach two pixels past their outer radius
+        int16_t r = (std::min(b.GetWidth(), b.GetHeight()) - 1) / 2
+                    - thickness / 2 - 2;
+        int16_t tip = r - thickness;
+        int16_t end = start + angle_;
+        driver.DrawArcAA(cx, cy, r, thickness, start, start + 270, track_);
+        driver.DrawArcAA(cx, cy, r, thickness, start, end, color_);
+        driver.DrawLineAA(cx,
+                          cy,
+                          cx + CoverageRaster::Cos(end) * tip / 32768,
+                          cy + CoverageRaster::Sin(end) * tip / 32768,
+                          COLOR_WHITE);
+    }
+
+  private:
+    uint8_t color_, track_;
+    int16_t angle_ = 0; // Degrees along the track
+};
+
+/**
+ * Vertical level meter filling up from the bottom, in a second color above
+ * the warning level.
+ */
+class Meter : public Widget
+{
+  public:
+    Meter(const Rectangle& bounds,
+          float            warn_level = 0.8f,
+          uint8_t          color      = COLOR_GREEN,
+          uint8_t          warn_color = COLOR_RED)
+    : Widget(bounds),
+      warn_level_(warn_level),
+      color_(color),
+      warn_color_(warn_color)
+    {
+    }
+
+    void SetLevel(float level)
+    {
+        level = std::clamp(level, 0.f, 1.f);
+        if(Height(level) != Height(level_))
+        {
+            Invalidate();
+        }
+        level_ = level;
+    }
+
+  protected:
+    void Draw(ILI9341UiDriver& driver) override
+    {
+        auto&   b      = Bounds();
+        int16_t level  = Height(level_);
+        int16_t warn   = Height(warn_level_);
+        int16_t normal = std::min(level, warn);
+        driver.FillRect(Rectangle(b.GetX(),
+                                  b.GetBottom() - normal,
+                                  b.GetWidth(),
+                                  normal),
+                        color_);
+        if(level > warn)
+        {
+            driver.FillRect(Rectangle(b.GetX(),
+                                      b.GetBottom() - level,
+                                      b.GetWidth(),
+                                      level - warn),
+                            warn_color_);
+        }
+    }
+
+  private:
+    int16_t Height(float level) const { return level * Bounds().GetHeight(); }
+
+    float   level_ = 0;
+    float   warn_level_;
+    uint8_t color_, warn_color_;
+};
+
+/**
+ * Menu of text rows with one selected, scrolled to keep it in view. The
+ * items aren't copied: call Invalidate() after changing their text.
+ */
+class List : public Widget
+{
+  public:
+    List(const Rectangle&   bounds,
+         const char* const* items,
+         uint8_t            count,
+         const UIFont&      font,
+         uint8_t            highlight = COLOR_DARK_BLUE)
+    : Widget(bounds),
+      items_(items),
+      count_(count),
+      font_(&font),
+      highlight_(highlight)
+    {
+    }
+
+    void SetItems(const char* const* items, uint8_t count)
+    {
+        Set(items_, items);
+        Set(count_, count);
+        Select(selected_);
+    }
+
+    void Select(uint8_t index)
+    {
+        index = count_ ? std::min<uint8_t>(index, count_ - 1) : 0;
+        Set(selected_, index);
+        uint8_t rows = Rows();
+        if(selected_ < first_)
+        {
+            Set(first_, selected_);
+        }
+        else if(rows && selected_ >= first_ + rows)
+        {
+            Set(first_, static_cast<uint8_t>(selected_ - rows + 1));
+        }
+    }
+
+    uint8_t Selected() const { return selected_; }
+
+  protected:
+    void Draw(ILI9341UiDriver& driver) override
+    {
+        auto&   b = Bounds();
+        uint8_t fit = std::min<size_t>(sizeof(line_) - 1,
+                                       b.GetWidth() / font_->FontWidth);
+        for(uint8_t row = 0; row < Rows() && first_ + row < count_; row++)
+        {
+            uint8_t item = first_ + row;
+            int16_t y    = b.GetY() + row * RowHeight();
+            if(item == selected_)
+            {
+                driver.FillRect(
+                    Rectangle(b.GetX(), y, b.GetWidth(), RowHeight()),
+                    highlight_);
+            }
+            strncpy(line_, items_[item], fit);
+            line_[fit] = '\0';
+            driver.WriteString(line_, b.GetX(), y + 1, *font_, COLOR_WHITE);
+        }
+    }
+
+  private:
+    int16_t RowHeight() const { return font_->FontHeight + 2; }
+    uint8_t Rows() const { return Bounds().GetHeight() / RowHeight(); }
+
+    const char* const* items_;
+    uint8_t            count_;
+    const UIFont*      font_;
+    uint8_t            highlight_;
+    uint8_t            selected_ = 0;
+    uint8_t            first_    = 0; // Item in the top row
+    char               line_[32];
+};
+
+/**
+ * Retained widgets drawn through the driver, redrawing only what changed.
+ *
+ * Render() clears each dirty widget's area to the background and redraws
+ * it, which puts the area into the driver's dirty regions so Update() sends
+ * just that. Clearing also wipes widgets overlapping the area, so those are
+ * redrawn as well, in z order, lowest first. Clean widgets cost nothing: the
+ * frame buffer (or the display list with ILI9341_BAND_RENDERER) still holds
+ * them.
+ *
+ * Widgets are owned by the application, usually as globals, and the tree
+ * only keeps ILI9341_MAX_WIDGETS pointers to them. Anything else drawing over
+ * a widget's area has to Invalidate() the widget.
+ */
+class WidgetTree
+{
+  public:
+    void SetBackground(uint8_t color) { background_ = color; }
+
+    /**
+     * @brief Adds a widget drawn over the ones of lower z, and over those of
+     * the same z added before. Returns false if the tree is full.
+     */
+    bool Add(Widget& widget, int8_t z = 0)
+    {
+        if(count_ == ILI9341_MAX_WIDGETS)
+        {
+            return false;
+        }
+        widget.z_ = z;
+        widget.Invalidate();
+        uint8_t i = count_++;
+        for(; i > 0 && widgets_[i - 1]->z_ > z; i--)
+        {
+            widgets_[i] = widgets_[i - 1];
+        }
+        widgets_[i] = &widget;
+        return true;
+    }
+
+    // Redraws everything on the next Render(), e.g. after a Fill()
+    void Invalidate()
+    {
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            widgets_[i]->Invalidate();
+        }
+    }
+
+    /**
+     * @brief Draws the dirty widgets and those they overlap. Call it before
+     * the driver's Update().
+     */
+    void Render(ILI9341UiDriver& driver)
+    {
+        // Marking a widget can make further ones overlap, until none is left
+        for(bool marked = true; marked;)
+        {
+            marked = false;
+            for(uint8_t i = 0; i < count_; i++)
+            {
+                if(!widgets_[i]->dirty_)
+                {
+                    continue;
+                }
+                auto damage = widgets_[i]->Damage();
+                for(uint8_t j = 0; j < count_; j++)
+                {
+                    if(!widgets_[j]->dirty_
+                       && Overlap(damage, widgets_[j]->Damage()))
+                    {
+                        widgets_[j]->dirty_ = true;
+                        marked              = true;
+                    }
+                }
+            }
+        }
+
+        // All areas are cleared before drawing, so no clear wipes a widget
+        // drawn earlier in the frame
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            if(widgets_[i]->dirty_)
+            {
+                driver.FillRect(widgets_[i]->Damage(), background_);
+            }
+        }
+
+        redrawn_ = 0;
+        for(uint8_t i = 0; i < count_; i++)
+        {
+            Widget& widget = *widgets_[i];
+            if(!widget.dirty_)
+            {
+                continue;
+            }
+            if(widget.visible_)
+            {
+                widget.Draw(driver);
+            }
+            widget.drawn_ = widget.visible_ ? widget.bounds_ : Rectangle();
+            widget.dirty_ = false;
+            redrawn_++;
+        }
+    }
+
+    /**
+     * @brief Widgets the last Render() drew, and those it left alone.
+     */
+    uint8_t Redrawn() const { return redrawn_; }
+    uint8_t Skipped() const { return count_ - redrawn_; }
+
+  private:
+    static bool Overlap(const Rectangle& a, const Rectangle& b)
+    {
+        return !a.IsEmpty() && !b.IsEmpty() && a.GetX() < b.GetRight()
+               && b.GetX() < a.GetRight() && a.GetY() < b.GetBottom()
+               && b.GetY() < a.GetBottom();
+    }
+
+    Widget* widgets_[ILI9341_MAX_WIDGETS];
+    uint8_t count_      = 0;
+    uint8_t redrawn_    = 0;
+    uint8_t background_ = COLOR_BLACK;
+};